@@ -0,0 +1,436 @@
+/**
+ * @file aarch64.cpp
+ * @brief AArch64 instruction encoding and the bytecode translator
+ */
+
+#include "aarch64.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace aarch64 {
+    enum Condition : uint32_t { EQ = 0, NE = 1, GE = 10, LT = 11, GT = 12, LE = 13 };
+
+    inline Condition conditionOf(OpCode op) {
+        switch (op) {
+        case OpCode::GREATER: case OpCode::JUMP_IF_GREATER: return GT;
+        case OpCode::LESS: case OpCode::JUMP_IF_LESS: return LT;
+        case OpCode::EQUAL: case OpCode::JUMP_IF_EQUAL: return EQ;
+        case OpCode::NOT_EQUAL: case OpCode::JUMP_IF_NOT_EQUAL: return NE;
+        case OpCode::GREATER_EQUAL: case OpCode::JUMP_IF_GREATER_EQUAL: return GE;
+        default: return LE;
+        }
+    }
+
+    // Machine registers used by the generated code
+    constexpr uint32_t X0 = 0, X1 = 1, X2 = 2, W9 = 9, W10 = 10, W11 = 11, W12 = 12, X16 = 16;
+    constexpr uint32_t ASSIGNED = 20, CONTEXT = 21;
+    constexpr uint32_t FP = 29, LR = 30, SP = 31, ZR = 31;
+    constexpr uint32_t allocatable[] = { 19, 22, 23, 24, 25, 26, 27, 28 };
+
+    // Encoders for the instructions used (32-bit W forms unless noted)
+    inline uint32_t add(uint32_t d, uint32_t n, uint32_t m) { return 0x0B000000 | m << 16 | n << 5 | d; }
+    inline uint32_t sub(uint32_t d, uint32_t n, uint32_t m) { return 0x4B000000 | m << 16 | n << 5 | d; }
+    inline uint32_t madd(uint32_t d, uint32_t n, uint32_t m, uint32_t a) { return 0x1B000000 | m << 16 | a << 10 | n << 5 | d; }
+    inline uint32_t msub(uint32_t d, uint32_t n, uint32_t m, uint32_t a) { return 0x1B008000 | m << 16 | a << 10 | n << 5 | d; }
+    inline uint32_t mul(uint32_t d, uint32_t n, uint32_t m) { return madd(d, n, m, ZR); }
+    inline uint32_t cmp(uint32_t n, uint32_t m) { return 0x6B00001F | m << 16 | n << 5; }
+
+    // add/sub/cmp/cmn immediates: 12 bits, optionally shifted left by 12, as bits 22-10
+    inline bool arithmeticImmediate(int64_t value, uint32_t& field) {
+        if (value >= 0 && value < 4096) {
+            field = static_cast<uint32_t>(value);
+            return true;
+        }
+        if (value > 0 && value % 4096 == 0 && value / 4096 < 4096) {
+            field = 1u << 12 | static_cast<uint32_t>(value / 4096);
+            return true;
+        }
+        return false;
+    }
+    inline uint32_t addImmediate(uint32_t d, uint32_t n, uint32_t field) { return 0x11000000 | field << 10 | n << 5 | d; }
+    inline uint32_t subImmediate(uint32_t d, uint32_t n, uint32_t field) { return 0x51000000 | field << 10 | n << 5 | d; }
+    inline uint32_t cmpImmediate(uint32_t n, uint32_t field) { return 0x7100001F | field << 10 | n << 5; }
+    inline uint32_t cmnImmediate(uint32_t n, uint32_t field) { return 0x3100001F | field << 10 | n << 5; }
+    inline uint32_t cset(uint32_t d, Condition c) { return 0x1A9F07E0 | (c ^ 1u) << 12 | d; }
+    inline uint32_t mov(uint32_t d, uint32_t m) { return 0x2A0003E0 | m << 16 | d; }
+    inline uint32_t movX(uint32_t d, uint32_t m) { return 0xAA0003E0 | m << 16 | d; }
+    inline uint32_t movz(uint32_t d, uint32_t imm16, uint32_t shift) { return 0x52800000 | (shift / 16) << 21 | imm16 << 5 | d; }
+    inline uint32_t movk(uint32_t d, uint32_t imm16, uint32_t shift) { return 0x72800000 | (shift / 16) << 21 | imm16 << 5 | d; }
+    inline uint32_t lsl(uint32_t d, uint32_t n, uint32_t shift) {
+        return 0x53000000 | ((32 - shift) % 32) << 16 | (31 - shift) << 10 | n << 5 | d;
+    }
+    inline uint32_t ldrW(uint32_t t, uint32_t n, uint32_t offset) { return 0xB9400000 | (offset / 4) << 10 | n << 5 | t; }
+    inline uint32_t strW(uint32_t t, uint32_t n, uint32_t offset) { return 0xB9000000 | (offset / 4) << 10 | n << 5 | t; }
+    inline uint32_t ldrX(uint32_t t, uint32_t n, uint32_t offset) { return 0xF9400000 | (offset / 8) << 10 | n << 5 | t; }
+    inline uint32_t ldrb(uint32_t t, uint32_t n, uint32_t offset) { return 0x39400000 | offset << 10 | n << 5 | t; }
+    inline uint32_t strb(uint32_t t, uint32_t n, uint32_t offset) { return 0x39000000 | offset << 10 | n << 5 | t; }
+    inline uint32_t stpPre(uint32_t t1, uint32_t t2, int32_t offset) { return 0xA9800000 | (static_cast<uint32_t>(offset / 8) & 0x7F) << 15 | t2 << 10 | SP << 5 | t1; }
+    inline uint32_t stp(uint32_t t1, uint32_t t2, int32_t offset) { return 0xA9000000 | (static_cast<uint32_t>(offset / 8) & 0x7F) << 15 | t2 << 10 | SP << 5 | t1; }
+    inline uint32_t ldp(uint32_t t1, uint32_t t2, int32_t offset) { return 0xA9400000 | (static_cast<uint32_t>(offset / 8) & 0x7F) << 15 | t2 << 10 | SP << 5 | t1; }
+    inline uint32_t ldpPost(uint32_t t1, uint32_t t2, int32_t offset) { return 0xA8C00000 | (static_cast<uint32_t>(offset / 8) & 0x7F) << 15 | t2 << 10 | SP << 5 | t1; }
+    inline uint32_t blr(uint32_t n) { return 0xD63F0000 | n << 5; }
+    inline uint32_t ret() { return 0xD65F03C0; }
+    inline uint32_t subSp(uint32_t imm12) { return 0xD10003FF | imm12 << 10; }
+    constexpr uint32_t movFpSp = 0x910003FD; // mov x29, sp
+    constexpr uint32_t movSpFp = 0x910003BF; // mov sp, x29
+
+    bool CodeGenerator::generate(std::vector<uint32_t>& code) {
+        assignment = allocateRegisters(bytecode, sizeof(allocatable) / sizeof(allocatable[0]));
+        const uint32_t spillBytes = (assignment.spillSlots * 4 + 15) / 16 * 16;
+        if (spillBytes > 4080 || bytecode.variableCount > 4096) {
+            return false;
+        }
+        size_t count = bytecode.code.size();
+        labels.assign(count + 3, 0);
+        errorExit = count;
+        deoptimizeExit = count + 1;
+        epilogue = count + 2;
+
+        // Prologue: save the frame and callee-saved registers, keep the arguments and make
+        // room for the spill slots (at sp)
+        emit(stpPre(FP, LR, -96));
+        emit(movFpSp);
+        emit(stp(19, 20, 16));
+        emit(stp(21, 22, 32));
+        emit(stp(23, 24, 48));
+        emit(stp(25, 26, 64));
+        emit(stp(27, 28, 80));
+        emit(movX(ASSIGNED, X0));
+        emit(movX(CONTEXT, X1));
+        if (spillBytes > 0) {
+            emit(subSp(spillBytes));
+        }
+
+        Liveness liveness(bytecode);
+        for (size_t pc = 0; pc < count; ++pc) {
+            labels[pc] = out.size();
+            if (native_code::feedsOnlyNext(bytecode, liveness, pc) && fuse(bytecode.code[pc], bytecode.code[pc + 1])) {
+                ++pc;
+                labels[pc] = labels[pc - 1];
+            }
+            else {
+                translate(bytecode.code[pc]);
+            }
+        }
+
+        // Undefined-variable stubs, the shared exits and the epilogue
+        for (const auto& stub : stubs) {
+            labels[stub.label] = out.size();
+            call(offsetof(Context, undefined), stub.slot, stub.offset);
+            branch(0x14000000, errorExit);
+        }
+        labels[errorExit] = out.size();
+        emit(movz(X0, 2, 0));
+        branch(0x14000000, epilogue);
+        labels[deoptimizeExit] = out.size();
+        emit(movz(X0, 1, 0));
+        labels[epilogue] = out.size();
+        emit(movSpFp);
+        emit(ldp(27, 28, 80));
+        emit(ldp(25, 26, 64));
+        emit(ldp(23, 24, 48));
+        emit(ldp(21, 22, 32));
+        emit(ldp(19, 20, 16));
+        emit(ldpPost(FP, LR, 96));
+        emit(ret());
+
+        // Branch offsets are in words: imm26 for b, imm19 for the conditional branches
+        for (const auto& fixup : fixups) {
+            auto distance = static_cast<int64_t>(labels[fixup.label]) - static_cast<int64_t>(fixup.position);
+            uint32_t& word = out[fixup.position];
+            if ((word & 0xFC000000) == 0x14000000) {
+                if (distance < -(int64_t(1) << 25) || distance >= (int64_t(1) << 25)) {
+                    return false;
+                }
+                word |= static_cast<uint32_t>(distance) & 0x3FFFFFF;
+            }
+            else {
+                if (distance < -(int64_t(1) << 18) || distance >= (int64_t(1) << 18)) {
+                    return false;
+                }
+                word |= (static_cast<uint32_t>(distance) & 0x7FFFF) << 5;
+            }
+        }
+        code = std::move(out);
+        return true;
+    }
+
+    void CodeGenerator::translate(const Instruction& in) {
+        switch (in.op) {
+        case OpCode::LOAD_CONST: {
+            uint32_t result = target(in.a);
+            immediate(result, static_cast<uint32_t>(in.b));
+            finish(in.a, result);
+            break;
+        }
+        case OpCode::MOVE:
+            store(in.a, load(in.b, W9));
+            break;
+        case OpCode::ADD:
+        case OpCode::SUBTRACT:
+        case OpCode::MULTIPLY: {
+            uint32_t left = load(in.b, W9);
+            uint32_t right = load(in.c, W10);
+            uint32_t result = target(in.a);
+            emit(in.op == OpCode::ADD ? add(result, left, right)
+                 : in.op == OpCode::SUBTRACT ? sub(result, left, right) : mul(result, left, right));
+            finish(in.a, result);
+            break;
+        }
+        case OpCode::GREATER:
+        case OpCode::LESS:
+        case OpCode::EQUAL:
+        case OpCode::NOT_EQUAL:
+        case OpCode::GREATER_EQUAL:
+        case OpCode::LESS_EQUAL: {
+            emit(cmp(load(in.b, W9), load(in.c, W10)));
+            uint32_t result = target(in.a);
+            emit(cset(result, conditionOf(in.op)));
+            finish(in.a, result);
+            break;
+        }
+        case OpCode::ADD_CONST:
+        case OpCode::SUBTRACT_CONST: {
+            uint32_t value = load(in.b, W9);
+            uint32_t result = target(in.a);
+            addConstant(result, value, in.op == OpCode::ADD_CONST ? int64_t(in.c) : -int64_t(in.c));
+            finish(in.a, result);
+            break;
+        }
+        case OpCode::CONST_SUBTRACT:
+        case OpCode::MULTIPLY_CONST: {
+            // 0 - x and x * -1 are neg, x * (2^k + 1) is x + (x << k)
+            uint32_t value = load(in.b, W9);
+            uint32_t result = target(in.a);
+            auto constant = static_cast<uint32_t>(in.c);
+            if (in.op == OpCode::CONST_SUBTRACT ? constant == 0 : constant == 0xFFFFFFFF) {
+                emit(sub(result, ZR, value));
+            }
+            else if (in.op == OpCode::MULTIPLY_CONST && constant > 2 && ((constant - 1) & (constant - 2)) == 0) {
+                uint32_t shift = 0;
+                while ((uint32_t(1) << shift) != constant - 1) {
+                    ++shift;
+                }
+                emit(add(result, value, value) | shift << 10);
+            }
+            else {
+                immediate(W10, constant);
+                emit(in.op == OpCode::CONST_SUBTRACT ? sub(result, W10, value) : mul(result, value, W10));
+            }
+            finish(in.a, result);
+            break;
+        }
+        case OpCode::SHIFT_LEFT_CONST: {
+            uint32_t value = load(in.b, W9);
+            uint32_t result = target(in.a);
+            emit(lsl(result, value, static_cast<uint32_t>(in.c)));
+            finish(in.a, result);
+            break;
+        }
+        case OpCode::JUMP:
+            branch(0x14000000, static_cast<size_t>(in.a));
+            break;
+        case OpCode::JUMP_IF_FALSE:
+        case OpCode::JUMP_IF_TRUE:
+            branch((in.op == OpCode::JUMP_IF_FALSE ? 0x34000000 : 0x35000000) | load(in.b, W9), static_cast<size_t>(in.a));
+            break;
+        case OpCode::JUMP_IF_GREATER:
+        case OpCode::JUMP_IF_LESS:
+        case OpCode::JUMP_IF_EQUAL:
+        case OpCode::JUMP_IF_NOT_EQUAL:
+        case OpCode::JUMP_IF_GREATER_EQUAL:
+        case OpCode::JUMP_IF_LESS_EQUAL:
+            emit(cmp(load(in.b, W9), load(in.c, W10)));
+            branch(0x54000000 | conditionOf(in.op), static_cast<size_t>(in.a));
+            break;
+        case OpCode::INPUT:
+        case OpCode::INPUT_EXPECT: {
+            call(offsetof(Context, input), static_cast<uint32_t>(in.a), static_cast<uint32_t>(in.b));
+            branch(0x35000000 | X0, errorExit); // cbnz w0
+            uint32_t result = target(in.a);
+            emit(ldrW(result, CONTEXT, offsetof(Context, value)));
+            finish(in.a, result);
+            if (in.op == OpCode::INPUT_EXPECT) {
+                compareConstant(result, in.c);
+                branch(0x54000000 | NE, deoptimizeExit);
+            }
+            break;
+        }
+        case OpCode::PRINT: {
+            uint32_t value = load(in.a, X2);
+            if (value != X2) {
+                emit(mov(X2, value));
+            }
+            print(static_cast<uint32_t>(in.b));
+            break;
+        }
+        case OpCode::CHECK_ASSIGNED:
+            emit(ldrb(W9, ASSIGNED, static_cast<uint32_t>(in.a)));
+            branch(0x34000000 | W9, labels.size()); // cbz w9 to a stub reporting the error
+            stubs.push_back({ labels.size(), static_cast<uint32_t>(in.a), static_cast<uint32_t>(in.b) });
+            labels.push_back(0);
+            break;
+        case OpCode::MARK_ASSIGNED:
+            emit(movz(W9, 1, 0));
+            emit(strb(W9, ASSIGNED, static_cast<uint32_t>(in.a)));
+            break;
+        case OpCode::CHARGE:
+            call(offsetof(Context, charge), static_cast<uint32_t>(in.a), static_cast<uint32_t>(in.b));
+            branch(0x35000000 | X0, errorExit); // cbnz w0
+            break;
+        case OpCode::HALT:
+            emit(movz(X0, 0, 0));
+            branch(0x14000000, epilogue);
+            break;
+        }
+    }
+
+    bool CodeGenerator::fuse(const Instruction& first, const Instruction& next) {
+        const int32_t fed = first.a;
+        const bool compareAndBranch = next.op >= OpCode::JUMP_IF_GREATER && next.op <= OpCode::JUMP_IF_LESS_EQUAL;
+        if (first.op == OpCode::LOAD_CONST && (isComparison(next.op) || compareAndBranch)) {
+            // Compare against an immediate, swapping the condition when the constant is on the left
+            Condition condition = conditionOf(next.op);
+            int32_t other = next.c;
+            if (next.b != fed) {
+                other = next.b;
+            }
+            else if (condition != EQ && condition != NE) {
+                condition = condition == GT ? LT : condition == LT ? GT : condition == GE ? LE : GE;
+            }
+            uint32_t value = load(other, W9);
+            if (compareAndBranch && first.b == 0 && (condition == EQ || condition == NE)) {
+                branch((condition == EQ ? 0x34000000 : 0x35000000) | value, static_cast<size_t>(next.a)); // cbz/cbnz
+                return true;
+            }
+            compareConstant(value, first.b);
+            if (compareAndBranch) {
+                branch(0x54000000 | condition, static_cast<size_t>(next.a));
+                return true;
+            }
+            uint32_t result = target(next.a);
+            emit(cset(result, condition));
+            finish(next.a, result);
+            return true;
+        }
+        if (first.op == OpCode::LOAD_CONST && next.op == OpCode::PRINT) {
+            immediate(X2, static_cast<uint32_t>(first.b));
+            print(static_cast<uint32_t>(next.b));
+            return true;
+        }
+        if ((next.op == OpCode::ADD || (next.op == OpCode::SUBTRACT && next.c == fed)) &&
+            (first.op == OpCode::SHIFT_LEFT_CONST || first.op == OpCode::MULTIPLY || first.op == OpCode::MULTIPLY_CONST)) {
+            // add/sub with a shifted register operand, or madd/msub
+            uint32_t addend = load(next.b == fed ? next.c : next.b, W9);
+            uint32_t left = load(first.b, W10);
+            uint32_t result = target(next.a);
+            if (first.op == OpCode::SHIFT_LEFT_CONST) {
+                auto shift = static_cast<uint32_t>(first.c) << 10;
+                emit((next.op == OpCode::ADD ? add(result, addend, left) : sub(result, addend, left)) | shift);
+            }
+            else {
+                uint32_t right = W12;
+                if (first.op == OpCode::MULTIPLY) {
+                    right = load(first.c, W12);
+                }
+                else {
+                    immediate(W12, static_cast<uint32_t>(first.c));
+                }
+                emit(next.op == OpCode::ADD ? madd(result, left, right, addend) : msub(result, left, right, addend));
+            }
+            finish(next.a, result);
+            return true;
+        }
+        if (isComparison(first.op) && (next.op == OpCode::JUMP_IF_FALSE || next.op == OpCode::JUMP_IF_TRUE)) {
+            emit(cmp(load(first.b, W9), load(first.c, W10)));
+            Condition condition = conditionOf(first.op);
+            branch(0x54000000 | (next.op == OpCode::JUMP_IF_FALSE ? condition ^ 1u : condition), static_cast<size_t>(next.a));
+            return true;
+        }
+        return false;
+    }
+
+    void CodeGenerator::immediate(uint32_t reg, uint32_t value) {
+        emit(movz(reg, value & 0xFFFF, 0));
+        if (value >> 16) {
+            emit(movk(reg, value >> 16, 16));
+        }
+    }
+
+    void CodeGenerator::addConstant(uint32_t result, uint32_t value, int64_t constant) {
+        uint32_t field;
+        if (arithmeticImmediate(constant, field)) {
+            emit(addImmediate(result, value, field));
+        }
+        else if (arithmeticImmediate(-constant, field)) {
+            emit(subImmediate(result, value, field));
+        }
+        else {
+            immediate(W10, static_cast<uint32_t>(constant));
+            emit(add(result, value, W10));
+        }
+    }
+
+    void CodeGenerator::compareConstant(uint32_t value, int64_t constant) {
+        uint32_t field;
+        if (arithmeticImmediate(constant, field)) {
+            emit(cmpImmediate(value, field));
+        }
+        else if (arithmeticImmediate(-constant, field)) {
+            emit(cmnImmediate(value, field));
+        }
+        else {
+            immediate(W10, static_cast<uint32_t>(constant));
+            emit(cmp(value, W10));
+        }
+    }
+
+    uint32_t CodeGenerator::load(int32_t reg, uint32_t scratch) {
+        int32_t mapped = assignment.machine[static_cast<size_t>(reg)];
+        if (mapped >= 0) {
+            return allocatable[mapped];
+        }
+        emit(ldrW(scratch, SP, spillOffset(reg)));
+        return scratch;
+    }
+
+    uint32_t CodeGenerator::target(int32_t reg) {
+        int32_t mapped = assignment.machine[static_cast<size_t>(reg)];
+        return mapped >= 0 ? allocatable[mapped] : W11;
+    }
+
+    void CodeGenerator::finish(int32_t reg, uint32_t computed) {
+        if (assignment.machine[static_cast<size_t>(reg)] < 0) {
+            emit(strW(computed, SP, spillOffset(reg)));
+        }
+    }
+
+    void CodeGenerator::store(int32_t reg, uint32_t value) {
+        int32_t mapped = assignment.machine[static_cast<size_t>(reg)];
+        if (mapped < 0) {
+            emit(strW(value, SP, spillOffset(reg)));
+        }
+        else if (allocatable[mapped] != value) {
+            emit(mov(allocatable[mapped], value));
+        }
+    }
+
+    uint32_t CodeGenerator::spillOffset(int32_t reg) const {
+        return static_cast<uint32_t>(assignment.spillSlot[static_cast<size_t>(reg)]) * 4;
+    }
+    void CodeGenerator::call(size_t callback, uint32_t first, uint32_t second) {
+        emit(movX(X0, CONTEXT));
+        immediate(X1, first);
+        immediate(X2, second);
+        emit(ldrX(X16, CONTEXT, static_cast<uint32_t>(callback)));
+        emit(blr(X16));
+    }
+
+    void CodeGenerator::print(uint32_t id) {
+        immediate(X1, id);
+        emit(movX(X0, CONTEXT));
+        emit(ldrX(X16, CONTEXT, offsetof(Context, print)));
+        emit(blr(X16));
+    }
+}
@@ -0,0 +1,90 @@
+/**
+ * @file aarch64.h
+ * @brief AArch64 code generation for optimized bytecode
+ */
+
+#pragma once
+
+#include "bytecode.h"
+#include "native_code.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// AArch64 native code (see native_code.h). The bytecode registers live in the callee-saved
+// machine registers x19 and x22-x28; x20 and x21 keep the run's arguments. Constants become
+// add/sub/cmp immediates where they fit, a shift or multiply feeding an add or subtract
+// becomes its shifted-register or madd/msub operand, and a comparison feeding a branch
+// becomes cmp and b.cond (cbz/cbnz against zero). Generating code
+// works on any host (--dump-native writes it out for a disassembler); running it needs
+// AArch64 Linux, where qemu-user will do.
+namespace aarch64 {
+    using native_code::Context;
+
+    // CodeGenerator class: Translates one Bytecode; generate() is false when the bytecode
+    // does not fit the addressing used (over 1020 spill slots or 4096 variables, or
+    // branches beyond the +-1 MiB of b.cond/cbz/cbnz or the +-128 MiB of b)
+    class CodeGenerator {
+    public:
+        explicit CodeGenerator(const Bytecode& bytecode) : bytecode(bytecode) {}
+
+        bool generate(std::vector<uint32_t>& code);
+
+        // The spill slots in the generated function's stack frame
+        uint32_t spillSlots() const { return assignment.spillSlots; }
+
+    private:
+        struct Fixup {
+            size_t position;
+            size_t label;
+        };
+
+        struct Stub {
+            size_t label;
+            uint32_t slot;
+            uint32_t offset;
+        };
+
+        const Bytecode& bytecode;
+        std::vector<uint32_t> out;
+        std::vector<size_t> labels; // Native position of each bytecode instruction, exit and stub
+        std::vector<Fixup> fixups;
+        std::vector<Stub> stubs;
+        RegisterAssignment assignment; // Machine registers index allocatable (aarch64.cpp)
+        size_t errorExit = 0, deoptimizeExit = 0, epilogue = 0;
+
+        void emit(uint32_t word) { out.push_back(word); }
+
+        void branch(uint32_t word, size_t label) {
+            fixups.push_back({ out.size(), label });
+            emit(word);
+        }
+
+        // Emit one instruction; fuse() emits it together with the next one when a pattern
+        // matches (and the next one only reads its result) and is false otherwise
+        void translate(const Instruction& in);
+        bool fuse(const Instruction& first, const Instruction& next);
+
+        void immediate(uint32_t reg, uint32_t value);
+
+        // result = value + constant, and the flags of value - constant, by immediate where it fits
+        void addConstant(uint32_t result, uint32_t value, int64_t constant);
+        void compareConstant(uint32_t value, int64_t constant);
+
+        // The machine register holding a bytecode register's value, loading it into scratch if needed
+        uint32_t load(int32_t reg, uint32_t scratch);
+
+        // Where to compute a bytecode register's new value, and storing it there afterwards
+        uint32_t target(int32_t reg);
+        void finish(int32_t reg, uint32_t computed);
+
+        void store(int32_t reg, uint32_t value);
+
+        uint32_t spillOffset(int32_t reg) const;
+
+        // Call a context callback with (context, first, second), or print with the value in w2
+        void call(size_t callback, uint32_t first, uint32_t second);
+        void print(uint32_t id);
+    };
+}
@@ -0,0 +1,85 @@
+/**
+ * @file alloc_counting.cpp
+ * @brief The counting replacements of the global operator new and delete
+ *
+ * Kept out of GLSLCore: only GLSLTests, and GLSLCompiler when configured with
+ * -DGLSL_ALLOC_STATS=ON, are linked with it, so a normal build keeps the standard
+ * allocation functions.
+ */
+
+#include "alloc_stats.h"
+#include "platform.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+    // Tell the command line that allocations are counted in this executable
+    [[maybe_unused]] const bool installed = (alloc_stats::available = true);
+}
+
+// These operators and ASTNode's are kept out of line, so the compiler pairs each delete
+// expression with operator delete rather than with the free() inside it.
+GLSL_NOINLINE void* operator new(std::size_t size) {
+    alloc_stats::record(size);
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+GLSL_NOINLINE void* operator new(std::size_t size, std::align_val_t alignment) {
+    alloc_stats::record(size);
+    auto align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+    void* memory = _aligned_malloc(size ? size : 1, align);
+#else
+    void* memory = std::aligned_alloc(align, (size + align - 1) / align * align + (size ? 0 : align));
+#endif
+    if (memory) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+GLSL_NOINLINE void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    alloc_stats::record(size);
+    return std::malloc(size ? size : 1);
+}
+
+GLSL_NOINLINE void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    try {
+        return ::operator new(size, alignment);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+GLSL_NOINLINE void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+GLSL_NOINLINE void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+GLSL_NOINLINE void operator delete(void* memory, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+GLSL_NOINLINE void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept {
+    ::operator delete(memory, alignment);
+}
+
+GLSL_NOINLINE void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+GLSL_NOINLINE void operator delete(void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    ::operator delete(memory, alignment);
+}
@@ -0,0 +1,13 @@
+/**
+ * @file alloc_stats.cpp
+ * @brief Heap allocation counters behind --alloc-stats
+ */
+
+#include "alloc_stats.h"
+
+namespace alloc_stats {
+    std::atomic<bool> enabled{ false };
+    std::atomic<bool> available{ false };
+    thread_local uint64_t count = 0;
+    thread_local uint64_t bytes = 0;
+}
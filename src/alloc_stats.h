@@ -0,0 +1,51 @@
+/**
+ * @file alloc_stats.h
+ * @brief Heap allocation counters behind --alloc-stats
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Allocation counters behind --alloc-stats; when alloc_counting.cpp is linked in, every heap
+// allocation goes through its replaceable global operator new (the nothrow forms included, so
+// that every allocation pairs with the operator delete there), which only counts while `enabled`
+// is set and sets `available` at startup. Without it the counters stay at zero.
+// Counters are per thread, so a phase measured on one thread ignores background I/O.
+namespace alloc_stats {
+    extern std::atomic<bool> enabled;
+    extern std::atomic<bool> available;
+    extern thread_local uint64_t count;
+    extern thread_local uint64_t bytes;
+
+    struct Snapshot {
+        uint64_t count;
+        uint64_t bytes;
+    };
+
+    inline Snapshot now() {
+        return { count, bytes };
+    }
+
+    inline std::string since(const Snapshot& start) {
+        Snapshot end = now();
+        return std::to_string(end.count - start.count) + " allocations, " + std::to_string(end.bytes - start.bytes) + " bytes";
+    }
+
+    // Add the allocations made since start to total
+    inline void accumulate(Snapshot& total, const Snapshot& start) {
+        Snapshot end = now();
+        total.count += end.count - start.count;
+        total.bytes += end.bytes - start.bytes;
+    }
+
+    inline void record(std::size_t size) {
+        if (enabled.load(std::memory_order_relaxed)) {
+            ++count;
+            bytes += size;
+        }
+    }
+}
@@ -0,0 +1,215 @@
+/**
+ * @file ast.cpp
+ * @brief AST node allocation, the expression table and tree utilities
+ */
+
+#include "ast.h"
+
+#include <mutex>
+
+namespace {
+    std::mutex idleHeapsMutex;
+}
+
+NodePool::Heap* NodePool::idleHeaps = nullptr;
+
+NodePool::Heap* NodePool::takeHeap() {
+    {
+        std::lock_guard<std::mutex> lock(idleHeapsMutex);
+        if (Heap* heap = idleHeaps) {
+            idleHeaps = heap->nextIdle;
+            return heap;
+        }
+    }
+    return new Heap();
+}
+
+NodePool::Binding::~Binding() {
+    if (heap) {
+        std::lock_guard<std::mutex> lock(idleHeapsMutex);
+        heap->nextIdle = idleHeaps;
+        idleHeaps = heap;
+    }
+}
+
+void NodePool::addChunk(Heap& heap) {
+    auto chunk = static_cast<char*>(::operator new(chunkSize, std::align_val_t(chunkSize)));
+    *reinterpret_cast<Heap**>(chunk) = &heap;
+    heap.cursor = chunk + granularity; // The owner pointer takes the first granule
+    heap.limit = chunk + chunkSize;
+    chunks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void* ASTNode::operator new(size_t size) {
+    return nodeAllocator == AllocatorKind::POOL ? NodePool::allocate(size) : ::operator new(size);
+}
+
+void ASTNode::operator delete(void* memory, size_t size) {
+    if (nodeAllocator == AllocatorKind::POOL) {
+        NodePool::deallocate(memory, size);
+    }
+    else {
+        ::operator delete(memory);
+    }
+}
+
+void numberPrintStatements(const std::vector<StmtPtr>& statements, uint32_t& nextId) {
+    for (const auto& statement : statements) {
+        if (auto printStmt = dynamic_cast<PrintStatement*>(statement.get())) {
+            printStmt->id = nextId++;
+        }
+        else if (auto ifStmt = dynamic_cast<IfStatement*>(statement.get())) {
+            numberPrintStatements(ifStmt->thenStatements, nextId);
+        }
+    }
+}
+
+template <typename Make>
+const Expression* ExpressionTable::find(const Key& key, Make make) {
+    auto found = byStructure.find(key);
+    if (found != byStructure.end()) {
+        return found->second;
+    }
+    nodes.push_back(make());
+    const Expression* node = nodes.back().get();
+    byStructure.emplace(key, node);
+    return node;
+}
+
+const Expression* ExpressionTable::number(int value) {
+    return find({ Kind::NUMBER, BinaryOp::ADD, nullptr, nullptr, value },
+                [&] { return std::make_unique<Number>(value); });
+}
+
+const Expression* ExpressionTable::variable(const std::string& name, uint32_t slot) {
+    return find({ Kind::VARIABLE, BinaryOp::ADD, nullptr, nullptr, slot }, [&] {
+        auto ident = std::make_unique<Identifier>(name);
+        ident->slot = slot;
+        return ident;
+    });
+}
+
+const Expression* ExpressionTable::binary(BinaryOp op, const Expression* left, const Expression* right) {
+    return find({ Kind::BINARY, op, left, right, 0 },
+                [&] { return std::make_unique<BinaryOperation>(op, left, right); });
+}
+
+const Expression* ExpressionTable::intern(const Expression* expression) {
+    if (auto binOp = dynamic_cast<const BinaryOperation*>(expression)) {
+        const Expression* left = intern(binOp->left);
+        return binary(binOp->op, left, intern(binOp->right));
+    }
+    else if (auto ident = dynamic_cast<const Identifier*>(expression)) {
+        return variable(ident->name, ident->slot);
+    }
+    return number(static_cast<const Number*>(expression)->value);
+}
+
+namespace {
+    // The statement's own expression, if it has one
+    const Expression* statementExpression(const Statement* statement) {
+        if (auto assignStmt = dynamic_cast<const AssignStatement*>(statement)) {
+            return assignStmt->expression;
+        }
+        else if (auto printStmt = dynamic_cast<const PrintStatement*>(statement)) {
+            return printStmt->expression;
+        }
+        else if (auto ifStmt = dynamic_cast<const IfStatement*>(statement)) {
+            return ifStmt->compareExpression;
+        }
+        return nullptr;
+    }
+
+    // Walk the occurrences in evaluation order, counting them in index, up to the first read of slot
+    bool findRead(const Expression* expression, uint32_t slot, size_t& index) {
+        if (auto binOp = dynamic_cast<const BinaryOperation*>(expression)) {
+            if (findRead(binOp->left, slot, index) || findRead(binOp->right, slot, index)) {
+                return true;
+            }
+        }
+        else if (auto ident = dynamic_cast<const Identifier*>(expression)) {
+            if (ident->slot == slot) {
+                return true;
+            }
+        }
+        ++index;
+        return false;
+    }
+}
+
+void shiftSourceOffsets(Statement* statement, ptrdiff_t delta) {
+    statement->offset = static_cast<SourceOffset>(statement->offset + delta);
+    for (auto& offset : statement->expressionOffsets) {
+        offset = static_cast<SourceOffset>(offset + delta);
+    }
+    if (auto ifStmt = dynamic_cast<IfStatement*>(statement)) {
+        for (auto& stmt : ifStmt->thenStatements) {
+            shiftSourceOffsets(stmt.get(), delta);
+        }
+    }
+}
+
+SourceOffset readOffset(const Statement* statement, uint32_t slot) {
+    size_t index = 0;
+    const Expression* expression = statementExpression(statement);
+    if (expression && findRead(expression, slot, index) && index < statement->expressionOffsets.size()) {
+        return statement->expressionOffsets[index];
+    }
+    return statement->offset;
+}
+
+StmtPtr cloneStatement(const Statement* statement, ExpressionTable& expressions) {
+    StmtPtr copy;
+    if (auto assignStmt = dynamic_cast<const AssignStatement*>(statement)) {
+        auto assignCopy = std::make_unique<AssignStatement>(assignStmt->identifier, expressions.intern(assignStmt->expression));
+        assignCopy->slot = assignStmt->slot;
+        copy = std::move(assignCopy);
+    }
+    else if (auto printStmt = dynamic_cast<const PrintStatement*>(statement)) {
+        copy = std::make_unique<PrintStatement>(expressions.intern(printStmt->expression), printStmt->id);
+    }
+    else if (auto inputStmt = dynamic_cast<const InputStatement*>(statement)) {
+        auto inputCopy = std::make_unique<InputStatement>(inputStmt->identifier);
+        inputCopy->slot = inputStmt->slot;
+        copy = std::move(inputCopy);
+    }
+    else {
+        auto ifStmt = static_cast<const IfStatement*>(statement);
+        std::vector<StmtPtr> thenStatements;
+        for (const auto& stmt : ifStmt->thenStatements) {
+            thenStatements.push_back(cloneStatement(stmt.get(), expressions));
+        }
+        copy = std::make_unique<IfStatement>(expressions.intern(ifStmt->compareExpression), std::move(thenStatements));
+    }
+    copy->offset = statement->offset;
+    copy->expressionOffsets = statement->expressionOffsets;
+    return copy;
+}
+
+void reinternExpressions(const std::vector<StmtPtr>& statements, ExpressionTable& expressions) {
+    for (const auto& statement : statements) {
+        if (auto assignStmt = dynamic_cast<AssignStatement*>(statement.get())) {
+            assignStmt->expression = expressions.intern(assignStmt->expression);
+        }
+        else if (auto printStmt = dynamic_cast<PrintStatement*>(statement.get())) {
+            printStmt->expression = expressions.intern(printStmt->expression);
+        }
+        else if (auto ifStmt = dynamic_cast<IfStatement*>(statement.get())) {
+            ifStmt->compareExpression = expressions.intern(ifStmt->compareExpression);
+            reinternExpressions(ifStmt->thenStatements, expressions);
+        }
+    }
+}
+
+size_t maxInputsRead(const std::vector<StmtPtr>& statements) {
+    size_t count = 0;
+    for (auto& statement : statements) {
+        if (dynamic_cast<const InputStatement*>(statement.get())) {
+            ++count;
+        }
+        else if (auto ifStmt = dynamic_cast<const IfStatement*>(statement.get())) {
+            count += maxInputsRead(ifStmt->thenStatements);
+        }
+    }
+    return count;
+}
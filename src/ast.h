@@ -0,0 +1,330 @@
+/**
+ * @file ast.h
+ * @brief AST nodes, their allocator and the symbol table
+ */
+
+#pragma once
+
+#include "lexer.h"
+#include "platform.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Allocators available for AST nodes. Chosen once at startup (--allocator), before any node exists.
+enum class AllocatorKind { SYSTEM, POOL };
+inline AllocatorKind nodeAllocator = AllocatorKind::POOL;
+
+// NodePool class: Size-class allocator for AST nodes. Each thread carves nodes out of 64 KiB
+// chunks of its own heap and recycles freed nodes through per-size free lists. A chunk
+// starts with a pointer to the heap it belongs to, so a node freed on another thread (a
+// batch thread dropping a snapshot the watcher cloned) goes back onto that heap's atomic
+// remote list, which the owner takes over once its free list runs dry. The heap of a thread
+// that exits is kept, chunks and free nodes included, and handed to the next thread that
+// allocates. Chunks are never released, but they stay bounded by the nodes live at once
+// rather than growing with every tree moved between threads.
+class NodePool {
+public:
+    static constexpr size_t granularity = 16;
+    static constexpr size_t sizeClasses = 8; // Nodes up to 128 bytes; larger ones use operator new
+    static constexpr size_t chunkSize = 64 * 1024;
+
+    static void* allocate(size_t size) {
+        size_t sizeClass = (size + granularity - 1) / granularity;
+        if (sizeClass > sizeClasses) {
+            return ::operator new(size);
+        }
+        Heap& heap = local();
+        FreeNode*& free = heap.free[sizeClass - 1];
+        if (!free) {
+            free = heap.remote[sizeClass - 1].exchange(nullptr, std::memory_order_acquire);
+        }
+        if (FreeNode* node = free) {
+            free = node->next;
+            return node;
+        }
+        size_t rounded = sizeClass * granularity;
+        if (static_cast<size_t>(heap.limit - heap.cursor) < rounded) {
+            addChunk(heap);
+        }
+        void* memory = heap.cursor;
+        heap.cursor += rounded;
+        return memory;
+    }
+
+    static void deallocate(void* memory, size_t size) {
+        size_t sizeClass = (size + granularity - 1) / granularity;
+        if (sizeClass > sizeClasses) {
+            ::operator delete(memory);
+            return;
+        }
+        auto node = static_cast<FreeNode*>(memory);
+        Heap* owner = *reinterpret_cast<Heap**>(reinterpret_cast<uintptr_t>(memory) & ~uintptr_t(chunkSize - 1));
+        if (owner == binding().heap) {
+            node->next = owner->free[sizeClass - 1];
+            owner->free[sizeClass - 1] = node;
+            return;
+        }
+        std::atomic<FreeNode*>& remote = owner->remote[sizeClass - 1];
+        node->next = remote.load(std::memory_order_relaxed);
+        while (!remote.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Chunks carved out so far, by all threads
+    static size_t chunkCount() { return chunks.load(std::memory_order_relaxed); }
+
+private:
+    struct FreeNode {
+        FreeNode* next;
+    };
+
+    struct Heap {
+        FreeNode* free[sizeClasses] = {};
+        char* cursor = nullptr;
+        char* limit = nullptr;
+        std::atomic<FreeNode*> remote[sizeClasses] = {}; // Freed by other threads
+        Heap* nextIdle = nullptr;                       // On the list of heaps no thread holds
+    };
+
+    // Binding structure: The heap a thread allocates from; it becomes idle when the thread exits
+    struct Binding {
+        Heap* heap = nullptr;
+        ~Binding();
+    };
+
+    static inline std::atomic<size_t> chunks{ 0 };
+    static Heap* idleHeaps; // Heaps of exited threads (ast.cpp, under a mutex)
+
+    static Binding& binding() {
+        thread_local Binding binding;
+        return binding;
+    }
+
+    static Heap& local() {
+        Binding& bound = binding();
+        if (!bound.heap) {
+            bound.heap = takeHeap();
+        }
+        return *bound.heap;
+    }
+
+    // An idle heap, or a new one when there is none
+    static Heap* takeHeap();
+
+    // Start carving from a new chunk (aligned to its size, so that a node finds its heap)
+    static void addChunk(Heap& heap);
+};
+
+// AST nodes: Define the structure of the AST, with each node type corresponding to constructs like statements and expressions.
+struct ASTNode {
+    virtual ~ASTNode() = default;
+
+    GLSL_NOINLINE static void* operator new(size_t size);
+    GLSL_NOINLINE static void operator delete(void* memory, size_t size);
+};
+
+// Expression nodes are immutable and shared (see ExpressionTable), so they carry no source
+// location; the statement holding an expression keeps the offset of each occurrence
+struct Expression : ASTNode {};
+
+struct Statement : ASTNode {
+    SourceOffset offset = 0; // Where the statement starts
+    // Offsets of the occurrences in the statement's expression (an if's condition), in
+    // evaluation order: the operands of a binary operation, left then right, and then its
+    // operator. Empty for input statements.
+    std::vector<SourceOffset> expressionOffsets;
+};
+
+using ASTNodePtr = std::unique_ptr<ASTNode>;
+using ExprPtr = std::unique_ptr<Expression>;
+using StmtPtr = std::unique_ptr<Statement>;
+
+// SymbolTable structure: The variables of a program; each name owns one storage slot
+struct SymbolTable {
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> slots;
+
+    uint32_t slotFor(const std::string& name) {
+        auto [entry, inserted] = slots.try_emplace(name, static_cast<uint32_t>(names.size()));
+        if (inserted) {
+            names.push_back(name);
+        }
+        return entry->second;
+    }
+};
+
+struct AssignStatement : Statement {
+    std::string identifier;
+    const Expression* expression;
+    uint32_t slot = 0;
+    AssignStatement(std::string id, const Expression* expr)
+        : identifier(std::move(id)), expression(expr) {}
+};
+
+struct PrintStatement : Statement {
+    const Expression* expression;
+    uint32_t id; // Position among the program's print statements, used by the framed output format
+    PrintStatement(const Expression* expr, uint32_t printId) : expression(expr), id(printId) {}
+};
+
+struct InputStatement : Statement {
+    std::string identifier;
+    uint32_t slot = 0;
+    explicit InputStatement(std::string id) : identifier(std::move(id)) {}
+};
+
+struct IfStatement : Statement {
+    const Expression* compareExpression;
+    std::vector<StmtPtr> thenStatements;
+    IfStatement(const Expression* compExpr, std::vector<StmtPtr> thenStmts)
+        : compareExpression(compExpr), thenStatements(std::move(thenStmts)) {}
+};
+
+// Binary operators of the language, resolved from their spelling at parse time
+enum class BinaryOp : uint8_t {
+    ADD, SUBTRACT, MULTIPLY,
+    GREATER, LESS, EQUAL, NOT_EQUAL, GREATER_EQUAL, LESS_EQUAL
+};
+
+inline bool binaryOpFromText(std::string_view text, BinaryOp& op) {
+    static const std::pair<std::string_view, BinaryOp> table[] = {
+        { "+", BinaryOp::ADD }, { "-", BinaryOp::SUBTRACT }, { "*", BinaryOp::MULTIPLY },
+        { ">", BinaryOp::GREATER }, { "<", BinaryOp::LESS }, { "==", BinaryOp::EQUAL },
+        { "!=", BinaryOp::NOT_EQUAL }, { ">=", BinaryOp::GREATER_EQUAL }, { "<=", BinaryOp::LESS_EQUAL }
+    };
+    for (const auto& [spelling, value] : table) {
+        if (spelling == text) {
+            op = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline const char* binaryOpText(BinaryOp op) {
+    switch (op) {
+    case BinaryOp::ADD: return "+";
+    case BinaryOp::SUBTRACT: return "-";
+    case BinaryOp::MULTIPLY: return "*";
+    case BinaryOp::GREATER: return ">";
+    case BinaryOp::LESS: return "<";
+    case BinaryOp::EQUAL: return "==";
+    case BinaryOp::NOT_EQUAL: return "!=";
+    case BinaryOp::GREATER_EQUAL: return ">=";
+    case BinaryOp::LESS_EQUAL: return "<=";
+    }
+    return "?";
+}
+
+// Apply a binary operator; every engine and the optimizers go through this, so they agree.
+// Arithmetic wraps around on overflow.
+inline int applyBinaryOp(BinaryOp op, int left, int right) {
+    auto l = static_cast<uint32_t>(left);
+    auto r = static_cast<uint32_t>(right);
+    switch (op) {
+    case BinaryOp::ADD: return static_cast<int>(l + r);
+    case BinaryOp::SUBTRACT: return static_cast<int>(l - r);
+    case BinaryOp::MULTIPLY: return static_cast<int>(l * r);
+    case BinaryOp::GREATER: return left > right;
+    case BinaryOp::LESS: return left < right;
+    case BinaryOp::EQUAL: return left == right;
+    case BinaryOp::NOT_EQUAL: return left != right;
+    case BinaryOp::GREATER_EQUAL: return left >= right;
+    case BinaryOp::LESS_EQUAL: return left <= right;
+    }
+    return 0;
+}
+
+struct BinaryOperation : Expression {
+    BinaryOp op;
+    const Expression* left;
+    const Expression* right;
+    BinaryOperation(BinaryOp oper, const Expression* lhs, const Expression* rhs)
+        : op(oper), left(lhs), right(rhs) {}
+};
+
+struct Identifier : Expression {
+    std::string name;
+    uint32_t slot = 0;
+    explicit Identifier(std::string id) : name(std::move(id)) {}
+};
+
+struct Number : Expression {
+    int value;
+    explicit Number(int val) : value(val) {}
+};
+
+// ExpressionTable class: The expression nodes of a program, hash-consed as they are parsed:
+// structurally identical subexpressions anywhere in the program are one node, so a node's
+// identity is its value for a given state of the variables. The table owns the nodes; nodes
+// of statements that were replaced stay until the table is rebuilt (see
+// reinternExpressions).
+class ExpressionTable {
+public:
+    const Expression* number(int value);
+    const Expression* variable(const std::string& name, uint32_t slot);
+    const Expression* binary(BinaryOp op, const Expression* left, const Expression* right);
+
+    // The node of this table with the structure of an expression from any table
+    const Expression* intern(const Expression* expression);
+
+    // Distinct nodes in the table
+    size_t size() const { return nodes.size(); }
+
+private:
+    enum class Kind : uint8_t { NUMBER, VARIABLE, BINARY };
+    using Key = std::tuple<Kind, BinaryOp, const Expression*, const Expression*, int64_t>;
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t hash = static_cast<uint64_t>(std::get<0>(key)) << 8 | static_cast<uint64_t>(std::get<1>(key));
+            hash = (hash ^ reinterpret_cast<uintptr_t>(std::get<2>(key))) * 0x9E3779B97F4A7C15ull;
+            hash = (hash ^ reinterpret_cast<uintptr_t>(std::get<3>(key))) * 0x9E3779B97F4A7C15ull;
+            hash = (hash ^ static_cast<uint64_t>(std::get<4>(key))) * 0x9E3779B97F4A7C15ull;
+            return static_cast<size_t>(hash ^ (hash >> 32));
+        }
+    };
+
+    std::vector<ExprPtr> nodes;
+    std::unordered_map<Key, const Expression*, KeyHash> byStructure;
+
+    template <typename Make>
+    const Expression* find(const Key& key, Make make);
+};
+
+struct Program : ASTNode {
+    std::vector<StmtPtr> statements;
+    SymbolTable symbols;
+    ExpressionTable expressions;
+};
+
+// Renumber print statements in source order after statements were replaced
+void numberPrintStatements(const std::vector<StmtPtr>& statements, uint32_t& nextId);
+
+// Move the source offsets of a statement (and of the occurrences in its expressions) by delta bytes
+void shiftSourceOffsets(Statement* statement, ptrdiff_t delta);
+
+// Where the statement's own expression first reads a variable, which is where evaluating
+// it fails when the variable has no value
+SourceOffset readOffset(const Statement* statement, uint32_t slot);
+
+// Deep copy of a statement for another program, keeping its source offsets, slots and print
+// ids; its expressions are interned in that program's table
+StmtPtr cloneStatement(const Statement* statement, ExpressionTable& expressions);
+
+// Point the expressions of statements at the nodes of another table; a program rebuilds its
+// table this way to drop the nodes no statement uses any more
+void reinternExpressions(const std::vector<StmtPtr>& statements, ExpressionTable& expressions);
+
+// The most input values any path through the statements can read
+size_t maxInputsRead(const std::vector<StmtPtr>& statements);
@@ -0,0 +1,212 @@
+/**
+ * @file bundle.cpp
+ * @brief Linking scripts into a bundle and loading them back
+ */
+
+#include "bundle.h"
+#include "bytecode_compiler.h"
+#include "codecs.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace program_bundle {
+    namespace {
+        void writeString(std::string& out, const std::string& text) {
+            binary_input::writeLittleEndian(out, text.size(), 4);
+            out += text;
+        }
+    }
+
+    std::string link(const std::vector<std::shared_ptr<const CompiledProgram>>& scripts) {
+        std::vector<std::string> records;
+        for (const auto& script : scripts) {
+            auto bytecode = BytecodeCompiler(*script->program, true, nullptr, true).compile();
+            std::string record;
+            writeString(record, script->path);
+            writeString(record, script->source);
+            binary_input::writeLittleEndian(record, script->program->symbols.names.size(), 4);
+            for (const auto& name : script->program->symbols.names) {
+                writeString(record, name);
+            }
+            binary_input::writeLittleEndian(record, bytecode->registerCount, 4);
+            binary_input::writeLittleEndian(record, bytecode->code.size(), 4);
+            for (const auto& in : bytecode->code) {
+                binary_input::writeLittleEndian(record, static_cast<uint8_t>(in.op), 4);
+                for (int32_t operand : { in.a, in.b, in.c }) {
+                    binary_input::writeLittleEndian(record, static_cast<uint32_t>(operand), 4);
+                }
+            }
+            records.push_back(std::move(record));
+        }
+
+        std::string out(magic, sizeof(magic));
+        out.push_back(static_cast<char>(version));
+        out.append(3, '\0');
+        binary_input::writeLittleEndian(out, records.size(), 4);
+        out.append(4, '\0');
+        uint64_t offset = headerSize + directoryEntrySize * records.size();
+        for (const auto& record : records) {
+            binary_input::writeLittleEndian(out, offset, 8);
+            binary_input::writeLittleEndian(out, record.size(), 8);
+            offset += record.size();
+        }
+        for (const auto& record : records) {
+            out += record;
+        }
+        return out;
+    }
+}
+
+namespace {
+    // Remove the CHARGE instructions of checked bytecode; a jump to one lands on the
+    // instruction after it
+    void dropCharges(Bytecode& bytecode) {
+        std::vector<int32_t> moved(bytecode.code.size());
+        int32_t kept = 0;
+        for (size_t i = 0; i < bytecode.code.size(); ++i) {
+            moved[i] = kept;
+            kept += bytecode.code[i].op != OpCode::CHARGE;
+        }
+        std::vector<Instruction> code;
+        code.reserve(static_cast<size_t>(kept));
+        for (Instruction in : bytecode.code) {
+            if (in.op == OpCode::CHARGE) {
+                continue;
+            }
+            if (in.op == OpCode::JUMP || isConditionalJump(in.op)) {
+                in.a = moved[in.a];
+            }
+            code.push_back(in);
+        }
+        bytecode.code = std::move(code);
+    }
+}
+
+ProgramBundle::ProgramBundle(const std::string& path) : path(path), file(path) {
+    if (file.size() < program_bundle::headerSize ||
+        std::memcmp(file.data(), program_bundle::magic, sizeof(program_bundle::magic)) != 0 ||
+        static_cast<uint8_t>(file.data()[4]) != program_bundle::version) {
+        fail();
+    }
+    size_t scriptCount = binary_input::readLittleEndian(file.data() + 8, 4);
+    if ((file.size() - program_bundle::headerSize) / program_bundle::directoryEntrySize < scriptCount) {
+        fail();
+    }
+    scriptNames.reserve(scriptCount);
+    index.reserve(scriptCount);
+    for (size_t i = 0; i < scriptCount; ++i) {
+        scriptNames.push_back(record(i).string());
+        index.emplace(scriptNames.back(), i); // --link rejects duplicates; the first one wins
+    }
+}
+
+std::shared_ptr<const CompiledProgram> ProgramBundle::load(const std::string& name) const {
+    auto found = index.find(name);
+    if (found == index.end()) {
+        throw std::runtime_error("No script '" + name + "' in bundle '" + path + "'");
+    }
+    Reader reader = record(found->second);
+    reader.string();
+    return decode(name, reader);
+}
+
+ProgramBundle::Reader ProgramBundle::record(size_t index) const {
+    const char* entry = file.data() + program_bundle::headerSize + index * program_bundle::directoryEntrySize;
+    uint64_t offset = binary_input::readLittleEndian(entry, 8);
+    uint64_t size = binary_input::readLittleEndian(entry + 8, 8);
+    if (offset > file.size() || size > file.size() - offset) {
+        fail();
+    }
+    return { this, file.data() + offset, file.data() + offset + size };
+}
+
+std::shared_ptr<const CompiledProgram> ProgramBundle::decode(const std::string& name, Reader& reader) const {
+    auto compiled = std::make_shared<CompiledProgram>();
+    compiled->path = name;
+    compiled->source = reader.string();
+    compiled->sourceHash = fnv1a64(compiled->source.data(), compiled->source.size());
+    compiled->program = std::make_unique<Program>();
+    uint64_t variables = reader.integer(4);
+    for (uint64_t i = 0; i < variables; ++i) {
+        compiled->program->symbols.slotFor(reader.string());
+    }
+    if (compiled->program->symbols.names.size() != variables) {
+        fail();
+    }
+
+    auto bytecode = std::make_shared<Bytecode>();
+    bytecode->variableCount = static_cast<uint32_t>(variables);
+    bytecode->registerCount = static_cast<uint32_t>(reader.integer(4));
+    uint64_t count = reader.integer(4);
+    if (bytecode->registerCount < variables ||
+        static_cast<uint64_t>(reader.end - reader.position) / program_bundle::instructionSize < count) {
+        fail();
+    }
+    bytecode->code.reserve(static_cast<size_t>(count));
+    for (uint64_t i = 0; i < count; ++i) {
+        Instruction in;
+        uint64_t op = reader.integer(4);
+        in.a = static_cast<int32_t>(reader.integer(4));
+        in.b = static_cast<int32_t>(reader.integer(4));
+        in.c = static_cast<int32_t>(reader.integer(4));
+        if (op > static_cast<uint64_t>(OpCode::HALT)) {
+            fail();
+        }
+        in.op = static_cast<OpCode>(op);
+        bytecode->code.push_back(in);
+    }
+    if (count == 0 || (bytecode->code.back().op != OpCode::HALT && bytecode->code.back().op != OpCode::JUMP)) {
+        fail();
+    }
+    for (const auto& in : bytecode->code) {
+        validate(in, *bytecode);
+    }
+    if (!runLimits.chargesBlocks()) {
+        dropCharges(*bytecode);
+    }
+    bytecode->sources.assign(bytecode->code.size(), nullptr);
+    compiled->linked = std::move(bytecode);
+    return compiled;
+}
+
+void ProgramBundle::validate(const Instruction& in, const Bytecode& bytecode) const {
+    auto reg = [&](int32_t value) {
+        if (value < 0 || static_cast<uint32_t>(value) >= bytecode.registerCount) fail();
+    };
+    auto variable = [&](int32_t value) {
+        if (value < 0 || static_cast<uint32_t>(value) >= bytecode.variableCount) fail();
+    };
+    auto target = [&](int32_t value) {
+        if (value < 0 || static_cast<size_t>(value) >= bytecode.code.size()) fail();
+    };
+    switch (in.op) {
+    case OpCode::LOAD_CONST: reg(in.a); break;
+    case OpCode::JUMP: target(in.a); break;
+    case OpCode::JUMP_IF_FALSE:
+    case OpCode::JUMP_IF_TRUE: target(in.a); reg(in.b); break;
+    case OpCode::INPUT_EXPECT: fail();
+    case OpCode::INPUT:
+    case OpCode::CHECK_ASSIGNED:
+    case OpCode::MARK_ASSIGNED: variable(in.a); break;
+    case OpCode::PRINT: reg(in.a); break;
+    case OpCode::CHARGE:
+    case OpCode::HALT: break;
+    case OpCode::MOVE: reg(in.a); reg(in.b); break;
+    case OpCode::SHIFT_LEFT_CONST: reg(in.a); reg(in.b); if (in.c < 0 || in.c > 31) fail(); break;
+    default:
+        if (isConditionalJump(in.op)) {
+            target(in.a);
+        }
+        else {
+            reg(in.a);
+        }
+        reg(in.b);
+        if (in.op < OpCode::ADD_CONST) {
+            reg(in.c);
+        }
+        break;
+    }
+}
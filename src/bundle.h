@@ -0,0 +1,98 @@
+/**
+ * @file bundle.h
+ * @brief The program bundle format (--link, --bundle=)
+ */
+
+#pragma once
+
+#include "bytecode.h"
+#include "io.h"
+#include "program.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Program bundle format (--link): many scripts compiled to optimized bytecode in one file.
+// A batch run maps the file once (--bundle=) and decodes only the scripts it runs, so no
+// script is lexed, parsed or compiled at startup. Little-endian throughout:
+//   header    - magic "GLBN" | version (u8) | 3 reserved bytes | script count (u32) | reserved (u32)
+//   directory - per script: offset (u64) and size (u64) of its record
+//   record    - name and source (u32 length, then bytes) | variable count (u32) and the
+//               variable names | register count (u32) | instruction count (u32) | 16-byte
+//               instructions: opcode (u8), 3 reserved bytes, a, b, c (i32)
+// Bytecode is register-allocated at link time, and charges every block to the run limits;
+// load() drops the charges when neither --max-fuel nor --max-output is set.
+namespace program_bundle {
+    constexpr char magic[4] = { 'G', 'L', 'B', 'N' };
+    constexpr uint8_t version = 2;
+    constexpr size_t headerSize = 16;
+    constexpr size_t directoryEntrySize = 16;
+    constexpr size_t instructionSize = 16;
+
+    // Serialize compiled scripts, each under its path
+    std::string link(const std::vector<std::shared_ptr<const CompiledProgram>>& scripts);
+}
+
+// ProgramBundle class: A bundle file mapped into memory. Opening it indexes the script
+// names (only the names are read); load() decodes one script into a snapshot whose program
+// holds only the symbol table, with its bytecode in linked. Every record is checked, so a
+// damaged bundle cannot make the VM read out of bounds. The run limits in force at load()
+// apply to the scripts it returns.
+class ProgramBundle {
+public:
+    explicit ProgramBundle(const std::string& path);
+
+    size_t size() const { return scriptNames.size(); }
+
+    // Script names in the order they were linked
+    const std::vector<std::string>& names() const { return scriptNames; }
+
+    std::shared_ptr<const CompiledProgram> load(const std::string& name) const;
+
+private:
+    // Reader structure: Bounds-checked reads within one record
+    struct Reader {
+        const ProgramBundle* bundle;
+        const char* position;
+        const char* end;
+
+        uint64_t integer(size_t width) {
+            if (static_cast<size_t>(end - position) < width) {
+                bundle->fail();
+            }
+            uint64_t value = binary_input::readLittleEndian(position, width);
+            position += width;
+            return value;
+        }
+
+        std::string string() {
+            uint64_t length = integer(4);
+            if (static_cast<uint64_t>(end - position) < length) {
+                bundle->fail();
+            }
+            std::string text(position, static_cast<size_t>(length));
+            position += length;
+            return text;
+        }
+    };
+
+    std::string path;
+    FileData file;
+    std::vector<std::string> scriptNames;
+    std::unordered_map<std::string, size_t> index; // Script name to directory entry
+
+    [[noreturn]] void fail() const { throw std::runtime_error("Invalid bundle '" + path + "'"); }
+
+    Reader record(size_t index) const;
+
+    // Decode the rest of a record whose name has been read
+    std::shared_ptr<const CompiledProgram> decode(const std::string& name, Reader& reader) const;
+
+    // Check that an instruction's registers, variables and jump targets are in range. Linked
+    // code never speculates, so INPUT_EXPECT is rejected too.
+    void validate(const Instruction& in, const Bytecode& bytecode) const;
+};
@@ -0,0 +1,180 @@
+/**
+ * @file bytecode.h
+ * @brief Register bytecode shared by the compiled tiers, and its register allocator
+ */
+
+#pragma once
+
+#include "ast.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Register bytecode for the faster execution tiers. Registers hold ints: the program's
+// variables come first (indexed by symbol slot), then the compiler's temporaries.
+enum class OpCode : uint8_t {
+    LOAD_CONST,     // r[a] = b
+    MOVE,           // r[a] = r[b]
+    ADD,            // r[a] = r[b] <op> r[c], for ADD through LESS_EQUAL
+    SUBTRACT,
+    MULTIPLY,
+    GREATER,
+    LESS,
+    EQUAL,
+    NOT_EQUAL,
+    GREATER_EQUAL,
+    LESS_EQUAL,
+    JUMP,           // pc = a
+    JUMP_IF_FALSE,  // if (!r[b]) pc = a
+    JUMP_IF_TRUE,   // if (r[b]) pc = a
+    JUMP_IF_GREATER, // if (r[b] <op> r[c]) pc = a: a comparison fused with its branch,
+    JUMP_IF_LESS,    // for JUMP_IF_GREATER through JUMP_IF_LESS_EQUAL
+    JUMP_IF_EQUAL,
+    JUMP_IF_NOT_EQUAL,
+    JUMP_IF_GREATER_EQUAL,
+    JUMP_IF_LESS_EQUAL,
+    ADD_CONST,       // r[a] = r[b] + c
+    SUBTRACT_CONST,  // r[a] = r[b] - c
+    CONST_SUBTRACT,  // r[a] = c - r[b]
+    MULTIPLY_CONST,  // r[a] = r[b] * c
+    SHIFT_LEFT_CONST, // r[a] = r[b] << c (multiplication by a power of two)
+    INPUT,          // r[a] = next input value; b = source offset
+    INPUT_EXPECT,   // INPUT, then deoptimize unless the value read is c
+    PRINT,          // print r[a] as print statement b
+    CHECK_ASSIGNED, // fail unless variable a holds a value; b = source offset
+    MARK_ASSIGNED,  // variable a now holds a value
+    CHARGE,         // charge a block of a statements to the run limits; b = source offset
+    HALT
+};
+
+inline OpCode binaryOpCode(BinaryOp op) {
+    return static_cast<OpCode>(static_cast<uint8_t>(OpCode::ADD) + static_cast<uint8_t>(op));
+}
+
+inline bool isComparison(OpCode op) {
+    return op >= OpCode::GREATER && op <= OpCode::LESS_EQUAL;
+}
+
+inline bool isConditionalJump(OpCode op) {
+    return op >= OpCode::JUMP_IF_FALSE && op <= OpCode::JUMP_IF_LESS_EQUAL;
+}
+
+// The fused branch taken when a comparison holds (or, inverted, when it does not)
+inline OpCode fusedBranch(OpCode comparison, bool inverted) {
+    static constexpr OpCode onTrue[] = {
+        OpCode::JUMP_IF_GREATER, OpCode::JUMP_IF_LESS, OpCode::JUMP_IF_EQUAL,
+        OpCode::JUMP_IF_NOT_EQUAL, OpCode::JUMP_IF_GREATER_EQUAL, OpCode::JUMP_IF_LESS_EQUAL
+    };
+    static constexpr OpCode onFalse[] = {
+        OpCode::JUMP_IF_LESS_EQUAL, OpCode::JUMP_IF_GREATER_EQUAL, OpCode::JUMP_IF_NOT_EQUAL,
+        OpCode::JUMP_IF_EQUAL, OpCode::JUMP_IF_LESS, OpCode::JUMP_IF_GREATER
+    };
+    size_t index = static_cast<size_t>(comparison) - static_cast<size_t>(OpCode::GREATER);
+    return inverted ? onFalse[index] : onTrue[index];
+}
+
+struct Instruction {
+    OpCode op;
+    int32_t a = 0;
+    int32_t b = 0;
+    int32_t c = 0;
+};
+
+// How often a conditional jump was reached and how often its condition held
+struct BranchCounts {
+    uint64_t seen = 0;
+    uint64_t taken = 0;
+};
+
+// How often an input statement ran, and whether it read the same value every time
+struct InputCounts {
+    uint64_t seen = 0;
+    int value = 0;
+    bool stable = true;
+};
+
+// Profile collected by the baseline tier, keyed by the statement each counter came from
+struct ExecutionProfile {
+    std::unordered_map<const IfStatement*, BranchCounts> branches;
+    std::unordered_map<const InputStatement*, InputCounts> inputs;
+};
+
+// Bytecode structure: A program compiled for BytecodeVM
+struct Bytecode {
+    std::vector<Instruction> code;
+    std::vector<const Statement*> sources; // Per instruction: the statement of a profiled jump or input
+    uint32_t variableCount = 0;            // Registers [0, variableCount) are the variables
+    uint32_t registerCount = 0;
+    int tier = 1;
+};
+
+// Register allocation for the compiled tiers (--regalloc). NAIVE gives every temporary a
+// register of its own; LINEAR_SCAN packs them into as few registers as their live
+// ranges allow, so the register file stays small and cache resident.
+enum class RegisterAllocation { NAIVE, LINEAR_SCAN };
+inline RegisterAllocation registerAllocation = RegisterAllocation::LINEAR_SCAN;
+
+// The register an instruction defines and those it reads, -1 where it has none.
+// CHECK_ASSIGNED and MARK_ASSIGNED name variables rather than registers.
+void instructionRegisters(const Instruction& in, int32_t& def, int32_t& use1, int32_t& use2);
+
+// Liveness class: Which registers of a Bytecode may still be read, solved over its basic
+// blocks (leaders are the entry, jump targets and whatever follows a jump or HALT).
+// Registers below firstRegister are not tracked.
+class Liveness {
+public:
+    struct Block {
+        size_t from;
+        size_t to; // Last instruction
+        std::vector<size_t> successors;
+    };
+
+    explicit Liveness(const Bytecode& bytecode, uint32_t firstRegister = 0);
+
+    const std::vector<Block>& blocks() const { return blockList; }
+    size_t blockOf(size_t pc) const { return blockIndex[pc]; }
+
+    bool liveIn(size_t block, int32_t reg) const { return bit(in[block], reg); }
+    bool liveOut(size_t block, int32_t reg) const { return bit(out[block], reg); }
+
+    // Whether the value reg holds just after instruction pc may still be read
+    bool liveAfter(size_t pc, int32_t reg) const;
+
+private:
+    const Bytecode& bytecode;
+    uint32_t first;
+    std::vector<Block> blockList;
+    std::vector<size_t> blockIndex;
+    std::vector<std::vector<uint64_t>> in;
+    std::vector<std::vector<uint64_t>> out;
+
+    bool bit(const std::vector<uint64_t>& set, int32_t reg) const {
+        size_t index = static_cast<size_t>(reg - static_cast<int32_t>(first));
+        return (set[index / 64] >> (index % 64)) & 1;
+    }
+};
+
+// RegisterAssignment structure: Where allocateRegisters put each register of a Bytecode
+struct RegisterAssignment {
+    std::vector<int32_t> machine;   // Per register: its machine register, or -1
+    std::vector<int32_t> spillSlot; // Per register left without a machine register: its spill slot, or -1
+    uint32_t machineRegisters = 0;  // Machine registers used
+    uint32_t spillSlots = 0;
+    uint32_t spilled = 0;           // Registers given a spill slot
+};
+
+// Linear-scan register allocation of a Bytecode's registers (from firstRegister on) to at
+// most `available` machine registers. Each register gets the interval that covers all its
+// live positions, and intervals are assigned in order of their start, lowest free machine
+// register first, a register becoming free when its interval ends. Positions are doubled
+// so that an instruction's uses come before its definition: a register read for the last
+// time can hand its machine register to the result of the same instruction. When none is
+// free, the interval ending last (the new one or an active one) is spilled whole; spilled
+// intervals then share spill slots the same way. Registers never referenced get neither.
+RegisterAssignment allocateRegisters(const Bytecode& bytecode, uint32_t available, uint32_t firstRegister = 0);
+
+// Pack a Bytecode's temporaries into as few registers as their live ranges allow
+// (allocateRegisters without a limit); variables keep their slot's register
+void compactRegisters(Bytecode& bytecode);
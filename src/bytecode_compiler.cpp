@@ -0,0 +1,351 @@
+/**
+ * @file bytecode_compiler.cpp
+ * @brief Bytecode generation, constant folding, CSE and profile-guided layout
+ */
+
+#include "bytecode_compiler.h"
+#include "runtime.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+std::unique_ptr<Bytecode> BytecodeCompiler::compile() {
+    size_t variableCount = program.symbols.names.size();
+    bytecode = std::make_unique<Bytecode>();
+    bytecode->tier = optimize ? 2 : 1;
+    bytecode->variableCount = static_cast<uint32_t>(variableCount);
+    bytecode->registerCount = static_cast<uint32_t>(variableCount);
+
+    chargesBlocks = chargeEveryBlock || needsBlockCharges(program);
+    std::vector<uint8_t> definite(variableCount);
+    checkedSlots.assign(variableCount, 0);
+    findCheckedSlots(program.statements, definite);
+
+    FlowState state;
+    state.definite.assign(variableCount, 0);
+    state.known.assign(variableCount, 0);
+    state.values.assign(variableCount, 0);
+    compileStatements(program.statements, state);
+    emit({ OpCode::HALT });
+
+    // Out-of-line bodies jump back to just after their if statement (and may add more)
+    for (size_t i = 0; i < coldBodies.size(); ++i) {
+        ColdBody body = std::move(coldBodies[i]);
+        bytecode->code[body.branch].a = static_cast<int32_t>(bytecode->code.size());
+        compileStatements(body.statement->thenStatements, body.state);
+        emit({ OpCode::JUMP, static_cast<int32_t>(body.resume) });
+    }
+    if (registerAllocation == RegisterAllocation::LINEAR_SCAN) {
+        compactRegisters(*bytecode);
+    }
+    return std::move(bytecode);
+}
+
+int32_t BytecodeCompiler::materialize(Operand operand) {
+    if (!operand.isConstant) {
+        return operand.value;
+    }
+    int32_t reg = newTemporary();
+    emit({ OpCode::LOAD_CONST, reg, operand.value });
+    return reg;
+}
+
+bool BytecodeCompiler::isCold(const IfStatement* ifStmt) const {
+    if (!optimize || !profile) {
+        return false;
+    }
+    auto found = profile->branches.find(ifStmt);
+    return found != profile->branches.end() && found->second.seen >= coldMinimumSamples &&
+           found->second.taken * coldRatio <= found->second.seen;
+}
+
+const InputCounts* BytecodeCompiler::stableInput(const InputStatement* inputStmt) const {
+    if (!optimize || !profile) {
+        return nullptr;
+    }
+    auto found = profile->inputs.find(inputStmt);
+    if (found == profile->inputs.end() || !found->second.stable || found->second.seen < stableInputSamples) {
+        return nullptr;
+    }
+    return &found->second;
+}
+
+const std::vector<uint32_t>& BytecodeCompiler::readSlots(const Expression* expression) {
+    auto found = readSets.find(expression);
+    if (found != readSets.end()) {
+        return found->second;
+    }
+    std::vector<uint32_t> slots;
+    if (auto binOp = dynamic_cast<const BinaryOperation*>(expression)) {
+        const auto& left = readSlots(binOp->left);
+        const auto& right = readSlots(binOp->right);
+        std::set_union(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(slots));
+    }
+    else if (auto ident = dynamic_cast<const Identifier*>(expression)) {
+        slots.push_back(ident->slot);
+    }
+    return readSets.emplace(expression, std::move(slots)).first->second;
+}
+
+bool BytecodeCompiler::reads(const Expression* expression, uint32_t slot) {
+    const auto& slots = readSlots(expression);
+    return std::binary_search(slots.begin(), slots.end(), slot);
+}
+
+void BytecodeCompiler::findCheckedSlots(const std::vector<StmtPtr>& statements, std::vector<uint8_t>& definite) {
+    for (auto& statement : statements) {
+        if (auto assignStmt = dynamic_cast<const AssignStatement*>(statement.get())) {
+            findCheckedReads(assignStmt->expression, definite);
+            definite[assignStmt->slot] = 1;
+        }
+        else if (auto printStmt = dynamic_cast<const PrintStatement*>(statement.get())) {
+            findCheckedReads(printStmt->expression, definite);
+        }
+        else if (auto inputStmt = dynamic_cast<const InputStatement*>(statement.get())) {
+            definite[inputStmt->slot] = 1;
+        }
+        else if (auto ifStmt = dynamic_cast<const IfStatement*>(statement.get())) {
+            findCheckedReads(ifStmt->compareExpression, definite);
+            std::vector<uint8_t> inner = definite;
+            findCheckedSlots(ifStmt->thenStatements, inner);
+        }
+    }
+}
+
+void BytecodeCompiler::findCheckedReads(const Expression* expression, const std::vector<uint8_t>& definite) {
+    if (auto binOp = dynamic_cast<const BinaryOperation*>(expression)) {
+        findCheckedReads(binOp->left, definite);
+        findCheckedReads(binOp->right, definite);
+    }
+    else if (auto ident = dynamic_cast<const Identifier*>(expression)) {
+        if (!definite[ident->slot]) {
+            checkedSlots[ident->slot] = 1;
+        }
+    }
+}
+
+void BytecodeCompiler::invalidate(uint32_t slot, FlowState& state) {
+    state.known[slot] = 0;
+    for (auto entry = state.available.begin(); entry != state.available.end();) {
+        if (entry->second == static_cast<int32_t>(slot) || reads(entry->first, slot)) {
+            entry = state.available.erase(entry);
+        }
+        else {
+            ++entry;
+        }
+    }
+}
+
+void BytecodeCompiler::forgetAssigned(const std::vector<StmtPtr>& statements, FlowState& state) {
+    for (auto& statement : statements) {
+        if (auto assignStmt = dynamic_cast<const AssignStatement*>(statement.get())) {
+            invalidate(assignStmt->slot, state);
+        }
+        else if (auto inputStmt = dynamic_cast<const InputStatement*>(statement.get())) {
+            invalidate(inputStmt->slot, state);
+        }
+        else if (auto ifStmt = dynamic_cast<const IfStatement*>(statement.get())) {
+            forgetAssigned(ifStmt->thenStatements, state);
+        }
+    }
+}
+
+void BytecodeCompiler::markAssigned(uint32_t slot, FlowState& state) {
+    if (checkedSlots[slot] && !state.definite[slot]) {
+        emit({ OpCode::MARK_ASSIGNED, static_cast<int32_t>(slot) });
+    }
+    state.definite[slot] = 1;
+}
+
+void BytecodeCompiler::setKnown(uint32_t slot, Operand value, FlowState& state) {
+    invalidate(slot, state);
+    state.known[slot] = value.isConstant;
+    state.values[slot] = value.isConstant ? value.value : 0;
+}
+
+void BytecodeCompiler::compileStatements(const std::vector<StmtPtr>& statements, FlowState& state) {
+    if (chargesBlocks && !statements.empty()) {
+        emit({ OpCode::CHARGE, static_cast<int32_t>(statements.size()), static_cast<int32_t>(statements.front()->offset) });
+    }
+    for (auto& statement : statements) {
+        compileStatement(statement.get(), state);
+    }
+}
+
+void BytecodeCompiler::compileStatement(const Statement* statement, FlowState& state) {
+    if (auto assignStmt = dynamic_cast<const AssignStatement*>(statement)) {
+        auto slot = static_cast<int32_t>(assignStmt->slot);
+        Operand value = compileExpression(assignStmt->expression, statement, state, slot);
+        if (value.isConstant) {
+            emit({ OpCode::LOAD_CONST, slot, value.value });
+        }
+        else if (value.value != slot) {
+            emit({ OpCode::MOVE, slot, value.value });
+        }
+        markAssigned(assignStmt->slot, state);
+        setKnown(assignStmt->slot, value, state);
+        // A value computed straight into the variable stays reusable while it holds
+        if (optimize && value.value == slot && !value.isConstant &&
+            dynamic_cast<const BinaryOperation*>(assignStmt->expression)) {
+            if (!reads(assignStmt->expression, assignStmt->slot)) {
+                state.available[assignStmt->expression] = slot;
+            }
+        }
+    }
+    else if (auto printStmt = dynamic_cast<const PrintStatement*>(statement)) {
+        int32_t reg = materialize(compileExpression(printStmt->expression, statement, state));
+        emit({ OpCode::PRINT, reg, static_cast<int32_t>(printStmt->id) });
+    }
+    else if (auto inputStmt = dynamic_cast<const InputStatement*>(statement)) {
+        auto slot = static_cast<int32_t>(inputStmt->slot);
+        auto offset = static_cast<int32_t>(inputStmt->offset);
+        if (auto stable = stableInput(inputStmt)) {
+            emit({ OpCode::INPUT_EXPECT, slot, offset, stable->value }, inputStmt);
+            setKnown(inputStmt->slot, { true, stable->value }, state);
+        }
+        else {
+            emit({ OpCode::INPUT, slot, offset }, inputStmt);
+            invalidate(inputStmt->slot, state);
+        }
+        markAssigned(inputStmt->slot, state);
+    }
+    else if (auto ifStmt = dynamic_cast<const IfStatement*>(statement)) {
+        Operand condition = compileExpression(ifStmt->compareExpression, statement, state);
+        FlowState inner = state;
+        if (condition.isConstant) {
+            if (condition.value) {
+                compileStatements(ifStmt->thenStatements, inner);
+                // The body always runs, so its constants hold after it
+                state.known = std::move(inner.known);
+                state.values = std::move(inner.values);
+                state.available = std::move(inner.available);
+            }
+            return;
+        }
+        if (isCold(ifStmt)) {
+            size_t branch = emitBranch(condition.value, false, ifStmt, state, inner);
+            coldBodies.push_back({ ifStmt, branch, bytecode->code.size(), std::move(inner) });
+        }
+        else {
+            size_t branch = emitBranch(condition.value, true, ifStmt, state, inner);
+            compileStatements(ifStmt->thenStatements, inner);
+            bytecode->code[branch].a = static_cast<int32_t>(bytecode->code.size());
+        }
+        forgetAssigned(ifStmt->thenStatements, state);
+    }
+    else {
+        throw std::runtime_error("Unexpected statement");
+    }
+}
+
+size_t BytecodeCompiler::emitBranch(int32_t condition, bool inverted, const IfStatement* ifStmt, FlowState& state, FlowState& inner) {
+    const Instruction& last = bytecode->code.empty() ? Instruction{ OpCode::HALT } : bytecode->code.back();
+    if (optimize && isComparison(last.op) && last.a == condition &&
+        condition >= static_cast<int32_t>(bytecode->variableCount)) {
+        Instruction fused{ fusedBranch(last.op, inverted), 0, last.b, last.c };
+        bytecode->code.pop_back();
+        bytecode->sources.pop_back();
+        for (FlowState* flow : { &state, &inner }) {
+            for (auto entry = flow->available.begin(); entry != flow->available.end();) {
+                entry = entry->second == condition ? flow->available.erase(entry) : std::next(entry);
+            }
+        }
+        return emit(fused, ifStmt);
+    }
+    return emit({ inverted ? OpCode::JUMP_IF_FALSE : OpCode::JUMP_IF_TRUE, 0, condition }, ifStmt);
+}
+
+bool BytecodeCompiler::compileWithConstant(BinaryOp op, Operand left, Operand right, int32_t target, Operand& result) {
+    if (left.isConstant && (op == BinaryOp::ADD || op == BinaryOp::MULTIPLY)) {
+        std::swap(left, right);
+    }
+    OpCode code;
+    int32_t immediate = right.value;
+    auto unsignedValue = static_cast<uint32_t>(right.value);
+    if (left.isConstant) {
+        if (op != BinaryOp::SUBTRACT) {
+            return false;
+        }
+        code = OpCode::CONST_SUBTRACT;
+        immediate = left.value;
+        left = right;
+    }
+    else if (op == BinaryOp::ADD || op == BinaryOp::SUBTRACT) {
+        if (immediate == 0) {
+            result = left;
+            return true;
+        }
+        code = op == BinaryOp::ADD ? OpCode::ADD_CONST : OpCode::SUBTRACT_CONST;
+    }
+    else if (op == BinaryOp::MULTIPLY) {
+        if (immediate == 0 || immediate == 1) {
+            result = immediate == 0 ? Operand{ true, 0 } : left;
+            return true;
+        }
+        if ((unsignedValue & (unsignedValue - 1)) == 0) {
+            code = OpCode::SHIFT_LEFT_CONST;
+            for (immediate = 0; (unsignedValue >> immediate) != 1; ++immediate) {}
+        }
+        else {
+            code = OpCode::MULTIPLY_CONST;
+        }
+    }
+    else {
+        return false;
+    }
+    int32_t reg = target >= 0 ? target : newTemporary();
+    emit({ code, reg, left.value, immediate });
+    result = { false, reg };
+    return true;
+}
+
+BytecodeCompiler::Operand BytecodeCompiler::compileExpression(const Expression* expression, const Statement* statement,
+                                                              FlowState& state, int32_t target) {
+    if (auto binOp = dynamic_cast<const BinaryOperation*>(expression)) {
+        if (optimize) {
+            auto reused = state.available.find(binOp);
+            if (reused != state.available.end()) {
+                return { false, reused->second };
+            }
+        }
+        Operand left = compileExpression(binOp->left, statement, state);
+        Operand right = compileExpression(binOp->right, statement, state);
+        if (left.isConstant && right.isConstant) {
+            return { true, applyBinaryOp(binOp->op, left.value, right.value) };
+        }
+        Operand result;
+        if (!(left.isConstant || right.isConstant) || !compileWithConstant(binOp->op, left, right, target, result)) {
+            int32_t leftReg = materialize(left);
+            int32_t rightReg = materialize(right);
+            result = { false, target >= 0 ? target : newTemporary() };
+            emit({ binaryOpCode(binOp->op), result.value, leftReg, rightReg });
+        }
+        if (optimize && !result.isConstant) {
+            state.available[binOp] = result.value;
+        }
+        return result;
+    }
+    else if (auto ident = dynamic_cast<const Identifier*>(expression)) {
+        auto slot = static_cast<int32_t>(ident->slot);
+        if (!state.definite[ident->slot]) {
+            emit({ OpCode::CHECK_ASSIGNED, slot, static_cast<int32_t>(readOffset(statement, ident->slot)) });
+        }
+        if (state.known[ident->slot]) {
+            return { true, state.values[ident->slot] };
+        }
+        return { false, slot };
+    }
+    else if (auto num = dynamic_cast<const Number*>(expression)) {
+        if (optimize) {
+            return { true, num->value };
+        }
+        int32_t result = target >= 0 ? target : newTemporary();
+        emit({ OpCode::LOAD_CONST, result, num->value });
+        return { false, result };
+    }
+    else {
+        throw std::runtime_error("Unexpected expression");
+    }
+}
@@ -0,0 +1,123 @@
+/**
+ * @file bytecode_compiler.h
+ * @brief Compilation of programs to register bytecode (tiers 1 and 2)
+ */
+
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// BytecodeCompiler class: Compiles a Program to register bytecode.
+// The baseline tier (1) translates the AST as it is. The optimizing tier (2) also
+// propagates and folds constants, drops or inlines if statements whose condition is
+// constant, reuses the value of a repeated subexpression (the parser shares one node
+// between identical ones) until one of its variables is assigned, and uses the baseline profile: if bodies that
+// are rarely entered move out of line, after the main path, and input statements that
+// have always read the same value are specialized on it behind a guard that deoptimizes
+// the run when the value differs.
+// Either way, variables are only checked for a value at run time where they are read
+// before being definitely assigned.
+class BytecodeCompiler {
+public:
+    // chargeEveryBlock emits CHARGE at every block whatever the current run limits, for
+    // bytecode that outlives them (program bundles)
+    BytecodeCompiler(const Program& program, bool optimize, const ExecutionProfile* profile = nullptr,
+                     bool chargeEveryBlock = false)
+        : program(program), optimize(optimize), profile(profile), chargeEveryBlock(chargeEveryBlock) {}
+
+    std::unique_ptr<Bytecode> compile();
+
+private:
+    // Bodies entered on fewer than 1 in coldRatio runs of the if, once it has been seen
+    // coldMinimumSamples times, are laid out of line
+    static constexpr uint64_t coldMinimumSamples = 100;
+    static constexpr uint64_t coldRatio = 20;
+    // Input statements are specialized once they have read the same value this many times
+    static constexpr uint64_t stableInputSamples = 50;
+
+    // An expression result: a register, or (in the optimizing tier) a known constant
+    struct Operand {
+        bool isConstant;
+        int32_t value; // The constant, or the register number
+    };
+
+    // What is known about the variables at a point of the program, by slot
+    struct FlowState {
+        std::vector<uint8_t> definite; // Assigned on every path to this point
+        std::vector<uint8_t> known;    // Holds a value known at compile time (optimizing tier)
+        std::vector<int> values;       // That value
+        std::unordered_map<const Expression*, int32_t> available; // Register holding a node's value on every path
+    };
+
+    struct ColdBody {
+        const IfStatement* statement;
+        size_t branch;
+        size_t resume;
+        FlowState state;
+    };
+
+    const Program& program;
+    bool optimize;
+    const ExecutionProfile* profile;
+    bool chargeEveryBlock;
+    std::unique_ptr<Bytecode> bytecode;
+    std::vector<uint8_t> checkedSlots; // Variables read somewhere before being definitely assigned
+    bool chargesBlocks = false;        // Emit CHARGE at every block (see needsBlockCharges)
+    std::vector<ColdBody> coldBodies;
+    std::unordered_map<const Expression*, std::vector<uint32_t>> readSets; // Slots each node reads, sorted
+
+    size_t emit(Instruction instruction, const Statement* source = nullptr) {
+        bytecode->code.push_back(instruction);
+        bytecode->sources.push_back(source);
+        return bytecode->code.size() - 1;
+    }
+
+    int32_t newTemporary() {
+        return static_cast<int32_t>(bytecode->registerCount++);
+    }
+
+    int32_t materialize(Operand operand);
+    bool isCold(const IfStatement* ifStmt) const;
+    const InputCounts* stableInput(const InputStatement* inputStmt) const;
+
+    // The variables an expression reads, by slot
+    const std::vector<uint32_t>& readSlots(const Expression* expression);
+    bool reads(const Expression* expression, uint32_t slot);
+
+    // First pass: find the variables that need run-time checks (if bodies may not run, so
+    // assignments in them do not count after the if)
+    void findCheckedSlots(const std::vector<StmtPtr>& statements, std::vector<uint8_t>& definite);
+    void findCheckedReads(const Expression* expression, const std::vector<uint8_t>& definite);
+
+    // A variable is assigned: forget what was known about it and every reused value that
+    // depends on it (or is held in its register)
+    void invalidate(uint32_t slot, FlowState& state);
+
+    // Forget what is known about every variable the statements may assign
+    void forgetAssigned(const std::vector<StmtPtr>& statements, FlowState& state);
+
+    void markAssigned(uint32_t slot, FlowState& state);
+    void setKnown(uint32_t slot, Operand value, FlowState& state);
+    void compileStatements(const std::vector<StmtPtr>& statements, FlowState& state);
+    void compileStatement(const Statement* statement, FlowState& state);
+
+    // Emit the conditional jump of an if statement: taken when the condition register is
+    // false (inverted) or true. In the optimizing tier a comparison computed just before
+    // into a temporary is fused into the jump, and its result no longer exists.
+    size_t emitBranch(int32_t condition, bool inverted, const IfStatement* ifStmt, FlowState& state, FlowState& inner);
+
+    // Emit a binary operation with one constant operand as a single instruction where one
+    // fits (x + c, x - c, c - x, x * c, and a shift for a power of two); false otherwise
+    bool compileWithConstant(BinaryOp op, Operand left, Operand right, int32_t target, Operand& result);
+
+    // Compile the expression of a statement; the result goes to target (when given) unless
+    // it is a variable's own register or a constant
+    Operand compileExpression(const Expression* expression, const Statement* statement, FlowState& state, int32_t target = -1);
+};
@@ -0,0 +1,107 @@
+/**
+ * @file bytecode_vm.cpp
+ * @brief Bytecode dispatch loop and profile collection
+ */
+
+#include "bytecode_vm.h"
+
+#include <algorithm>
+
+bool BytecodeVM::run(InputSpan inputs, std::string& output) {
+    std::fill(assigned.begin(), assigned.end(), 0);
+    const Instruction* code = bytecode->code.data();
+    int* r = registers.data();
+    BranchCounts* counts = branchCounts.empty() ? nullptr : branchCounts.data();
+    InputCounts* inputProfile = inputCounts.empty() ? nullptr : inputCounts.data();
+    size_t inputIndex = 0;
+    RunBudget budget(output.size());
+    size_t pc = 0;
+    for (;;) {
+        const Instruction& in = code[pc++];
+        switch (in.op) {
+        case OpCode::LOAD_CONST: r[in.a] = in.b; break;
+        case OpCode::MOVE: r[in.a] = r[in.b]; break;
+        case OpCode::ADD: r[in.a] = applyBinaryOp(BinaryOp::ADD, r[in.b], r[in.c]); break;
+        case OpCode::SUBTRACT: r[in.a] = applyBinaryOp(BinaryOp::SUBTRACT, r[in.b], r[in.c]); break;
+        case OpCode::MULTIPLY: r[in.a] = applyBinaryOp(BinaryOp::MULTIPLY, r[in.b], r[in.c]); break;
+        case OpCode::GREATER: r[in.a] = r[in.b] > r[in.c]; break;
+        case OpCode::LESS: r[in.a] = r[in.b] < r[in.c]; break;
+        case OpCode::EQUAL: r[in.a] = r[in.b] == r[in.c]; break;
+        case OpCode::NOT_EQUAL: r[in.a] = r[in.b] != r[in.c]; break;
+        case OpCode::GREATER_EQUAL: r[in.a] = r[in.b] >= r[in.c]; break;
+        case OpCode::LESS_EQUAL: r[in.a] = r[in.b] <= r[in.c]; break;
+        case OpCode::ADD_CONST: r[in.a] = applyBinaryOp(BinaryOp::ADD, r[in.b], in.c); break;
+        case OpCode::SUBTRACT_CONST: r[in.a] = applyBinaryOp(BinaryOp::SUBTRACT, r[in.b], in.c); break;
+        case OpCode::CONST_SUBTRACT: r[in.a] = applyBinaryOp(BinaryOp::SUBTRACT, in.c, r[in.b]); break;
+        case OpCode::MULTIPLY_CONST: r[in.a] = applyBinaryOp(BinaryOp::MULTIPLY, r[in.b], in.c); break;
+        case OpCode::SHIFT_LEFT_CONST: r[in.a] = static_cast<int>(static_cast<uint32_t>(r[in.b]) << in.c); break;
+        case OpCode::JUMP_IF_GREATER: if (r[in.b] > r[in.c]) pc = static_cast<size_t>(in.a); break;
+        case OpCode::JUMP_IF_LESS: if (r[in.b] < r[in.c]) pc = static_cast<size_t>(in.a); break;
+        case OpCode::JUMP_IF_EQUAL: if (r[in.b] == r[in.c]) pc = static_cast<size_t>(in.a); break;
+        case OpCode::JUMP_IF_NOT_EQUAL: if (r[in.b] != r[in.c]) pc = static_cast<size_t>(in.a); break;
+        case OpCode::JUMP_IF_GREATER_EQUAL: if (r[in.b] >= r[in.c]) pc = static_cast<size_t>(in.a); break;
+        case OpCode::JUMP_IF_LESS_EQUAL: if (r[in.b] <= r[in.c]) pc = static_cast<size_t>(in.a); break;
+        case OpCode::JUMP: pc = static_cast<size_t>(in.a); break;
+        case OpCode::JUMP_IF_FALSE:
+        case OpCode::JUMP_IF_TRUE: {
+            bool condition = r[in.b] != 0;
+            if (counts) {
+                ++counts[pc - 1].seen;
+                counts[pc - 1].taken += condition;
+            }
+            if (condition == (in.op == OpCode::JUMP_IF_TRUE)) {
+                pc = static_cast<size_t>(in.a);
+            }
+            break;
+        }
+        case OpCode::INPUT:
+        case OpCode::INPUT_EXPECT:
+            if (inputIndex >= inputs.size && !nextInputs(inputs, inputIndex)) {
+                throw RuntimeError("Not enough input values for input(" + program->symbols.names[in.a] + ")",
+                                   static_cast<SourceOffset>(in.b));
+            }
+            r[in.a] = inputs.data[inputIndex++];
+            if (inputProfile) {
+                InputCounts& observed = inputProfile[pc - 1];
+                if (observed.seen++ == 0) {
+                    observed.value = r[in.a];
+                }
+                observed.stable = observed.stable && observed.value == r[in.a];
+            }
+            if (in.op == OpCode::INPUT_EXPECT && r[in.a] != in.c) {
+                return false;
+            }
+            break;
+        case OpCode::PRINT: appendPrintedValue(output, format, static_cast<uint32_t>(in.b), r[in.a]); break;
+        case OpCode::CHECK_ASSIGNED:
+            if (!assigned[in.a]) {
+                throw RuntimeError("Undefined variable '" + program->symbols.names[in.a] + "'",
+                                   static_cast<SourceOffset>(in.b));
+            }
+            break;
+        case OpCode::MARK_ASSIGNED: assigned[in.a] = 1; break;
+        case OpCode::CHARGE:
+            if (!budget.charge(static_cast<uint64_t>(in.a), output.size(), static_cast<SourceOffset>(in.b))) {
+                budget.fail(static_cast<SourceOffset>(in.b));
+            }
+            break;
+        case OpCode::HALT:
+            budget.checkOutput(output.size());
+            appendEndOfRun(output, format);
+            return true;
+        }
+    }
+}
+
+ExecutionProfile BytecodeVM::profile() const {
+    ExecutionProfile collected;
+    for (size_t i = 0; i < branchCounts.size(); ++i) {
+        if (auto ifStmt = dynamic_cast<const IfStatement*>(bytecode->sources[i])) {
+            collected.branches[ifStmt] = branchCounts[i];
+        }
+        else if (auto inputStmt = dynamic_cast<const InputStatement*>(bytecode->sources[i])) {
+            collected.inputs[inputStmt] = inputCounts[i];
+        }
+    }
+    return collected;
+}
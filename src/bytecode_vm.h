@@ -0,0 +1,54 @@
+/**
+ * @file bytecode_vm.h
+ * @brief The bytecode interpreter of tiers 1 and 2
+ */
+
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+#include "runtime.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// BytecodeVM class: Runs Bytecode. Like the Interpreter it keeps its storage between runs,
+// so repeated runs do not allocate. The baseline tier runs with its profile counters enabled.
+class BytecodeVM {
+public:
+    BytecodeVM(std::unique_ptr<const Bytecode> bytecode, const Program* program, OutputFormat format, bool profiling)
+        : bytecode(std::move(bytecode)), program(program), format(format),
+          registers(this->bytecode->registerCount), assigned(program->symbols.names.size()),
+          branchCounts(profiling ? this->bytecode->code.size() : 0),
+          inputCounts(profiling ? this->bytecode->code.size() : 0) {}
+
+    int tier() const { return bytecode->tier; }
+
+    uint32_t registerCount() const { return bytecode->registerCount; }
+
+    // The bytecode run (the native tier compiles the optimized tier's)
+    const Bytecode& code() const { return *bytecode; }
+
+    // Run the program; returns false, with the run only partly done, when a speculation
+    // guard fails and the run has to be redone by generic code
+    bool run(InputSpan inputs, std::string& output);
+
+    // The profile collected so far, by statement
+    ExecutionProfile profile() const;
+
+    void resetProfile() {
+        std::fill(branchCounts.begin(), branchCounts.end(), BranchCounts());
+        std::fill(inputCounts.begin(), inputCounts.end(), InputCounts());
+    }
+
+private:
+    std::unique_ptr<const Bytecode> bytecode;
+    const Program* program;
+    OutputFormat format;
+    std::vector<int> registers;
+    std::vector<uint8_t> assigned;
+    std::vector<BranchCounts> branchCounts;
+    std::vector<InputCounts> inputCounts;
+};
@@ -0,0 +1,653 @@
+/**
+ * @file cli.cpp
+ * @brief Batch, record and converter modes, and the command line
+ */
+
+#include "cli.h"
+#include "aarch64.h"
+#include "alloc_stats.h"
+#include "bundle.h"
+#include "bytecode_compiler.h"
+#include "codecs.h"
+#include "partial_evaluator.h"
+#include "platform.h"
+#include "reactive.h"
+#include "wasm.h"
+#include "x86_64.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+int runBatch(const ProgramSlot& slot, const std::vector<std::string>& inputPaths, EngineKind engineKind,
+             OutputFormat format, OutputWriter& writer, RunStats* stats, ResultCache* cache) {
+    InputPrefetcher prefetcher(inputPaths);
+    ProgramSlot::Reader reader(slot);
+    std::unique_ptr<ExecutionEngine> engine;
+    int status = 0;
+    for (const auto& path : inputPaths) {
+        std::shared_ptr<const CompiledProgram> compiled = reader.current();
+        std::string output;
+        try {
+            if (!engine || engine->program() != compiled) {
+                engine.reset();
+                engine = std::make_unique<ExecutionEngine>(compiled, engineKind, format);
+            }
+            InputBuffer inputs = prefetcher.next();
+            auto start = std::chrono::steady_clock::now();
+            if (!cache || !cache->lookup(compiled->sourceHash, inputs.span(), output)) {
+                engine->run(inputs.span(), output);
+                if (cache) {
+                    cache->insert(compiled->sourceHash, inputs.span(), output);
+                }
+            }
+            if (stats) {
+                stats->time += std::chrono::steady_clock::now() - start;
+                ++stats->runs;
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error in '" << path << "': " << describeError(e, *compiled) << std::endl;
+            status = 1;
+        }
+        writer.submit(std::move(output));
+    }
+    writer.finish();
+    if (stats && engine) {
+        stats->tier = engine->tier();
+        stats->deoptimizations = engine->deoptimizations();
+        stats->registers = engine->registerCount();
+    }
+    return status;
+}
+
+int runRecords(const std::shared_ptr<const CompiledProgram>& compiled, const std::string& inputPath,
+               size_t recordSize, EngineKind engineKind, OutputFormat format, OutputWriter& writer,
+               RunStats* stats) {
+    int status = 0;
+    uint64_t records = 0;
+    auto start = std::chrono::steady_clock::now();
+    try {
+        RecordReader reader(inputPath, recordSize);
+        ExecutionEngine engine(compiled, engineKind, format);
+        // One reader thread parses ahead into a short queue; it closes the queue at the end
+        // of the stream or on a read error, which is rethrown here once the queue is drained
+        BoundedQueue<std::vector<int>> queue(2);
+        std::exception_ptr readError;
+        std::thread readerThread([&]() {
+            try {
+                for (std::vector<int> values = reader.read(); !values.empty(); values = reader.read()) {
+                    if (!queue.push(std::move(values))) {
+                        break;
+                    }
+                }
+            }
+            catch (...) {
+                readError = std::current_exception();
+            }
+            queue.close();
+        });
+        // Should the loop below throw, closing the queue stops the reader at its next record,
+        // and the thread is joined before it is destroyed
+        struct ReaderJoin {
+            BoundedQueue<std::vector<int>>& queue;
+            std::thread& thread;
+            ~ReaderJoin() {
+                queue.close();
+                if (thread.joinable()) {
+                    thread.join();
+                }
+            }
+        } readerJoin{ queue, readerThread };
+        std::vector<int> values;
+        while (queue.pop(values)) {
+            std::string output;
+            for (size_t offset = 0; offset < values.size(); offset += recordSize) {
+                try {
+                    engine.run({ values.data() + offset, recordSize }, output);
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "Error in record " << records + 1 << ": " << describeError(e, *compiled) << std::endl;
+                    status = 1;
+                }
+                ++records;
+            }
+            writer.submit(std::move(output));
+        }
+        readerThread.join();
+        if (readError) {
+            std::rethrow_exception(readError);
+        }
+        if (stats) {
+            stats->tier = engine.tier();
+            stats->deoptimizations = engine.deoptimizations();
+            stats->registers = engine.registerCount();
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        status = 1;
+    }
+    writer.finish();
+    if (stats) {
+        stats->runs = records;
+        stats->time = std::chrono::steady_clock::now() - start;
+    }
+    return status;
+}
+
+int packInputFile(const std::vector<std::string>& args) {
+    std::vector<std::string> paths;
+    size_t width = 4;
+    auto encoding = binary_input::Encoding::RAW;
+    for (const auto& arg : args) {
+        if (arg == "--int64") width = 8;
+        else if (arg == "--varint") encoding = binary_input::Encoding::DELTA_VARINT;
+        else paths.push_back(arg);
+    }
+    if (paths.size() != 2) {
+        std::cerr << "Usage: --pack-input <text input> <binary output> [--int64] [--varint]" << std::endl;
+        return 1;
+    }
+    try {
+        std::string packed = binary_input::pack(parseInputs(readFile(paths[0])), width, encoding);
+        std::ofstream out(paths[1], std::ios::binary);
+        if (!out.write(packed.data(), static_cast<std::streamsize>(packed.size()))) {
+            throw std::runtime_error("Error writing '" + paths[1] + "'.");
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Converter: specialize a script on fixed values for the start of its input and write the
+// residual script, which is then run with the rest of the input
+int partialEvaluateFile(const std::vector<std::string>& args) {
+    if (args.size() != 3) {
+        std::cerr << "Usage: --partial-eval <code file> <fixed input file> <residual code file>" << std::endl;
+        return 1;
+    }
+    try {
+        auto compiled = compileScript(args[0], readFile(args[0]));
+        InputBuffer fixed = InputBuffer::load(args[1]);
+        InputSpan values = fixed.span();
+        PartialEvaluator evaluator(*compiled, std::vector<int>(values.data, values.data + values.size));
+        std::string residual = evaluator.residualSource();
+        std::ofstream out(args[2], std::ios::binary);
+        if (!out.write(residual.data(), static_cast<std::streamsize>(residual.size()))) {
+            throw std::runtime_error("Error writing '" + args[2] + "'.");
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Converter: write the machine code the native engine would run for a script, for AArch64
+// (the default) or x86-64, as raw bytes (e.g. for llvm-mc --disassemble)
+int dumpNativeCode(const std::vector<std::string>& args) {
+    bool x86 = args.size() == 3 && args[2] == "--target=x86-64";
+    if (args.size() != 2 && !(args.size() == 3 && (x86 || args[2] == "--target=aarch64"))) {
+        std::cerr << "Usage: --dump-native <code file> <machine code file> [--target=aarch64|x86-64]" << std::endl;
+        return 1;
+    }
+    try {
+        auto compiled = compileScript(args[0], readFile(args[0]));
+        auto bytecode = BytecodeCompiler(*compiled->program, true).compile();
+        std::vector<uint32_t> code;
+        std::vector<uint8_t> x86Code;
+        if (x86 ? !x86_64::CodeGenerator(*bytecode).generate(x86Code) : !aarch64::CodeGenerator(*bytecode).generate(code)) {
+            throw std::runtime_error("The program is too large for the native engine");
+        }
+        std::string bytes(x86Code.begin(), x86Code.end());
+        for (uint32_t word : code) {
+            appendInt32(bytes, word);
+        }
+        std::ofstream out(args[1], std::ios::binary);
+        if (!out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()))) {
+            throw std::runtime_error("Error writing '" + args[1] + "'.");
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Converter: write a script as a WebAssembly module (see wasm::ModuleEmitter)
+int emitWasmFile(const std::vector<std::string>& args) {
+    if (args.size() != 2) {
+        std::cerr << "Usage: --emit-wasm <code file> <module file>" << std::endl;
+        return 1;
+    }
+    try {
+        auto compiled = compileScript(args[0], readFile(args[0]));
+        std::string module = wasm::ModuleEmitter(*compiled->program).emit();
+        std::ofstream out(args[1], std::ios::binary);
+        if (!out.write(module.data(), static_cast<std::streamsize>(module.size()))) {
+            throw std::runtime_error("Error writing '" + args[1] + "'.");
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Converter: compile scripts into one program bundle (see program_bundle)
+int linkFiles(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cerr << "Usage: --link <bundle file> <code file>..." << std::endl;
+        return 1;
+    }
+    try {
+        std::vector<std::shared_ptr<const CompiledProgram>> scripts;
+        std::unordered_map<std::string, size_t> seen;
+        for (size_t i = 1; i < args.size(); ++i) {
+            if (!seen.emplace(args[i], i).second) {
+                throw std::runtime_error("Script '" + args[i] + "' is listed twice");
+            }
+            scripts.push_back(compileScript(args[i], readFile(args[i])));
+        }
+        std::string bundle = program_bundle::link(scripts);
+        std::ofstream out(args[0], std::ios::binary);
+        if (!out.write(bundle.data(), static_cast<std::streamsize>(bundle.size()))) {
+            throw std::runtime_error("Error writing '" + args[0] + "'.");
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Converter: compress or decompress a whole file with the built-in codec
+int transformFile(const std::vector<std::string>& args, bool compress) {
+    if (args.size() != 2) {
+        std::cerr << "Usage: " << (compress ? "--compress" : "--decompress") << " <input file> <output file>" << std::endl;
+        return 1;
+    }
+    try {
+        std::string content = readFile(args[0]);
+        std::string result = compress ? glz::compress(content.data(), content.size())
+                                      : glz::decompress(content.data(), content.size());
+        std::ofstream out(args[1], std::ios::binary);
+        if (!out.write(result.data(), static_cast<std::streamsize>(result.size()))) {
+            throw std::runtime_error("Error writing '" + args[1] + "'.");
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int runCommandLine(int argc, char* argv[]) {
+    // Commented out for deployment; Uncomment for debugging purposes
+    // std::cout << "Current working directory: " << std::filesystem::current_path() << std::endl;
+
+    if (argc > 1 && std::string(argv[1]) == "--pack-input") {
+        return packInputFile(std::vector<std::string>(argv + 2, argv + argc));
+    }
+    if (argc > 1 && std::string(argv[1]) == "--partial-eval") {
+        return partialEvaluateFile(std::vector<std::string>(argv + 2, argv + argc));
+    }
+    if (argc > 1 && std::string(argv[1]) == "--link") {
+        return linkFiles(std::vector<std::string>(argv + 2, argv + argc));
+    }
+    if (argc > 1 && std::string(argv[1]) == "--emit-wasm") {
+        return emitWasmFile(std::vector<std::string>(argv + 2, argv + argc));
+    }
+    if (argc > 1 && std::string(argv[1]) == "--dump-native") {
+        return dumpNativeCode(std::vector<std::string>(argv + 2, argv + argc));
+    }
+    if (argc > 1 && (std::string(argv[1]) == "--compress" || std::string(argv[1]) == "--decompress")) {
+        return transformFile(std::vector<std::string>(argv + 2, argv + argc), std::string(argv[1]) == "--compress");
+    }
+
+    // Collect options; everything else is positional
+    bool batch = false;
+    bool compressOutput = false;
+    bool allocStats = false;
+    bool watch = false;
+    bool runStats = false;
+    bool reactive = false;
+    size_t cacheMegabytes = 0;
+    size_t recordSize = 0;
+    std::string bundlePath;
+    std::string outputPath;
+    auto engineKind = EngineKind::TIERED;
+    unsigned long repeat = 1;
+    auto format = OutputFormat::TEXT;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--batch") batch = true;
+        else if (arg == "--output-format=text") format = OutputFormat::TEXT;
+        else if (arg == "--output-format=raw") format = OutputFormat::RAW;
+        else if (arg == "--output-format=framed") format = OutputFormat::FRAMED;
+        else if (arg == "--compress-output") compressOutput = true;
+        else if (arg == "--allocator=system") nodeAllocator = AllocatorKind::SYSTEM;
+        else if (arg == "--allocator=pool") nodeAllocator = AllocatorKind::POOL;
+        else if (arg == "--alloc-stats") allocStats = true;
+        else if (arg == "--watch") watch = true;
+        else if (arg == "--engine=tree" || arg == "-O0") engineKind = EngineKind::TREE;
+        else if (arg == "--engine=baseline" || arg == "-O1") engineKind = EngineKind::BASELINE;
+        else if (arg == "-O2") engineKind = EngineKind::BYTECODE;
+        else if (arg.rfind("--output=", 0) == 0) outputPath = arg.substr(9);
+        else if (arg == "--engine=bytecode") engineKind = EngineKind::BYTECODE;
+        else if (arg == "--engine=tiered") engineKind = EngineKind::TIERED;
+        else if (arg == "--engine=native") engineKind = EngineKind::NATIVE;
+        else if (arg == "--stats") runStats = true;
+        else if (arg == "--regalloc=naive") registerAllocation = RegisterAllocation::NAIVE;
+        else if (arg == "--regalloc=linear") registerAllocation = RegisterAllocation::LINEAR_SCAN;
+        else if (arg == "--reactive") reactive = true;
+        else if (arg.rfind("--bundle=", 0) == 0) bundlePath = arg.substr(9);
+        else if (arg.rfind("--result-cache=", 0) == 0) {
+            cacheMegabytes = std::strtoul(arg.c_str() + 15, nullptr, 10);
+            if (cacheMegabytes == 0) {
+                std::cerr << "Invalid result cache size: " << arg << std::endl;
+                return 1;
+            }
+        }
+        else if (arg.rfind("--max-fuel=", 0) == 0 || arg.rfind("--max-output=", 0) == 0 ||
+                 arg.rfind("--max-state=", 0) == 0) {
+            size_t equals = arg.find('=');
+            uint64_t limit = std::strtoull(arg.c_str() + equals + 1, nullptr, 10);
+            if (limit == 0) {
+                std::cerr << "Invalid limit: " << arg << std::endl;
+                return 1;
+            }
+            std::string name = arg.substr(0, equals);
+            if (name == "--max-fuel") runLimits.fuel = limit;
+            else if (name == "--max-output") runLimits.outputBytes = static_cast<size_t>(limit);
+            else runLimits.stateBytes = static_cast<size_t>(limit);
+        }
+        else if (arg.rfind("--records=", 0) == 0) {
+            recordSize = std::strtoul(arg.c_str() + 10, nullptr, 10);
+            if (recordSize == 0) {
+                std::cerr << "Invalid record size: " << arg << std::endl;
+                return 1;
+            }
+        }
+        else if (arg.rfind("--repeat=", 0) == 0) {
+            repeat = std::strtoul(arg.c_str() + 9, nullptr, 10);
+            if (repeat == 0) {
+                std::cerr << "Invalid repeat count: " << arg << std::endl;
+                return 1;
+            }
+        }
+        else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+        else positional.push_back(arg);
+    }
+    bool streamed = !batch && recordSize == 0 && positional.size() > 1 && positional[1] == "-";
+    if (!batch && positional.size() > 2) {
+        std::cerr << "Usage: " << argv[0] << " [options] [<code file> [<input file>|-]]" << std::endl;
+        return 1;
+    }
+    if (streamed && (repeat > 1 || reactive || runLimits.outputBytes != 0)) {
+        std::cerr << "Input from standard input cannot be combined with --repeat, --reactive or --max-output" << std::endl;
+        return 1;
+    }
+    if (engineKind == EngineKind::NATIVE && !NativeVM::supported()) {
+        std::cerr << "--engine=native needs an AArch64 or x86-64 Linux host" << std::endl;
+        return 1;
+    }
+    if (allocStats && !alloc_stats::available) {
+        std::cerr << "--alloc-stats needs a build configured with -DGLSL_ALLOC_STATS=ON" << std::endl;
+        return 1;
+    }
+    if (reactive && (runLimits.chargesBlocks() || runLimits.stateBytes != 0)) {
+        std::cerr << "--reactive does not support run limits" << std::endl;
+        return 1;
+    }
+    if (!batch && (watch || cacheMegabytes > 0)) {
+        std::cerr << "--watch and --result-cache need --batch" << std::endl;
+        return 1;
+    }
+    if (!bundlePath.empty() && (!batch || watch)) {
+        std::cerr << "--bundle needs --batch, and cannot be combined with --watch" << std::endl;
+        return 1;
+    }
+    if (recordSize != 0 && (batch || reactive || repeat > 1)) {
+        std::cerr << "--records cannot be combined with --batch, --reactive or --repeat" << std::endl;
+        return 1;
+    }
+    if (batch && reactive) {
+        std::cerr << "--reactive cannot be combined with --batch" << std::endl;
+        return 1;
+    }
+    if (batch && positional.empty()) {
+        std::cerr << "Usage: " << argv[0] << " --batch <code file> <input file>..." << std::endl;
+        return 1;
+    }
+
+    // Open code and input files
+    // Note: Ensure that test.code and test.input are in the build directory when using cmake for compilation.
+    std::string codePath = !positional.empty() ? positional.front() : "test.code";
+    std::vector<std::string> inputPaths;
+    if (batch) {
+        inputPaths.assign(positional.begin() + 1, positional.end());
+    }
+    else {
+        inputPaths.push_back(positional.size() > 1 ? positional[1] : "test.input");
+    }
+
+#ifdef _WIN32
+    if (format != OutputFormat::TEXT || compressOutput) {
+        _setmode(_fileno(stdout), _O_BINARY);
+    }
+    if (streamed || (recordSize != 0 && inputPaths.front() == "-")) {
+        _setmode(_fileno(stdin), _O_BINARY);
+    }
+#endif
+    std::ofstream outputFile;
+    if (!outputPath.empty()) {
+        outputFile.open(outputPath, std::ios::binary);
+        if (!outputFile) {
+            std::cerr << "Error opening output file '" << outputPath << "'." << std::endl;
+            return 1;
+        }
+    }
+    OutputWriter writer(compressOutput, outputPath.empty() ? std::cout : outputFile);
+    if (format == OutputFormat::FRAMED) {
+        writer.submit(std::string(framed_output::header, sizeof(framed_output::header)));
+    }
+
+    // Start reading the input while the code is compiled (batch mode prefetches on its own)
+    std::future<InputBuffer> pendingInput;
+    if (!batch && !streamed && recordSize == 0) {
+        pendingInput = std::async(std::launch::async, InputBuffer::load, inputPaths.front());
+    }
+
+    // Read and compile the code file. From a bundle, the code path names the scripts to run:
+    // one, several separated by commas, or '*' for all of them
+    std::shared_ptr<const CompiledProgram> compiled;
+    std::vector<std::shared_ptr<const CompiledProgram>> bundled;
+    CompileStats compileStats;
+    try {
+        if (!bundlePath.empty()) {
+            alloc_stats::enabled = allocStats;
+            ProgramBundle bundle(bundlePath);
+            std::vector<std::string> names;
+            if (codePath == "*") {
+                names = bundle.names();
+            }
+            else {
+                for (size_t start = 0; start <= codePath.size();) {
+                    size_t comma = std::min(codePath.find(',', start), codePath.size());
+                    names.push_back(codePath.substr(start, comma - start));
+                    start = comma + 1;
+                }
+            }
+            for (const auto& name : names) {
+                bundled.push_back(bundle.load(name));
+            }
+            if (bundled.empty()) {
+                throw std::runtime_error("Bundle '" + bundlePath + "' has no scripts");
+            }
+            compiled = bundled.front();
+        }
+        else {
+            std::string code = readFile(codePath);
+            alloc_stats::enabled = allocStats;
+            compiled = compileScript(codePath, std::move(code), &compileStats);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (reactive) {
+        try {
+            InputBuffer inputs = pendingInput.get();
+            return runReactive(*compiled, inputs.span(), runStats);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (recordSize != 0) {
+        RunStats stats;
+        int status = runRecords(compiled, inputPaths.front(), recordSize, engineKind, format, writer,
+                                runStats ? &stats : nullptr);
+        if (runStats) {
+            stats.print(std::cerr);
+            auto seconds = std::chrono::duration<double>(stats.time).count();
+            std::cerr << "records: " << stats.runs << " ("
+                      << (seconds > 0 ? stats.runs / seconds : 0.0) << " records/s)\n";
+        }
+        return status;
+    }
+
+    if (batch) {
+        std::unique_ptr<ResultCache> cache;
+        if (cacheMegabytes > 0) {
+            cache = std::make_unique<ResultCache>(cacheMegabytes << 20);
+        }
+        RunStats stats;
+        int status = 0;
+        if (!bundled.empty()) {
+            // Every selected script runs the whole batch in turn, in one process
+            for (const auto& script : bundled) {
+                ProgramSlot slot(script);
+                status = std::max(status, runBatch(slot, inputPaths, engineKind, format, writer,
+                                                   runStats ? &stats : nullptr, cache.get()));
+            }
+        }
+        else {
+            ProgramSlot slot(compiled);
+            std::unique_ptr<ScriptWatcher> watcher;
+            if (watch) {
+                watcher = std::make_unique<ScriptWatcher>(slot, codePath, compiled->source);
+            }
+            status = runBatch(slot, inputPaths, engineKind, format, writer, runStats ? &stats : nullptr, cache.get());
+        }
+        if (runStats) {
+            stats.print(std::cerr);
+            if (cache) {
+                const auto& metrics = cache->metrics();
+                uint64_t lookups = metrics.hits + metrics.misses;
+                std::cerr << "result cache: " << metrics.hits << " hits, " << metrics.misses << " misses ("
+                          << (lookups ? 100.0 * metrics.hits / lookups : 0.0) << "% hit rate), "
+                          << metrics.evictions << " evictions, " << metrics.entries << " entries, "
+                          << metrics.bytes << " bytes\n";
+            }
+        }
+        return status;
+    }
+
+    // Run the program; output is buffered and written in one go. With --repeat the same
+    // engine runs again, reusing its storage and output buffer, and may move up the tiers.
+    std::string output;
+    StdinInput stdinInput(output, writer);
+    try {
+        std::optional<InputBuffer> inputBuffer;
+        InputSpan inputs{ nullptr, 0, &stdinInput };
+        if (!streamed) {
+            inputBuffer.emplace(pendingInput.get());
+            inputs = inputBuffer->span();
+        }
+        RunStats stats;
+        auto phaseStart = alloc_stats::now();
+        auto start = std::chrono::steady_clock::now();
+        ExecutionEngine engine(compiled, engineKind, format);
+        engine.run(inputs, output);
+        stats.time += std::chrono::steady_clock::now() - start;
+        ++stats.runs;
+        std::string firstRunStats = alloc_stats::since(phaseStart);
+
+        // Repeated runs in a tier allocate nothing; starting a tier change is counted apart
+        alloc_stats::Snapshot repeatAllocations = { 0, 0 };
+        alloc_stats::Snapshot firstTierChanges = engine.tierChangeAllocations();
+        for (unsigned long run = 1; run < repeat; ++run) {
+            writer.submit(output);
+            output.clear();
+            phaseStart = alloc_stats::now();
+            start = std::chrono::steady_clock::now();
+            engine.run(inputs, output);
+            stats.time += std::chrono::steady_clock::now() - start;
+            ++stats.runs;
+            alloc_stats::accumulate(repeatAllocations, phaseStart);
+        }
+        alloc_stats::Snapshot tierChanges = engine.tierChangeAllocations();
+        tierChanges.count -= firstTierChanges.count;
+        tierChanges.bytes -= firstTierChanges.bytes;
+        stats.tier = engine.tier();
+        stats.deoptimizations = engine.deoptimizations();
+        stats.registers = engine.registerCount();
+        if (runStats) {
+            stats.print(std::cerr);
+        }
+
+        if (allocStats) {
+            std::cerr << "lex: " << compileStats.lex << "\n"
+                      << "parse: " << compileStats.parse << "\n"
+                      << "first run: " << firstRunStats << "\n";
+            if (repeat > 1) {
+                std::cerr << "repeated runs (" << repeat - 1 << "): " << repeatAllocations.count - tierChanges.count
+                          << " allocations, " << repeatAllocations.bytes - tierChanges.bytes << " bytes";
+                if (tierChanges.count > 0) {
+                    std::cerr << "; starting tier changes: " << tierChanges.count << " allocations, "
+                              << tierChanges.bytes << " bytes";
+                }
+                std::cerr << "\n";
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        writer.submit(std::move(output));
+        writer.finish();
+        std::cerr << describeError(e, *compiled) << std::endl;
+        return 1;
+    }
+    writer.submit(std::move(output));
+    writer.finish();
+
+    return 0;
+}
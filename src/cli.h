@@ -0,0 +1,78 @@
+/**
+ * @file cli.h
+ * @brief Batch, record and converter modes, and the command line
+ */
+
+#pragma once
+
+#include "engine.h"
+#include "hot_swap.h"
+#include "io.h"
+#include "program.h"
+#include "result_cache.h"
+#include "runtime.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Batch mode: run the published program against many input files.
+// The next input files are read by a fixed pool of prefetch threads (InputPrefetcher)
+// while the current one runs, and each run's output is queued for the writer thread, so
+// the interpreter never waits on disk. Each run takes the snapshot that is current when it starts; the
+// engine is kept while the snapshot stays the same, so hot scripts move up the tiers.
+// With a ResultCache, input vectors seen before are answered from it instead of being run.
+int runBatch(const ProgramSlot& slot, const std::vector<std::string>& inputPaths, EngineKind engineKind,
+             OutputFormat format, OutputWriter& writer, RunStats* stats = nullptr, ResultCache* cache = nullptr);
+
+// Record mode (--records=<n>): run the program once for every record of n input values in
+// a stream, which may be endless. One engine runs every record, so a record only resets
+// the variables, and a hot script moves up the tiers. The next records are parsed by a
+// reader thread while the current ones run, and the output of each group of records is
+// queued for the writer thread before waiting for more input.
+int runRecords(const std::shared_ptr<const CompiledProgram>& compiled, const std::string& inputPath,
+               size_t recordSize, EngineKind engineKind, OutputFormat format, OutputWriter& writer,
+               RunStats* stats = nullptr);
+
+// Converter: write a text input file in the binary input format
+int packInputFile(const std::vector<std::string>& args);
+
+// Converter: specialize a script on fixed values for the start of its input and write the
+// residual script, which is then run with the rest of the input
+int partialEvaluateFile(const std::vector<std::string>& args);
+
+// Converter: write the machine code the native engine would run for a script, for AArch64
+// (the default) or x86-64, as raw bytes (e.g. for llvm-mc --disassemble)
+int dumpNativeCode(const std::vector<std::string>& args);
+
+// Converter: write a script as a WebAssembly module (see wasm::ModuleEmitter)
+int emitWasmFile(const std::vector<std::string>& args);
+
+// Converter: compile scripts into one program bundle (see program_bundle)
+int linkFiles(const std::vector<std::string>& args);
+
+// Converter: compress or decompress a whole file with the built-in codec
+int transformFile(const std::vector<std::string>& args, bool compress);
+
+// Command line: the whole program behind main()
+// Usage: GLSLCompiler [options] [<code file> [<input file>|-]]   (default test.code, test.input)
+//        GLSLCompiler [--output=<file>] [-O0|-O1|-O2] ...     (-O: tree, baseline or optimizing engine)
+//        GLSLCompiler --batch [--watch] [--result-cache=MiB] <code file> <input file>...
+//        GLSLCompiler --batch --bundle=<bundle file> <script>[,<script>...]|'*' <input file>...
+//        GLSLCompiler [--output-format=text|raw|framed] [--compress-output] ...
+//        GLSLCompiler [--repeat=N] [--allocator=pool|system] [--alloc-stats] ...
+//        GLSLCompiler [--engine=tree|baseline|bytecode|tiered|native] [--regalloc=linear|naive] [--stats] ...
+//        GLSLCompiler [--max-fuel=statements] [--max-output=bytes] [--max-state=bytes] ...
+//        GLSLCompiler --reactive [--stats]                      (input changes on stdin)
+//        GLSLCompiler --records=N [--stats] <code file> <input file>|-   (one run per N values)
+//        GLSLCompiler --pack-input <text input> <binary output> [--int64] [--varint]
+//        GLSLCompiler --compress|--decompress <input file> <output file>
+//        GLSLCompiler --partial-eval <code file> <fixed input file> <residual code file>
+//        GLSLCompiler --dump-native <code file> <machine code file>   (raw AArch64, any host)
+//        GLSLCompiler --emit-wasm <code file> <module file>
+//        GLSLCompiler --link <bundle file> <code file>...   (scripts are named by their path)
+// Input files may be in the text format (one integer per line) or the binary format,
+// either of them optionally compressed. Input "-" is text streamed from standard input,
+// read lazily as the script asks for values (output is written before waiting for more).
+int runCommandLine(int argc, char* argv[]);
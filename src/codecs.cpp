@@ -0,0 +1,199 @@
+/**
+ * @file codecs.cpp
+ * @brief Compression and binary input encoding
+ */
+
+#include "codecs.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace glz {
+    namespace {
+        uint32_t read32(const char* bytes) {
+            uint32_t value;
+            std::memcpy(&value, bytes, sizeof(value));
+            return value;
+        }
+
+        void appendU32(std::string& out, uint32_t value) {
+            for (int i = 0; i < 4; ++i) {
+                out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+            }
+        }
+
+        uint32_t readU32(const char* bytes) {
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i) {
+                value |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+            }
+            return value;
+        }
+
+        void appendLength(std::string& out, size_t length) {
+            while (length >= 255) {
+                out.push_back(static_cast<char>(255));
+                length -= 255;
+            }
+            out.push_back(static_cast<char>(length));
+        }
+
+        void appendSequence(std::string& out, const char* literals, size_t literalLength, size_t offset, size_t matchLength) {
+            size_t matchCode = matchLength ? matchLength - minMatch : 0;
+            out.push_back(static_cast<char>((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(matchCode, 15)));
+            if (literalLength >= 15) appendLength(out, literalLength - 15);
+            out.append(literals, literalLength);
+            if (!matchLength) {
+                return;
+            }
+            out.push_back(static_cast<char>(offset & 0xFF));
+            out.push_back(static_cast<char>(offset >> 8));
+            if (matchCode >= 15) appendLength(out, matchCode - 15);
+        }
+
+        void compressBlock(const char* src, size_t size, std::string& out) {
+            std::vector<uint32_t> table(size_t(1) << hashBits, 0); // position + 1, 0 = empty
+            size_t anchor = 0;
+            size_t i = 0;
+            while (i + minMatch <= size) {
+                uint32_t sequence = read32(src + i);
+                uint32_t hash = (sequence * 2654435761u) >> (32 - hashBits);
+                size_t candidate = table[hash];
+                table[hash] = static_cast<uint32_t>(i + 1);
+                if (candidate == 0 || i - (candidate - 1) > 0xFFFF || read32(src + candidate - 1) != sequence) {
+                    ++i;
+                    continue;
+                }
+                size_t matchStart = candidate - 1;
+                size_t length = minMatch;
+                while (i + length < size && src[matchStart + length] == src[i + length]) {
+                    ++length;
+                }
+                appendSequence(out, src + anchor, i - anchor, i - matchStart, length);
+                i += length;
+                anchor = i;
+            }
+            if (anchor < size) {
+                appendSequence(out, src + anchor, size - anchor, 0, 0);
+            }
+        }
+    }
+
+    void decompressBlock(const char* src, size_t size, size_t rawSize, std::string& out) {
+        auto corrupt = []() { return std::runtime_error("Corrupt compressed data"); };
+        const char* end = src + size;
+        size_t blockStart = out.size();
+        auto room = [&]() { return rawSize - (out.size() - blockStart); };
+        auto readLength = [&](size_t length) {
+            if (length != 15) return length;
+            unsigned char byte;
+            do {
+                if (src == end) throw corrupt();
+                byte = static_cast<unsigned char>(*src++);
+                length += byte;
+            } while (byte == 255);
+            return length;
+        };
+        while (src < end) {
+            auto token = static_cast<unsigned char>(*src++);
+            size_t literalLength = readLength(token >> 4);
+            if (static_cast<size_t>(end - src) < literalLength || literalLength > room()) throw corrupt();
+            out.append(src, literalLength);
+            src += literalLength;
+            if (src == end) {
+                break;
+            }
+            if (end - src < 2) throw corrupt();
+            size_t offset = static_cast<unsigned char>(src[0]) | (static_cast<size_t>(static_cast<unsigned char>(src[1])) << 8);
+            src += 2;
+            size_t matchLength = readLength(token & 0x0F) + minMatch;
+            if (offset == 0 || offset > out.size() - blockStart || matchLength > room()) throw corrupt();
+            size_t from = out.size() - offset;
+            for (size_t k = 0; k < matchLength; ++k) {
+                out.push_back(out[from + k]);
+            }
+        }
+        if (out.size() - blockStart != rawSize) throw corrupt();
+    }
+
+    void compressBlocks(const char* data, size_t size, std::string& out) {
+        for (size_t offset = 0; offset < size; offset += blockSize) {
+            size_t length = std::min(blockSize, size - offset);
+            size_t headerAt = out.size();
+            appendU32(out, static_cast<uint32_t>(length));
+            appendU32(out, 0);
+            compressBlock(data + offset, length, out);
+            size_t stored = out.size() - headerAt - 8;
+            if (stored >= length) {
+                out.resize(headerAt + 8);
+                out.append(data + offset, length);
+                stored = length | storedFlag;
+            }
+            for (int i = 0; i < 4; ++i) {
+                out[headerAt + 4 + i] = static_cast<char>((stored >> (8 * i)) & 0xFF);
+            }
+        }
+    }
+
+    std::string compress(const char* data, size_t size) {
+        std::string out(magic, sizeof(magic));
+        compressBlocks(data, size, out);
+        return out;
+    }
+
+    std::string decompress(const char* data, size_t size) {
+        if (!isCompressed(data, size)) {
+            throw std::runtime_error("Missing compressed stream header");
+        }
+        std::string out;
+        const char* cursor = data + sizeof(magic);
+        const char* end = data + size;
+        while (cursor < end) {
+            if (end - cursor < 8) throw std::runtime_error("Corrupt compressed data");
+            uint32_t rawSize = readU32(cursor);
+            uint32_t stored = readU32(cursor + 4);
+            size_t storedSize = stored & ~storedFlag;
+            cursor += 8;
+            if (static_cast<size_t>(end - cursor) < storedSize || rawSize > blockSize) {
+                throw std::runtime_error("Corrupt compressed data");
+            }
+            if (stored & storedFlag) {
+                if (storedSize != rawSize) throw std::runtime_error("Corrupt compressed data");
+                out.append(cursor, storedSize);
+            }
+            else {
+                out.reserve(out.size() + rawSize);
+                decompressBlock(cursor, storedSize, rawSize, out);
+            }
+            cursor += storedSize;
+        }
+        return out;
+    }
+}
+
+namespace binary_input {
+    std::string pack(const std::vector<int>& values, size_t width, Encoding encoding) {
+        std::string out(magic, sizeof(magic));
+        out.push_back(static_cast<char>(version));
+        out.push_back(static_cast<char>(width));
+        out.push_back(static_cast<char>(encoding));
+        out.push_back('\0');
+        writeLittleEndian(out, values.size(), 8);
+        int64_t previous = 0;
+        for (int value : values) {
+            if (encoding == Encoding::RAW) {
+                writeLittleEndian(out, static_cast<uint64_t>(static_cast<int64_t>(value)), width);
+                continue;
+            }
+            int64_t delta = static_cast<int64_t>(value) - previous;
+            previous = value;
+            uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+            while (zigzag >= 0x80) {
+                out.push_back(static_cast<char>((zigzag & 0x7F) | 0x80));
+                zigzag >>= 7;
+            }
+            out.push_back(static_cast<char>(zigzag));
+        }
+        return out;
+    }
+}
@@ -0,0 +1,78 @@
+/**
+ * @file codecs.h
+ * @brief The GLZ1 block compression codec and the GLIN binary input format
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Built-in block compression codec (LZ77 family, LZ4-style sequences) for input and output streams.
+// Stream: magic "GLZ1", then independent blocks of at most blockSize raw bytes, each preceded by
+// its raw size (u32) and stored size (u32, top bit set when the block is stored uncompressed).
+// Blocks are self-contained, so compressed streams can be concatenated.
+namespace glz {
+    constexpr char magic[4] = { 'G', 'L', 'Z', '1' };
+    constexpr size_t blockSize = 1 << 16;
+    constexpr size_t minMatch = 4;
+    constexpr uint32_t storedFlag = 0x80000000u;
+    constexpr int hashBits = 14;
+
+    inline bool isCompressed(const char* data, size_t size) {
+        return size >= sizeof(magic) && std::memcmp(data, magic, sizeof(magic)) == 0;
+    }
+
+    // Append a block's rawSize bytes; runs that would grow it past rawSize are rejected before
+    // they are written, so a hostile block cannot make the output any larger than it declares
+    void decompressBlock(const char* src, size_t size, size_t rawSize, std::string& out);
+
+    // Append data as compressed blocks (without the stream magic)
+    void compressBlocks(const char* data, size_t size, std::string& out);
+
+    std::string compress(const char* data, size_t size);
+    std::string decompress(const char* data, size_t size);
+}
+
+// Binary input format: a 16-byte header followed by one column of little-endian integers.
+//   magic "GLIN" | version (u8) | width in bytes, 4 or 8 (u8) | encoding (u8) | reserved (u8) | count (u64)
+// With the raw encoding the column is `count` fixed-width values; with the delta-varint
+// encoding each value is stored as the zigzag LEB128 varint of its difference from the previous one.
+namespace binary_input {
+    constexpr char magic[4] = { 'G', 'L', 'I', 'N' };
+    constexpr uint8_t version = 1;
+    constexpr size_t headerSize = 16;
+
+    enum class Encoding : uint8_t { RAW = 0, DELTA_VARINT = 1 };
+
+    inline bool hostIsLittleEndian() {
+        const uint16_t probe = 1;
+        unsigned char first;
+        std::memcpy(&first, &probe, 1);
+        return first == 1;
+    }
+
+    inline uint64_t readLittleEndian(const char* bytes, size_t width) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < width; ++i) {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+        }
+        return value;
+    }
+
+    inline void writeLittleEndian(std::string& out, uint64_t value, size_t width) {
+        for (size_t i = 0; i < width; ++i) {
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+        }
+    }
+
+    inline bool isBinary(const char* data, size_t size) {
+        return size >= headerSize && std::memcmp(data, magic, sizeof(magic)) == 0;
+    }
+
+    // Serialize values into the binary input format (used by --pack-input)
+    std::string pack(const std::vector<int>& values, size_t width, Encoding encoding);
+}
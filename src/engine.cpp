@@ -0,0 +1,225 @@
+/**
+ * @file engine.cpp
+ * @brief Tiering, deoptimization and output table decisions
+ */
+
+#include "engine.h"
+#include "bytecode_compiler.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+ExecutionEngine::ExecutionEngine(std::shared_ptr<const CompiledProgram> compiled, EngineKind kind, OutputFormat format)
+    : compiled(std::move(compiled)), kind(kind), format(format),
+      tableInputs(maxInputsRead(this->compiled->program->statements)),
+      tableCandidate(kind == EngineKind::TIERED && !this->compiled->linked && tableInputs <= maxTableInputs) {
+    // Linked programs have no tree, so they always run their bytecode (or native code)
+    if (kind == EngineKind::NATIVE) {
+        if (!NativeVM::supported()) {
+            throw std::runtime_error("The native engine needs an AArch64 or x86-64 Linux host");
+        }
+        native = NativeVM::create(optimizedBytecode(), this->compiled->program.get(), format);
+        if (!native) {
+            throw std::runtime_error("The program is too large for the native engine");
+        }
+    }
+    else if (kind == EngineKind::BYTECODE || this->compiled->linked) {
+        optimized = std::make_unique<BytecodeVM>(optimizedBytecode(), this->compiled->program.get(), format, false);
+    }
+    else if (kind == EngineKind::BASELINE) {
+        // Held as the top tier, so it runs without profiling and never tiers up
+        optimized = std::make_unique<BytecodeVM>(BytecodeCompiler(*this->compiled->program, false).compile(),
+                                                 this->compiled->program.get(), format, false);
+    }
+}
+
+void ExecutionEngine::run(InputSpan inputs, std::string& output) {
+    if (runLimits.stateBytes != 0 &&
+        (inputs.size + compiled->program->symbols.names.size()) * sizeof(int) > runLimits.stateBytes) {
+        throw std::runtime_error("State limit of " + std::to_string(runLimits.stateBytes) +
+                                 " bytes (input values and variables) exceeded");
+    }
+    if (kind == EngineKind::NATIVE) {
+        native->run(inputs, output); // Compiled without speculation, so it never deoptimizes
+        return;
+    }
+    if (pendingTable.valid() && pendingTable.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        // A build that failed (e.g. out of memory) only leaves the runs in their tier
+        try {
+            table = pendingTable.get();
+        }
+        catch (const std::exception&) {
+            table.reset();
+        }
+    }
+    if (table && table->lookup(inputs, output)) {
+        return;
+    }
+    if (!tableCandidate || inputs.source || inputs.size < tableInputs) {
+        runInTier(inputs, output);
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    runInTier(inputs, output);
+    observeForTable(inputs, std::chrono::steady_clock::now() - start);
+}
+
+void ExecutionEngine::observeForTable(InputSpan inputs, std::chrono::steady_clock::duration elapsed) {
+    if (observedRuns++ == 0) {
+        for (size_t i = 0; i < tableInputs; ++i) {
+            observedDomain.push_back({ inputs.data[i], inputs.data[i] });
+        }
+    }
+    for (size_t i = 0; i < tableInputs; ++i) {
+        observedDomain[i].low = std::min(observedDomain[i].low, inputs.data[i]);
+        observedDomain[i].high = std::max(observedDomain[i].high, inputs.data[i]);
+    }
+    observedTime += elapsed;
+    if (observedRuns % tableCheckInterval != 0) {
+        return;
+    }
+
+    size_t entries = OutputTable::domainSize(observedDomain);
+    if (entries > maxTableEntries) {
+        tableCandidate = false; // The domain only grows
+        return;
+    }
+    double runNanos = std::chrono::duration<double, std::nano>(observedTime).count() / observedRuns;
+    double buildNanos = runNanos * entries;
+    double savedNanos = (runNanos - tableLookupNanos) * observedRuns;
+    if (buildNanos < savedNanos) {
+        tableCandidate = false;
+        auto allocationStart = alloc_stats::now();
+        pendingTable = std::async(std::launch::async, [compiled = compiled, domain = observedDomain, format = format]() {
+            return OutputTable::build(*compiled->program, domain, format, maxTableBytes);
+        });
+        alloc_stats::accumulate(tierChanges, allocationStart);
+    }
+}
+
+void ExecutionEngine::runInTier(InputSpan inputs, std::string& output) {
+    if (pendingTier.valid() && pendingTier.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        auto vm = pendingTier.get();
+        if (vm->tier() == 1) {
+            baseline = std::move(vm);
+        }
+        else {
+            optimized = std::move(vm);
+            ++optimizedGeneration;
+            nativeDeclined = false;
+        }
+        runsInTier = 0;
+    }
+    if (kind == EngineKind::TIERED && optimized) {
+        checkNative();
+    }
+
+    if (native) {
+        size_t outputStart = output.size();
+        if (native->run(inputs, output)) {
+            return;
+        }
+        deoptimize(output, outputStart);
+    }
+    else if (optimized) {
+        size_t outputStart = output.size();
+        if (optimized->run(inputs, output)) {
+            return;
+        }
+        deoptimize(output, outputStart);
+    }
+
+    // Hotness is checked before a run, so runs that fail count towards moving up too
+    if (baseline) {
+        if (runsInTier++ >= optimizingThreshold && !pendingTier.valid()) {
+            auto allocationStart = alloc_stats::now();
+            ExecutionProfile profile = baseline->profile();
+            if (deoptimizationCount >= maxDeoptimizations) {
+                profile.inputs.clear();
+            }
+            startCompile(true, std::move(profile));
+            alloc_stats::accumulate(tierChanges, allocationStart);
+        }
+        baseline->run(inputs, output);
+        return;
+    }
+
+    if (!interpreter) {
+        interpreter.emplace(compiled->program.get(), inputs, output, format);
+    }
+    else {
+        if (kind == EngineKind::TIERED && !pendingTier.valid() &&
+            interpreter->statementsExecuted() >= baselineThreshold) {
+            auto allocationStart = alloc_stats::now();
+            startCompile(false, ExecutionProfile());
+            alloc_stats::accumulate(tierChanges, allocationStart);
+        }
+        interpreter->reset(inputs, output);
+    }
+    interpreter->interpret();
+}
+
+void ExecutionEngine::deoptimize(std::string& output, size_t outputStart) {
+    output.resize(outputStart);
+    ++deoptimizationCount;
+    native.reset();
+    optimized.reset();
+    runsInTier = 0;
+    // Only code compiled from a baseline profile speculates, so today a baseline exists
+    // here; engines that start in their top tier (bytecode, linked programs) have none
+    if (baseline) {
+        baseline->resetProfile();
+    }
+}
+
+void ExecutionEngine::checkNative() {
+    if (pendingNative.valid()) {
+        if (pendingNative.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+        // A compile for an optimized tier deoptimized since is stale
+        auto vm = pendingNative.get();
+        if (pendingNativeGeneration == optimizedGeneration) {
+            nativeDeclined = !vm;
+            native = std::move(vm);
+        }
+    }
+    if (native || nativeDeclined || !NativeVM::supported() || runsInTier++ < nativeThreshold) {
+        return;
+    }
+    auto allocationStart = alloc_stats::now();
+    pendingNativeGeneration = optimizedGeneration;
+    pendingNative = std::async(std::launch::async, [bytecode = std::make_unique<Bytecode>(optimized->code()),
+                                                    compiled = compiled, format = format]() mutable {
+        return NativeVM::create(std::move(bytecode), compiled->program.get(), format);
+    });
+    alloc_stats::accumulate(tierChanges, allocationStart);
+}
+
+std::unique_ptr<const Bytecode> ExecutionEngine::optimizedBytecode() const {
+    if (compiled->linked) {
+        return std::make_unique<Bytecode>(*compiled->linked);
+    }
+    return BytecodeCompiler(*compiled->program, true).compile();
+}
+
+std::unique_ptr<BytecodeVM> ExecutionEngine::compileTier(std::shared_ptr<const CompiledProgram> compiled, OutputFormat format,
+                                                            bool optimize, const ExecutionProfile& profile) {
+    auto bytecode = BytecodeCompiler(*compiled->program, optimize, &profile).compile();
+    return std::make_unique<BytecodeVM>(std::move(bytecode), compiled->program.get(), format, !optimize);
+}
+
+void ExecutionEngine::startCompile(bool optimize, ExecutionProfile profile) {
+    pendingTier = std::async(std::launch::async, [compiled = compiled, format = format, optimize,
+                                                  profile = std::move(profile)]() {
+        return compileTier(compiled, format, optimize, profile);
+    });
+}
+
+std::string describeError(const std::exception& error, const CompiledProgram& compiled) {
+    if (auto runtimeError = dynamic_cast<const RuntimeError*>(&error)) {
+        return compiled.lines.describe(compiled.path, runtimeError->offset) + ": runtime error: " + error.what();
+    }
+    return error.what();
+}
@@ -0,0 +1,161 @@
+/**
+ * @file engine.h
+ * @brief The execution engines and their tiers
+ */
+
+#pragma once
+
+#include "alloc_stats.h"
+#include "bytecode.h"
+#include "bytecode_vm.h"
+#include "interpreter.h"
+#include "native_vm.h"
+#include "output_table.h"
+#include "program.h"
+#include "runtime.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Execution engines (--engine=):
+//   TREE     - the AST Interpreter only
+//   BASELINE - the baseline bytecode tier (no optimizations, no profiling) from the first run
+//   BYTECODE - the optimizing bytecode tier from the first run
+//   TIERED   - start in the Interpreter and move up the tiers as the program gets hot
+//   NATIVE   - the optimizing bytecode, without speculation, compiled to machine code from
+//              the first run (AArch64 or x86-64 Linux only)
+enum class EngineKind { TREE, BASELINE, BYTECODE, TIERED, NATIVE };
+
+// ExecutionEngine class: Runs one CompiledProgram snapshot, run after run.
+// Tiered, a program starts in the Interpreter (tier 0). Once that has executed
+// baselineThreshold statements the baseline bytecode (tier 1, with profile counters) is
+// compiled on a background thread, and after optimizingThreshold runs in tier 1 the
+// optimizing compile (tier 2) follows, using the profile. On hosts that run native code,
+// nativeThreshold runs in tier 2 then have the same optimized bytecode, speculation
+// included, compiled to machine code (tier 4) on a background thread. A run never waits
+// for a compile: it starts in the best tier that is ready.
+// When a speculated input value turns out different, in tier 2 or 4, the run is
+// deoptimized: its output is discarded, both tiers built on the speculation are dropped, and
+// the run is redone in the baseline tier, which profiles afresh before the next optimizing
+// compile. After maxDeoptimizations the optimizing tier stops speculating.
+// Tiered, the engine also watches the range of the input values a program can read. When
+// that domain is small and a cost model says precomputing it pays off, an OutputTable
+// (tier 3) is built on a background thread, and runs inside the domain become lookups.
+// The native engine reports tier 4.
+class ExecutionEngine {
+public:
+    static constexpr uint64_t baselineThreshold = 10000;
+    static constexpr uint64_t optimizingThreshold = 100;
+    static constexpr uint64_t nativeThreshold = 100;
+    static constexpr uint64_t maxDeoptimizations = 3;
+    // Output tables: programs reading at most maxTableInputs values are candidates; the
+    // cost model is checked every tableCheckInterval runs
+    static constexpr size_t maxTableInputs = 8;
+    static constexpr size_t maxTableEntries = size_t(1) << 20;
+    static constexpr size_t maxTableBytes = size_t(64) << 20;
+    static constexpr uint64_t tableCheckInterval = 256;
+    static constexpr double tableLookupNanos = 30.0;
+
+    ExecutionEngine(std::shared_ptr<const CompiledProgram> compiled, EngineKind kind, OutputFormat format);
+
+    const std::shared_ptr<const CompiledProgram>& program() const { return compiled; }
+
+    int tier() const {
+        return native ? 4 : table ? 3 : optimized ? optimized->tier() : baseline ? baseline->tier() : 0;
+    }
+
+    uint64_t deoptimizations() const { return deoptimizationCount; }
+
+    // Allocations made on the running thread to start tier compiles and table builds
+    // (counted with --alloc-stats); the runs themselves reuse their storage
+    alloc_stats::Snapshot tierChangeAllocations() const { return tierChanges; }
+
+    // Size of the register file of the best bytecode tier in use (0 before there is one)
+    uint32_t registerCount() const {
+        return native ? native->registerCount() : optimized ? optimized->registerCount() : baseline ? baseline->registerCount() : 0;
+    }
+
+    void run(InputSpan inputs, std::string& output);
+
+private:
+    std::shared_ptr<const CompiledProgram> compiled;
+    EngineKind kind;
+    OutputFormat format;
+    std::optional<Interpreter> interpreter;
+    std::unique_ptr<BytecodeVM> baseline;
+    std::unique_ptr<BytecodeVM> optimized;
+    std::unique_ptr<NativeVM> native;
+    uint64_t runsInTier = 0;
+    uint64_t deoptimizationCount = 0;
+    std::future<std::unique_ptr<BytecodeVM>> pendingTier;
+    // Native code for the optimized tier of the generation it was started from (each
+    // optimized tier installed is a new generation); nullptr if the generator declined it
+    std::future<std::unique_ptr<NativeVM>> pendingNative;
+    uint64_t optimizedGeneration = 0;
+    uint64_t pendingNativeGeneration = 0;
+    bool nativeDeclined = false;
+    alloc_stats::Snapshot tierChanges = { 0, 0 };
+
+    // Output table state: the observed domain of the first tableInputs input values
+    size_t tableInputs;
+    bool tableCandidate;
+    std::vector<OutputTable::Range> observedDomain;
+    uint64_t observedRuns = 0;
+    std::chrono::steady_clock::duration observedTime{};
+    std::unique_ptr<OutputTable> table;
+    std::future<std::unique_ptr<OutputTable>> pendingTable;
+
+    // Widen the observed domain and, now and then, decide whether to build a table: it
+    // pays off when running the whole domain costs less than the time lookups would have
+    // saved over the runs seen so far (taken as a forecast of the runs still to come)
+    void observeForTable(InputSpan inputs, std::chrono::steady_clock::duration elapsed);
+
+    void runInTier(InputSpan inputs, std::string& output);
+
+    // Discard a run's output after a speculation guard failed and drop the speculating tiers
+    void deoptimize(std::string& output, size_t outputStart);
+
+    // Install a finished native compile, or start one once tier 2 is hot
+    void checkNative();
+
+    // Non-speculative optimized bytecode: the linked copy, or compiled from the tree
+    std::unique_ptr<const Bytecode> optimizedBytecode() const;
+
+    static std::unique_ptr<BytecodeVM> compileTier(std::shared_ptr<const CompiledProgram> compiled, OutputFormat format,
+                                                   bool optimize, const ExecutionProfile& profile);
+
+    void startCompile(bool optimize, ExecutionProfile profile);
+};
+
+// Run counts and timing reported with --stats
+struct RunStats {
+    uint64_t runs = 0;
+    std::chrono::steady_clock::duration time{};
+    int tier = 0;
+    uint64_t deoptimizations = 0;
+    uint32_t registers = 0;
+
+    void print(std::ostream& out) const {
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+        out << "runs: " << runs << ", time: " << micros << " us";
+        if (runs > 0) {
+            out << " (" << micros / static_cast<double>(runs) << " us/run)";
+        }
+        out << ", final tier: " << tier << ", deoptimizations: " << deoptimizations;
+        if (registers > 0) {
+            out << ", registers: " << registers;
+        }
+        out << "\n";
+    }
+};
+
+// Describe an error raised while running a script, with its location when it has one
+std::string describeError(const std::exception& error, const CompiledProgram& compiled);
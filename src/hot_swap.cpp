@@ -0,0 +1,53 @@
+/**
+ * @file hot_swap.cpp
+ * @brief Polling a script and recompiling it incrementally
+ */
+
+#include "hot_swap.h"
+#include "io.h"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+void ScriptWatcher::watch() {
+    std::unique_lock<std::mutex> lock(stopMutex);
+    while (!stopSignal.wait_for(lock, pollInterval, [this]() { return stopping; })) {
+        auto written = modificationTime();
+        if (written == lastWrite) {
+            continue;
+        }
+        lastWrite = written;
+        try {
+            std::string source = readFile(path);
+            const std::string& previous = compiler.source();
+            if (source == previous) {
+                continue;
+            }
+            size_t common = std::min(source.size(), previous.size());
+            size_t prefix = 0;
+            while (prefix < common && source[prefix] == previous[prefix]) {
+                ++prefix;
+            }
+            size_t suffix = 0;
+            while (suffix < common - prefix &&
+                   source[source.size() - 1 - suffix] == previous[previous.size() - 1 - suffix]) {
+                ++suffix;
+            }
+            const auto& diagnostics = compiler.applyEdit(prefix, previous.size() - prefix - suffix,
+                                                         source.substr(prefix, source.size() - prefix - suffix));
+            if (!diagnostics.empty()) {
+                std::string text = formatDiagnostics(path, compiler.source(), diagnostics);
+                std::cerr << text << "Keeping the previous version of '" << path << "'" << std::endl;
+                continue;
+            }
+            auto compiled = snapshotScript(path, compiler);
+            compiled->version = nextVersion++;
+            slot.publish(std::move(compiled));
+            std::cerr << "Reloaded '" << path << "'" << std::endl;
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << "\nKeeping the previous version of '" << path << "'" << std::endl;
+        }
+    }
+}
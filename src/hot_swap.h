@@ -0,0 +1,100 @@
+/**
+ * @file hot_swap.h
+ * @brief Publishing recompiled scripts to running workers (--watch)
+ */
+
+#pragma once
+
+#include "parser.h"
+#include "program.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// ProgramSlot class: Publishes the current CompiledProgram to running workers.
+// publish() swaps in a new snapshot; runs already in flight finish on the one they hold.
+// Workers read through a Reader, whose fast path is a single atomic load of the version
+// number: the shared pointer itself is only re-read (under the library's lock) right
+// after a publish.
+class ProgramSlot {
+public:
+    explicit ProgramSlot(std::shared_ptr<const CompiledProgram> initial) : published(std::move(initial)) {}
+
+    void publish(std::shared_ptr<const CompiledProgram> next) {
+        std::lock_guard<std::mutex> lock(publishMutex);
+        std::atomic_store(&published, std::move(next));
+        version.fetch_add(1, std::memory_order_release);
+    }
+
+    class Reader {
+    public:
+        explicit Reader(const ProgramSlot& slot) : slot(slot) {}
+
+        const std::shared_ptr<const CompiledProgram>& current() {
+            uint64_t latest = slot.version.load(std::memory_order_acquire);
+            if (!cached || latest != seenVersion) {
+                cached = std::atomic_load(&slot.published);
+                seenVersion = latest;
+            }
+            return cached;
+        }
+
+    private:
+        const ProgramSlot& slot;
+        std::shared_ptr<const CompiledProgram> cached;
+        uint64_t seenVersion = 0;
+    };
+
+private:
+    std::shared_ptr<const CompiledProgram> published;
+    std::atomic<uint64_t> version{ 0 };
+    std::mutex publishMutex;
+};
+
+// ScriptWatcher class: Polls a script file on a background thread and, when it changes,
+// recompiles it and publishes the result. The change is applied to an IncrementalCompiler
+// as one edit (the span between the unchanged start and end of the file), so only the
+// statements it touches are lexed and parsed again. A script that fails to compile is
+// reported and the previous snapshot stays in service.
+class ScriptWatcher {
+public:
+    ScriptWatcher(ProgramSlot& slot, std::string path, std::string source)
+        : slot(slot), path(std::move(path)), compiler(std::move(source)), lastWrite(modificationTime()),
+          worker([this]() { watch(); }) {}
+
+    ~ScriptWatcher() {
+        {
+            std::lock_guard<std::mutex> lock(stopMutex);
+            stopping = true;
+        }
+        stopSignal.notify_all();
+        worker.join();
+    }
+
+private:
+    static constexpr std::chrono::milliseconds pollInterval{ 200 };
+
+    ProgramSlot& slot;
+    std::string path;
+    IncrementalCompiler compiler;
+    std::filesystem::file_time_type lastWrite;
+    uint64_t nextVersion = 1;
+    std::mutex stopMutex;
+    std::condition_variable stopSignal;
+    bool stopping = false;
+    std::thread worker;
+
+    std::filesystem::file_time_type modificationTime() const {
+        std::error_code error;
+        return std::filesystem::last_write_time(path, error);
+    }
+
+    void watch();
+};
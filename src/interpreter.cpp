@@ -0,0 +1,66 @@
+/**
+ * @file interpreter.cpp
+ * @brief Tree-walking execution of the AST
+ */
+
+#include "interpreter.h"
+
+#include <stdexcept>
+
+void Interpreter::executeBlock(const std::vector<StmtPtr>& statements) {
+    if (chargesBlocks && !statements.empty() && !budget.charge(statements.size(), output->size(), statements.front()->offset)) {
+        budget.fail(statements.front()->offset);
+    }
+    for (auto& statement : statements) {
+        execute(statement.get());
+    }
+}
+
+// Execute a statement
+void Interpreter::execute(const Statement* statement) {
+    ++executedStatements;
+    if (auto assignStmt = dynamic_cast<const AssignStatement*>(statement)) {
+        int value = evaluate(assignStmt->expression, statement);
+        variables[assignStmt->slot] = value;
+        assigned[assignStmt->slot] = 1;
+    }
+    else if (auto printStmt = dynamic_cast<const PrintStatement*>(statement)) {
+        appendPrintedValue(*output, format, printStmt->id, evaluate(printStmt->expression, statement));
+    }
+    else if (auto inputStmt = dynamic_cast<const InputStatement*>(statement)) {
+        if (inputIndex >= inputs.size && !nextInputs(inputs, inputIndex)) {
+            throw RuntimeError("Not enough input values for input(" + inputStmt->identifier + ")", inputStmt->offset);
+        }
+        variables[inputStmt->slot] = inputs.data[inputIndex++];
+        assigned[inputStmt->slot] = 1;
+    }
+    else if (auto ifStmt = dynamic_cast<const IfStatement*>(statement)) {
+        if (evaluate(ifStmt->compareExpression, statement)) {
+            executeBlock(ifStmt->thenStatements);
+        }
+    }
+    else {
+        throw std::runtime_error("Unexpected statement");
+    }
+}
+
+// Evaluate an expression
+int Interpreter::evaluate(const Expression* expression, const Statement* statement) {
+    if (auto binOp = dynamic_cast<const BinaryOperation*>(expression)) {
+        int left = evaluate(binOp->left, statement);
+        int right = evaluate(binOp->right, statement);
+        return applyBinaryOp(binOp->op, left, right);
+    }
+    else if (auto ident = dynamic_cast<const Identifier*>(expression)) {
+        if (!assigned[ident->slot]) {
+            throw RuntimeError("Undefined variable '" + ident->name + "'", readOffset(statement, ident->slot));
+        }
+        return variables[ident->slot];
+    }
+    else if (auto num = dynamic_cast<const Number*>(expression)) {
+        return num->value;
+    }
+    else {
+        throw std::runtime_error("Unexpected expression");
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ * @file interpreter.h
+ * @brief The tree-walking interpreter (tier 0)
+ */
+
+#pragma once
+
+#include "ast.h"
+#include "runtime.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Interpreter class: Executes the AST
+class Interpreter {
+public:
+    Interpreter(const Program* program, InputSpan inputs, std::string& output, OutputFormat format = OutputFormat::TEXT)
+        : program(program), inputs(inputs), inputIndex(0), output(&output), format(format),
+          variables(program->symbols.names.size()), assigned(program->symbols.names.size()),
+          chargesBlocks(needsBlockCharges(*program)) {}
+
+    // Prepare another run of the same program; storage is reused, so this does not allocate
+    void reset(InputSpan newInputs) {
+        inputs = newInputs;
+        inputIndex = 0;
+        std::fill(assigned.begin(), assigned.end(), 0);
+    }
+
+    void reset(InputSpan newInputs, std::string& newOutput) {
+        reset(newInputs);
+        output = &newOutput;
+    }
+
+    void interpret() {
+        budget = RunBudget(output->size());
+        executeBlock(program->statements);
+        budget.checkOutput(output->size());
+        appendEndOfRun(*output, format);
+    }
+
+    // Statements executed over all runs so far (the tiered engine's hotness counter)
+    uint64_t statementsExecuted() const { return executedStatements; }
+
+private:
+    const Program* program;
+    InputSpan inputs;
+    size_t inputIndex;
+    std::string* output;
+    OutputFormat format;
+    std::vector<int> variables;   // Indexed by symbol slot
+    std::vector<uint8_t> assigned; // Whether each slot holds a value yet
+    uint64_t executedStatements = 0;
+    bool chargesBlocks;
+    RunBudget budget{ 0 };
+
+    void executeBlock(const std::vector<StmtPtr>& statements);
+    void execute(const Statement* statement);
+    // Evaluate the expression of a statement, which holds the source offsets of its occurrences
+    int evaluate(const Expression* expression, const Statement* statement);
+};
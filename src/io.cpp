@@ -0,0 +1,358 @@
+/**
+ * @file io.cpp
+ * @brief File and stream input
+ */
+
+#include "io.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Error opening '" + path + "'.");
+    }
+    file.seekg(0, std::ios::end);
+    std::string content(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0, std::ios::beg);
+    file.read(content.data(), static_cast<std::streamsize>(content.size()));
+    return content;
+}
+
+std::string readStandardInput() {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    std::string content;
+    char buffer[1 << 16];
+    size_t count;
+    while ((count = std::fread(buffer, 1, sizeof(buffer), stdin)) > 0) {
+        content.append(buffer, count);
+    }
+    if (std::ferror(stdin)) {
+        throw std::runtime_error("Error reading standard input");
+    }
+    return content;
+}
+
+std::vector<int> parseInputs(const std::string& text) {
+    std::vector<int> inputs;
+    const char* cursor = text.data();
+    const char* end = cursor + text.size();
+    while (cursor < end) {
+        const char* lineEnd = std::find(cursor, end, '\n');
+        while (cursor < lineEnd && std::isspace(static_cast<unsigned char>(*cursor))) {
+            ++cursor;
+        }
+        if (cursor < lineEnd && *cursor == '+') {
+            ++cursor;
+        }
+        int value = 0;
+        auto result = std::from_chars(cursor, lineEnd, value);
+        if (result.ec != std::errc()) {
+            throw std::runtime_error("Invalid input value: " + std::string(cursor, lineEnd));
+        }
+        inputs.push_back(value);
+        cursor = lineEnd + (lineEnd < end ? 1 : 0);
+    }
+    return inputs;
+}
+
+FileData::FileData(const std::string& path) {
+#ifdef GLSL_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* address = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                mapping = address;
+                mappedSize = static_cast<size_t>(info.st_size);
+            }
+        }
+        ::close(fd);
+        if (mapping) {
+            return;
+        }
+    }
+#endif
+    buffer = readFile(path);
+}
+
+FileData::~FileData() {
+#ifdef GLSL_HAS_MMAP
+    if (mapping) {
+        ::munmap(mapping, mappedSize);
+    }
+#endif
+}
+
+InputBuffer InputBuffer::load(const std::string& path) {
+    FileData file = path == "-" ? FileData::fromBuffer(readStandardInput()) : FileData(path);
+    if (glz::isCompressed(file.data(), file.size())) {
+        return InputBuffer(FileData::fromBuffer(glz::decompress(file.data(), file.size())));
+    }
+    return InputBuffer(std::move(file));
+}
+
+InputBuffer::InputBuffer(FileData data) : file(std::move(data)) {
+    const char* bytes = file.data();
+    size_t size = file.size();
+    if (!binary_input::isBinary(bytes, size)) {
+        values = parseInputs(std::string(bytes, size));
+        return;
+    }
+
+    uint8_t version = static_cast<uint8_t>(bytes[4]);
+    size_t width = static_cast<uint8_t>(bytes[5]);
+    auto encoding = static_cast<binary_input::Encoding>(bytes[6]);
+    count = static_cast<size_t>(binary_input::readLittleEndian(bytes + 8, 8));
+    if (version != binary_input::version || (width != 4 && width != 8)) {
+        throw std::runtime_error("Unsupported binary input header");
+    }
+    const char* cursor = bytes + binary_input::headerSize;
+    const char* end = bytes + size;
+
+    if (encoding == binary_input::Encoding::RAW) {
+        if (static_cast<size_t>(end - cursor) / width < count) {
+            throw std::runtime_error("Truncated binary input");
+        }
+        if (width == sizeof(int) && binary_input::hostIsLittleEndian()
+            && reinterpret_cast<uintptr_t>(cursor) % alignof(int) == 0) {
+            inPlace = true;
+            return;
+        }
+        values.reserve(count);
+        for (size_t i = 0; i < count; ++i, cursor += width) {
+            values.push_back(narrow(signExtend(binary_input::readLittleEndian(cursor, width), width)));
+        }
+        return;
+    }
+    if (encoding != binary_input::Encoding::DELTA_VARINT) {
+        throw std::runtime_error("Unsupported binary input encoding");
+    }
+    if (static_cast<size_t>(end - cursor) < count) { // Every varint takes at least one byte
+        throw std::runtime_error("Truncated binary input");
+    }
+    values.reserve(count);
+    int64_t previous = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t zigzag = 0;
+        for (int shift = 0;; shift += 7) {
+            if (cursor == end || shift > 63) {
+                throw std::runtime_error("Truncated binary input");
+            }
+            auto byte = static_cast<unsigned char>(*cursor++);
+            zigzag |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        int64_t delta = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+        previous += delta;
+        values.push_back(narrow(previous));
+    }
+}
+
+OutputWriter::OutputWriter(bool compressed, std::ostream& out) : compressed(compressed), out(out) {
+    if (compressed) {
+        out.write(glz::magic, sizeof(glz::magic));
+    }
+    worker = std::thread(&OutputWriter::write, this);
+}
+
+OutputWriter::~OutputWriter() {
+    // The worker drains the queue before it stops
+    queue.close();
+    worker.join();
+}
+
+void OutputWriter::submit(std::string data) {
+    {
+        std::lock_guard<std::mutex> lock(progressMutex);
+        ++submitted;
+    }
+    queue.push(std::move(data));
+}
+
+void OutputWriter::finish() {
+    std::unique_lock<std::mutex> lock(progressMutex);
+    progress.wait(lock, [this]() { return written == submitted; });
+    if (error) {
+        std::rethrow_exception(std::exchange(error, nullptr));
+    }
+}
+
+void OutputWriter::write() {
+    std::string buffer;
+    while (queue.pop(buffer)) {
+        std::exception_ptr failure;
+        try {
+            if (compressed) {
+                std::string blocks;
+                glz::compressBlocks(buffer.data(), buffer.size(), blocks);
+                out.write(blocks.data(), static_cast<std::streamsize>(blocks.size()));
+            }
+            else {
+                out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            }
+            out.flush();
+        }
+        catch (...) {
+            failure = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(progressMutex);
+        if (failure && !error) {
+            error = failure;
+        }
+        ++written;
+        progress.notify_all();
+    }
+}
+
+InputPrefetcher::InputPrefetcher(std::vector<std::string> paths, size_t threads, size_t depth)
+    : paths(std::move(paths)), depth(depth), slots(depth) {
+    threads = std::min(threads, this->paths.size());
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&InputPrefetcher::work, this);
+    }
+}
+
+InputPrefetcher::~InputPrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+InputBuffer InputPrefetcher::next() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (consumed >= paths.size()) {
+        throw std::runtime_error("No more input files to prefetch");
+    }
+    Slot& slot = slots[consumed % depth];
+    changed.wait(lock, [&slot]() { return slot.ready; });
+    Slot taken = std::move(slot);
+    slot = Slot();
+    ++consumed;
+    lock.unlock();
+    changed.notify_all();
+    if (taken.error) {
+        std::rethrow_exception(taken.error);
+    }
+    return std::move(*taken.buffer);
+}
+
+void InputPrefetcher::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        // A file may only load once the file depth places before it has been handed out,
+        // which frees its slot
+        changed.wait(lock, [this]() { return stopping || claimed >= paths.size() || claimed < consumed + depth; });
+        if (stopping || claimed >= paths.size()) {
+            return;
+        }
+        size_t index = claimed++;
+        lock.unlock();
+        Slot loaded;
+        try {
+            loaded.buffer = std::make_unique<InputBuffer>(InputBuffer::load(paths[index]));
+        }
+        catch (...) {
+            loaded.error = std::current_exception();
+        }
+        loaded.ready = true;
+        lock.lock();
+        slots[index % depth] = std::move(loaded);
+        changed.notify_all();
+    }
+}
+
+long readAvailable(std::FILE* file, char* buffer, size_t size) {
+    for (;;) {
+#if defined(GLSL_HAS_MMAP)
+        ssize_t count = ::read(fileno(file), buffer, size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+#elif defined(_WIN32)
+        int count = _read(_fileno(file), buffer, static_cast<unsigned>(size));
+#else
+        auto count = std::fread(buffer, 1, size, file);
+        if (count == 0 && std::ferror(file)) {
+            return -1;
+        }
+#endif
+        return static_cast<long>(count);
+    }
+}
+
+bool StdinInput::next(InputSpan& span) {
+    for (;;) {
+        size_t lineEnd = pending.rfind('\n');
+        if (lineEnd != std::string::npos || (finished && !pending.empty())) {
+            size_t used = lineEnd != std::string::npos ? lineEnd + 1 : pending.size();
+            values = parseInputs(pending.substr(0, used));
+            pending.erase(0, used);
+            if (!values.empty()) {
+                span = { values.data(), values.size(), this };
+                return true;
+            }
+        }
+        if (finished) {
+            return false;
+        }
+        if (!output.empty()) {
+            writer.submit(std::move(output));
+            output.clear();
+        }
+        char buffer[1 << 16];
+        long count = readAvailable(stdin, buffer, sizeof(buffer));
+        if (count < 0) {
+            throw std::runtime_error("Error reading standard input");
+        }
+        finished = count == 0;
+        pending.append(buffer, static_cast<size_t>(count));
+    }
+}
+
+std::vector<int> RecordReader::read() {
+    std::vector<int> records;
+    records.swap(partial);
+    for (;;) {
+        size_t lineEnd = pending.rfind('\n');
+        if (lineEnd != std::string::npos || (finished && !pending.empty())) {
+            size_t used = lineEnd != std::string::npos ? lineEnd + 1 : pending.size();
+            std::vector<int> values = parseInputs(pending.substr(0, used));
+            pending.erase(0, used);
+            records.insert(records.end(), values.begin(), values.end());
+        }
+        size_t whole = records.size() - records.size() % recordSize;
+        if (whole > 0 || finished) {
+            partial.assign(records.begin() + whole, records.end());
+            records.resize(whole);
+            if (finished && whole == 0 && !partial.empty()) {
+                throw std::runtime_error("Incomplete record at the end of the input: " + std::to_string(partial.size()) +
+                                         " of " + std::to_string(recordSize) + " values");
+            }
+            return records;
+        }
+        char buffer[1 << 16];
+        long count = readAvailable(file, buffer, sizeof(buffer));
+        if (count < 0) {
+            throw std::runtime_error("Error reading input");
+        }
+        finished = count == 0;
+        pending.append(buffer, static_cast<size_t>(count));
+    }
+}
@@ -0,0 +1,273 @@
+/**
+ * @file io.h
+ * @brief Files, input buffers, streamed input and the output writer
+ */
+
+#pragma once
+
+#include "codecs.h"
+#include "platform.h"
+#include "runtime.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Read a whole file with a single bulk read instead of line-by-line extraction
+std::string readFile(const std::string& path);
+
+// Read all of standard input (binary-safe)
+std::string readStandardInput();
+
+// Parse input values (one integer per line) directly from the file buffer
+std::vector<int> parseInputs(const std::string& text);
+
+// FileData class: Read-only file contents, memory-mapped where the platform supports it
+class FileData {
+public:
+    explicit FileData(const std::string& path);
+
+    static FileData fromBuffer(std::string content) {
+        FileData data;
+        data.buffer = std::move(content);
+        return data;
+    }
+
+    FileData(FileData&& other) noexcept
+        : buffer(std::move(other.buffer)), mapping(other.mapping), mappedSize(other.mappedSize) {
+        other.mapping = nullptr;
+        other.mappedSize = 0;
+    }
+
+    FileData(const FileData&) = delete;
+    FileData& operator=(const FileData&) = delete;
+    FileData& operator=(FileData&&) = delete;
+
+    ~FileData();
+
+    const char* data() const { return mapping ? static_cast<const char*>(mapping) : buffer.data(); }
+    size_t size() const { return mapping ? mappedSize : buffer.size(); }
+
+private:
+    std::string buffer;
+    void* mapping = nullptr;
+    size_t mappedSize = 0;
+
+    FileData() = default;
+};
+
+// InputBuffer class: Loaded input values, in either the text or the binary format, optionally
+// wrapped in a compressed stream. Loading (and decompression) runs on the prefetch threads.
+// Raw int32 columns on little-endian hosts are used in place; everything else is decoded once.
+class InputBuffer {
+public:
+    // "-" reads all of standard input
+    static InputBuffer load(const std::string& path);
+
+    InputSpan span() const {
+        if (inPlace) {
+            return { reinterpret_cast<const int*>(file.data() + binary_input::headerSize), count };
+        }
+        return { values.data(), values.size() };
+    }
+
+private:
+    FileData file;
+    std::vector<int> values;
+    bool inPlace = false;
+    size_t count = 0;
+
+    explicit InputBuffer(FileData data);
+
+    static int64_t signExtend(uint64_t value, size_t width) {
+        if (width == 4) {
+            return static_cast<int32_t>(static_cast<uint32_t>(value));
+        }
+        return static_cast<int64_t>(value);
+    }
+
+    static int narrow(int64_t value) {
+        if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max()) {
+            throw std::runtime_error("Input value out of range: " + std::to_string(value));
+        }
+        return static_cast<int>(value);
+    }
+};
+
+// BoundedQueue class: A queue between threads that holds at most `capacity` items. push
+// waits while it is full and pop while it is empty; after close, push drops its item and pop
+// drains what is left, then returns false.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this]() { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    std::deque<T> items;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+};
+
+// OutputWriter class: Writes run output to stdout on one long-lived background thread, in
+// submission order, optionally compressing it there as well. Submitted buffers wait in a
+// bounded queue, so a slow write only holds up the runs once `queueDepth` buffers are
+// waiting behind it.
+class OutputWriter {
+public:
+    static constexpr size_t queueDepth = 8;
+
+    explicit OutputWriter(bool compressed, std::ostream& out = std::cout);
+    ~OutputWriter();
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    void submit(std::string data);
+
+    // Wait until everything submitted so far is written; rethrows a failed write
+    void finish();
+
+private:
+    bool compressed;
+    std::ostream& out;
+    BoundedQueue<std::string> queue{ queueDepth };
+    std::mutex progressMutex;
+    std::condition_variable progress;
+    uint64_t submitted = 0;
+    uint64_t written = 0;
+    std::exception_ptr error;
+    std::thread worker;
+
+    void write();
+};
+
+// InputPrefetcher class: Loads input files (InputBuffer::load) on a fixed pool of threads,
+// at most `depth` files ahead of the one being run, and hands them out in order
+class InputPrefetcher {
+public:
+    InputPrefetcher(std::vector<std::string> paths, size_t threads = 2, size_t depth = 4);
+    ~InputPrefetcher();
+
+    InputPrefetcher(const InputPrefetcher&) = delete;
+    InputPrefetcher& operator=(const InputPrefetcher&) = delete;
+
+    // The next file's buffer; rethrows its load error
+    InputBuffer next();
+
+private:
+    struct Slot {
+        std::unique_ptr<InputBuffer> buffer;
+        std::exception_ptr error;
+        bool ready = false;
+    };
+
+    std::vector<std::string> paths;
+    size_t depth;
+    std::vector<Slot> slots; // Ring of depth slots; file i loads into slots[i % depth]
+    size_t claimed = 0;      // Files a worker has started on
+    size_t consumed = 0;     // Files handed out by next()
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::thread> workers;
+
+    void work();
+};
+
+// Read whatever a stream has available, blocking only while it has nothing; returns 0 at
+// the end of the stream and -1 on an error
+long readAvailable(std::FILE* file, char* buffer, size_t size);
+
+// StdinInput class: Text input values streamed from standard input (input path "-"). A run
+// reads them as they arrive, a chunk at a time, keeping only the current chunk, so a script
+// can sit in a pipeline over an unbounded stream. Before waiting for more input, the output
+// of the run so far is written out.
+class StdinInput : public InputSource {
+public:
+    StdinInput(std::string& output, OutputWriter& writer) : output(output), writer(writer) {}
+
+    bool next(InputSpan& span) override;
+
+private:
+    std::string& output;
+    OutputWriter& writer;
+    std::string pending;     // Read but not yet parsed: at most one partial line
+    std::vector<int> values; // The chunk the current view points into
+    bool finished = false;
+};
+
+// RecordReader class: Cuts a stream of text input values (a file, or standard input for
+// "-") into records of a fixed number of values. Each read returns the whole records that
+// have arrived by then, so a record is handed on as soon as its last value is read.
+class RecordReader {
+public:
+    RecordReader(const std::string& path, size_t recordSize) : recordSize(recordSize) {
+        file = path == "-" ? stdin : std::fopen(path.c_str(), "rb");
+        if (!file) {
+            throw std::runtime_error("Error opening '" + path + "'.");
+        }
+    }
+
+    ~RecordReader() {
+        if (file != stdin) {
+            std::fclose(file);
+        }
+    }
+
+    RecordReader(const RecordReader&) = delete;
+    RecordReader& operator=(const RecordReader&) = delete;
+
+    // The values of the next whole records, back to back; empty at the end of the stream
+    std::vector<int> read();
+
+private:
+    std::FILE* file;
+    size_t recordSize;
+    std::string pending;      // Read but not yet parsed: at most one partial line
+    std::vector<int> partial; // Parsed values of a record that is not complete yet
+    bool finished = false;
+};
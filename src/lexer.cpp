@@ -0,0 +1,142 @@
+/**
+ * @file lexer.cpp
+ * @brief Tokenizer and diagnostic formatting
+ */
+
+#include "lexer.h"
+
+#include <cctype>
+#include <limits>
+#include <stdexcept>
+
+const char* tokenTypeName(TokenType type) {
+    switch (type) {
+    case TokenType::IDENTIFIER: return "identifier";
+    case TokenType::NUMBER: return "number";
+    case TokenType::ASSIGN: return "'='";
+    case TokenType::PRINT: return "'print'";
+    case TokenType::INPUT: return "'input'";
+    case TokenType::IF: return "'if'";
+    case TokenType::THEN: return "'then'";
+    case TokenType::ENDIF: return "'endif'";
+    case TokenType::COMPARE_OP: return "comparison operator";
+    case TokenType::CALCULATE_OP: return "arithmetic operator";
+    case TokenType::SEMICOLON: return "';'";
+    case TokenType::LPAREN: return "'('";
+    case TokenType::RPAREN: return "')'";
+    case TokenType::END: return "end of file";
+    }
+    return "token";
+}
+
+std::string formatDiagnostics(const std::string& fileName, const std::string& source, const std::vector<Diagnostic>& diagnostics) {
+    LineTable lines(source);
+    std::string text;
+    for (const auto& diagnostic : diagnostics) {
+        auto [line, column] = lines.locate(diagnostic.offset);
+        text += fileName + ":" + std::to_string(line) + ":" + std::to_string(column) + ": error: " + diagnostic.message + "\n";
+    }
+    return text;
+}
+
+Lexer::Lexer(std::string_view source, size_t begin, size_t end)
+    : sourceCode(source), position(begin), end(std::min(end, source.size())) {
+    if (source.size() > std::numeric_limits<SourceOffset>::max()) {
+        throw std::runtime_error("Source file too large");
+    }
+}
+
+TokenStream Lexer::tokenize() {
+    TokenStream tokens(sourceCode);
+    while (position < end) {
+        char current = sourceCode[position];
+        size_t start = position;
+        TokenType type;
+        if (std::isspace(static_cast<unsigned char>(current))) {
+            ++position;
+            continue;
+        }
+        else if (std::isalpha(static_cast<unsigned char>(current))) {
+            type = readIdentifier();
+        }
+        else if (std::isdigit(static_cast<unsigned char>(current))) {
+            type = readNumber();
+        }
+        else {
+            try {
+                type = readSingleCharToken(current);
+            }
+            catch (const std::runtime_error& e) {
+                // Report and skip the character so the rest of the file is still checked
+                diagnosticList.push_back({ static_cast<SourceOffset>(start), e.what() });
+                ++position;
+                continue;
+            }
+        }
+        if (position - start > Token::maxLength) {
+            diagnosticList.push_back({ static_cast<SourceOffset>(start), "Token too long" });
+            continue;
+        }
+        tokens.push(type, static_cast<SourceOffset>(start), static_cast<uint32_t>(position - start));
+    }
+    tokens.push(TokenType::END, static_cast<SourceOffset>(end), 0);
+    return tokens;
+}
+
+TokenType Lexer::readIdentifier() {
+    size_t start = position;
+    while (position < end && std::isalnum(static_cast<unsigned char>(sourceCode[position]))) {
+        ++position;
+    }
+    std::string_view value = sourceCode.substr(start, position - start);
+    if (value == "print") return TokenType::PRINT;
+    if (value == "input") return TokenType::INPUT;
+    if (value == "if") return TokenType::IF;
+    if (value == "then") return TokenType::THEN;
+    if (value == "endif") return TokenType::ENDIF;
+    return TokenType::IDENTIFIER;
+}
+
+TokenType Lexer::readNumber() {
+    while (position < end && (std::isdigit(static_cast<unsigned char>(sourceCode[position])) || sourceCode[position] == '.')) {
+        ++position;
+    }
+    return TokenType::NUMBER;
+}
+
+TokenType Lexer::readSingleCharToken(char current) {
+    switch (current) {
+    case '=':
+        return handleCompareOrAssign();
+    case '>': case '<': case '!':
+        return handleCompareOperator();
+    case '+': case '-': case '*':
+        ++position;
+        return TokenType::CALCULATE_OP;
+    case '(':
+        ++position;
+        return TokenType::LPAREN;
+    case ')':
+        ++position;
+        return TokenType::RPAREN;
+    case ';':
+        ++position;
+        return TokenType::SEMICOLON;
+    default:
+        throw std::runtime_error("Unexpected character: " + std::string(1, current));
+    }
+}
+
+TokenType Lexer::handleCompareOrAssign() {
+    if (peek(1) == '=') {
+        position += 2;
+        return TokenType::COMPARE_OP;
+    }
+    ++position;
+    return TokenType::ASSIGN;
+}
+
+TokenType Lexer::handleCompareOperator() {
+    position += peek(1) == '=' ? 2 : 1;
+    return TokenType::COMPARE_OP;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file lexer.h
+ * @brief Tokens, source locations, diagnostics and the lexer
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+ // Token types enumeration: Defines the types of tokens in the source language
+enum class TokenType : uint8_t {
+    IDENTIFIER, NUMBER,
+    ASSIGN, PRINT, INPUT,
+    IF, THEN, ENDIF,
+    COMPARE_OP, CALCULATE_OP,
+    SEMICOLON, LPAREN, RPAREN,
+    END
+};
+
+// Byte offset into the source; scripts are limited to 4 GiB so locations stay 32 bits wide
+using SourceOffset = uint32_t;
+
+// Token structure: A packed 8-byte lexical token; its text is the source range [offset, offset + length)
+struct Token {
+    static constexpr uint32_t maxLength = (1u << 24) - 1;
+
+    SourceOffset offset;
+    uint32_t length : 24;
+    uint32_t kind : 8;
+
+    TokenType type() const { return static_cast<TokenType>(kind); }
+};
+static_assert(sizeof(Token) == 8, "Token must stay packed");
+
+// TokenStream class: The tokens of a source as parallel arrays. The parser scans the dense
+// one-byte kind array; offsets and lengths are only read when a token's text is needed.
+class TokenStream {
+public:
+    explicit TokenStream(std::string_view source = {}) : sourceText(source) {}
+
+    size_t size() const { return kinds.size(); }
+    TokenType kind(size_t index) const { return kinds[index]; }
+    const Token& operator[](size_t index) const { return tokens[index]; }
+    std::string_view text(size_t index) const { return sourceText.substr(tokens[index].offset, tokens[index].length); }
+
+    // Point at the source again after it was modified (and possibly moved)
+    void rebind(std::string_view source) { sourceText = source; }
+
+    void push(TokenType type, SourceOffset offset, uint32_t length) {
+        kinds.push_back(type);
+        tokens.push_back({ offset, length, static_cast<uint32_t>(type) });
+    }
+
+    void pop() {
+        kinds.pop_back();
+        tokens.pop_back();
+    }
+
+    // Replace tokens [begin, end) with the first count tokens of other
+    void splice(size_t begin, size_t end, const TokenStream& other, size_t count) {
+        kinds.erase(kinds.begin() + begin, kinds.begin() + end);
+        kinds.insert(kinds.begin() + begin, other.kinds.begin(), other.kinds.begin() + count);
+        tokens.erase(tokens.begin() + begin, tokens.begin() + end);
+        tokens.insert(tokens.begin() + begin, other.tokens.begin(), other.tokens.begin() + count);
+    }
+
+    // Move the offsets of tokens [from, size()) by delta bytes
+    void shift(size_t from, ptrdiff_t delta) {
+        for (size_t i = from; i < tokens.size(); ++i) {
+            tokens[i].offset = static_cast<SourceOffset>(tokens[i].offset + delta);
+        }
+    }
+
+private:
+    std::string_view sourceText;
+    std::vector<TokenType> kinds;
+    std::vector<Token> tokens;
+};
+
+// Diagnostic structure: A compile error and the source offset it was reported at
+struct Diagnostic {
+    SourceOffset offset;
+    std::string message;
+};
+
+// Readable token type names for diagnostics
+const char* tokenTypeName(TokenType type);
+
+// LineTable class: Maps source offsets to 1-based line and column. Nothing is computed until
+// the first lookup; it then records every line start once and answers by binary search.
+class LineTable {
+public:
+    explicit LineTable(const std::string& source) : source(source) {}
+
+    std::pair<uint32_t, uint32_t> locate(SourceOffset offset) const {
+        std::call_once(built, [this]() {
+            lineStarts.push_back(0);
+            for (size_t i = 0; i < source.size(); ++i) {
+                if (source[i] == '\n') {
+                    lineStarts.push_back(static_cast<SourceOffset>(i + 1));
+                }
+            }
+        });
+        auto next = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+        auto line = static_cast<uint32_t>(next - lineStarts.begin());
+        return { line, offset - *(next - 1) + 1 };
+    }
+
+    // "<file>:<line>:<column>"
+    std::string describe(const std::string& fileName, SourceOffset offset) const {
+        auto [line, column] = locate(offset);
+        return fileName + ":" + std::to_string(line) + ":" + std::to_string(column);
+    }
+
+private:
+    const std::string& source;
+    mutable std::once_flag built;
+    mutable std::vector<SourceOffset> lineStarts;
+};
+
+// Format diagnostics as "<file>:<line>:<column>: error: <message>" lines
+std::string formatDiagnostics(const std::string& fileName, const std::string& source, const std::vector<Diagnostic>& diagnostics);
+
+// Lexer class: Tokenizes input source code (or the [begin, end) part of it; offsets stay
+// relative to the whole source). The source must outlive the lexer and its tokens.
+class Lexer {
+public:
+    explicit Lexer(std::string_view source, size_t begin = 0, size_t end = std::string_view::npos);
+
+    TokenStream tokenize();
+
+    // Errors found by tokenize(); empty (and unallocated) for a clean source
+    const std::vector<Diagnostic>& diagnostics() const { return diagnosticList; }
+
+private:
+    std::string_view sourceCode;
+    size_t position;
+    size_t end;
+    std::vector<Diagnostic> diagnosticList;
+
+    char peek(size_t ahead) const {
+        return position + ahead < end ? sourceCode[position + ahead] : '\0';
+    }
+
+    TokenType readIdentifier();
+    TokenType readNumber();
+    TokenType readSingleCharToken(char current);
+    TokenType handleCompareOrAssign();
+    TokenType handleCompareOperator();
+};
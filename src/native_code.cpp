@@ -0,0 +1,88 @@
+/**
+ * @file native_code.cpp
+ * @brief The callbacks of generated machine code
+ */
+
+#include "native_code.h"
+
+namespace native_code {
+    RunState::RunState(InputSpan inputs, std::string& output, OutputFormat format) : budget(output.size()) {
+        context.inputs = inputs;
+        context.output = &output;
+        context.format = format;
+        context.budget = &budget;
+        context.limitError = &limitError;
+        context.input = contextInput;
+        context.print = contextPrint;
+        context.undefined = contextUndefined;
+        context.charge = contextCharge;
+    }
+
+    bool RunState::finish(int32_t status, const Program& program) {
+        if (status == 1) {
+            return false;
+        }
+        if (status == 2) {
+            if (limitError) {
+                std::rethrow_exception(limitError);
+            }
+            const std::string& name = program.symbols.names[context.errorSlot];
+            if (context.errorKind == 1) {
+                throw RuntimeError("Undefined variable '" + name + "'", context.errorOffset);
+            }
+            throw RuntimeError("Not enough input values for input(" + name + ")", context.errorOffset);
+        }
+        budget.checkOutput(context.output->size());
+        appendEndOfRun(*context.output, context.format);
+        return true;
+    }
+
+    bool feedsOnlyNext(const Bytecode& bytecode, const Liveness& liveness, size_t pc) {
+        if (pc + 1 >= bytecode.code.size() || liveness.blockOf(pc + 1) != liveness.blockOf(pc)) {
+            return false;
+        }
+        int32_t def, use1, use2, nextDef;
+        instructionRegisters(bytecode.code[pc], def, use1, use2);
+        if (def < 0) {
+            return false;
+        }
+        instructionRegisters(bytecode.code[pc + 1], nextDef, use1, use2);
+        return (use1 == def) != (use2 == def) && (nextDef == def || !liveness.liveAfter(pc + 1, def));
+    }
+
+    int32_t contextInput(Context* context, uint32_t slot, uint32_t offset) {
+        if (context->inputIndex >= context->inputs.size && !nextInputs(context->inputs, context->inputIndex)) {
+            context->errorKind = 2;
+            context->errorSlot = slot;
+            context->errorOffset = offset;
+            return 1;
+        }
+        context->value = context->inputs.data[context->inputIndex++];
+        return 0;
+    }
+
+    void contextPrint(Context* context, uint32_t id, int32_t value) {
+        appendPrintedValue(*context->output, context->format, id, value);
+    }
+
+    void contextUndefined(Context* context, uint32_t slot, uint32_t offset) {
+        context->errorKind = 1;
+        context->errorSlot = slot;
+        context->errorOffset = offset;
+    }
+
+    // Exceptions cannot unwind through generated code, so a limit error is kept for the caller
+    int32_t contextCharge(Context* context, uint32_t statements, uint32_t offset) {
+        if (context->budget->charge(statements, context->output->size(), offset)) {
+            return 0;
+        }
+        try {
+            context->budget->fail(offset);
+        }
+        catch (...) {
+            context->errorKind = 3;
+            *context->limitError = std::current_exception();
+            return 1;
+        }
+    }
+}
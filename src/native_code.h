@@ -0,0 +1,70 @@
+/**
+ * @file native_code.h
+ * @brief What generated machine code shares with the C++ it calls back into
+ */
+
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+#include "runtime.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+
+// Native code (tier 4). The code generators (aarch64.h, x86_64.h) translate optimized
+// Bytecode into a function
+//     int32_t run(uint8_t* assigned, native_code::Context* context)
+// that returns 0 when the run completes, 1 when a speculation guard fails and 2 after a
+// run time error (described in the context). allocateRegisters() puts the bytecode
+// registers, variables included, in callee-saved machine registers, and the rest in spill
+// slots in the function's stack frame. Input, print, error reporting and run limits call
+// back into C++ through the context.
+namespace native_code {
+    struct Context {
+        InputSpan inputs;
+        size_t inputIndex;
+        std::string* output;
+        OutputFormat format;
+        int32_t value;        // The value read by input()
+        int32_t errorKind;    // 1: undefined variable; 2: not enough input values; 3: limitError
+        uint32_t errorSlot;
+        uint32_t errorOffset;
+        RunBudget* budget;
+        std::exception_ptr* limitError;
+        int32_t (*input)(Context* context, uint32_t slot, uint32_t offset);
+        void (*print)(Context* context, uint32_t id, int32_t value);
+        void (*undefined)(Context* context, uint32_t slot, uint32_t offset);
+        int32_t (*charge)(Context* context, uint32_t statements, uint32_t offset);
+    };
+
+    // RunState structure: A Context set up for one run, with the budget and error its
+    // callbacks fill in. finish() turns the status generated code returned into the result of
+    // NativeVM::run (false when a speculation guard failed), or throws the run time error.
+    struct RunState {
+        Context context{};
+        RunBudget budget;
+        std::exception_ptr limitError;
+
+        RunState(InputSpan inputs, std::string& output, OutputFormat format);
+
+        RunState(const RunState&) = delete;
+        RunState& operator=(const RunState&) = delete;
+
+        bool finish(int32_t status, const Program& program);
+    };
+
+    // Whether the register instruction pc defines is read by the next instruction of its basic
+    // block, once, and by nothing after it; the code generators then select machine code
+    // for the pair together (an immediate operand, a shifted or multiply-add operand, a
+    // compare and branch) and never materialize the register
+    bool feedsOnlyNext(const Bytecode& bytecode, const Liveness& liveness, size_t pc);
+
+    // The callbacks generated code reaches through its Context
+    int32_t contextInput(Context* context, uint32_t slot, uint32_t offset);
+    void contextPrint(Context* context, uint32_t id, int32_t value);
+    void contextUndefined(Context* context, uint32_t slot, uint32_t offset);
+    int32_t contextCharge(Context* context, uint32_t statements, uint32_t offset);
+}
@@ -0,0 +1,67 @@
+/**
+ * @file native_vm.cpp
+ * @brief Mapping generated code and running it
+ */
+
+#include "native_vm.h"
+#include "aarch64.h"
+#include "x86_64.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    // Machine code for the host, as bytes
+    bool generateForHost(const Bytecode& bytecode, std::vector<uint8_t>& code) {
+#if defined(__aarch64__)
+        std::vector<uint32_t> words;
+        if (!aarch64::CodeGenerator(bytecode).generate(words)) {
+            return false;
+        }
+        code.resize(words.size() * sizeof(uint32_t));
+        std::memcpy(code.data(), words.data(), code.size());
+        return true;
+#else
+        return x86_64::CodeGenerator(bytecode).generate(code);
+#endif
+    }
+}
+
+std::unique_ptr<NativeVM> NativeVM::create(std::unique_ptr<const Bytecode> bytecode, const Program* program,
+                                           OutputFormat format) {
+    std::vector<uint8_t> code;
+    if (!supported() || !generateForHost(*bytecode, code)) {
+        return nullptr;
+    }
+    auto vm = std::unique_ptr<NativeVM>(new NativeVM(std::move(bytecode), program, format));
+#ifdef GLSL_NATIVE_HOST
+    vm->mappedSize = code.size();
+    void* memory = mmap(nullptr, vm->mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+    std::memcpy(memory, code.data(), vm->mappedSize);
+    if (mprotect(memory, vm->mappedSize, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, vm->mappedSize);
+        return nullptr;
+    }
+    __builtin___clear_cache(static_cast<char*>(memory), static_cast<char*>(memory) + vm->mappedSize);
+    vm->machineCode = memory;
+    vm->entry = reinterpret_cast<Function>(memory);
+#endif
+    return vm;
+}
+
+NativeVM::~NativeVM() {
+#ifdef GLSL_NATIVE_HOST
+    if (machineCode) {
+        munmap(machineCode, mappedSize);
+    }
+#endif
+}
+
+bool NativeVM::run(InputSpan inputs, std::string& output) {
+    std::fill(assigned.begin(), assigned.end(), 0);
+    native_code::RunState state(inputs, output, format);
+    return state.finish(entry(assigned.data(), &state.context), *program);
+}
@@ -0,0 +1,66 @@
+/**
+ * @file native_vm.h
+ * @brief Execution of bytecode compiled to machine code
+ */
+
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+#include "native_code.h"
+#include "platform.h"
+#include "runtime.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <vector>
+
+// Hosts whose machine code the native engine generates and runs
+#if (defined(__aarch64__) || defined(__x86_64__)) && defined(__linux__) && defined(GLSL_HAS_MMAP)
+#define GLSL_NATIVE_HOST 1
+#endif
+
+// NativeVM class: Runs a Bytecode compiled to the host's machine code (AArch64 or x86-64),
+// with the same interface as BytecodeVM. Only available on AArch64 and x86-64 Linux.
+class NativeVM {
+public:
+    using Function = int32_t (*)(uint8_t* assigned, native_code::Context* context);
+
+    static bool supported() {
+#ifdef GLSL_NATIVE_HOST
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Compile to machine code; nullptr when the bytecode does not fit the generator
+    static std::unique_ptr<NativeVM> create(std::unique_ptr<const Bytecode> bytecode, const Program* program,
+                                            OutputFormat format);
+
+    ~NativeVM();
+
+    NativeVM(const NativeVM&) = delete;
+    NativeVM& operator=(const NativeVM&) = delete;
+
+    uint32_t registerCount() const { return bytecode->registerCount; }
+
+    // Run the program; false when a speculation guard fails (as BytecodeVM::run)
+    bool run(InputSpan inputs, std::string& output);
+
+private:
+    std::unique_ptr<const Bytecode> bytecode;
+    const Program* program;
+    OutputFormat format;
+    std::vector<uint8_t> assigned;
+    void* machineCode = nullptr;
+    size_t mappedSize = 0;
+    Function entry = nullptr;
+
+    NativeVM(std::unique_ptr<const Bytecode> bytecode, const Program* program, OutputFormat format)
+        : bytecode(std::move(bytecode)), program(program), format(format),
+          assigned(std::max<size_t>(program->symbols.names.size(), 1)) {}
+};
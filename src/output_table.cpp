@@ -0,0 +1,70 @@
+/**
+ * @file output_table.cpp
+ * @brief Building and reading output tables
+ */
+
+#include "output_table.h"
+#include "bytecode_compiler.h"
+#include "bytecode_vm.h"
+
+std::unique_ptr<OutputTable> OutputTable::build(const Program& program, std::vector<Range> domain,
+                                              OutputFormat format, size_t maxBytes) {
+    auto table = std::make_unique<OutputTable>();
+    size_t entries = domainSize(domain);
+    table->domain = std::move(domain);
+    table->offsets.reserve(entries + 1);
+    table->failed.assign(entries, 0);
+
+    BytecodeVM vm(BytecodeCompiler(program, true).compile(), &program, format, false);
+    std::vector<int> values(table->domain.size());
+    for (size_t i = 0; i < table->domain.size(); ++i) {
+        values[i] = table->domain[i].low;
+    }
+    for (size_t entry = 0; entry < entries; ++entry) {
+        size_t start = table->outputs.size();
+        table->offsets.push_back(static_cast<uint32_t>(start));
+        try {
+            vm.run({ values.data(), values.size() }, table->outputs);
+        }
+        catch (const LimitError&) {
+            return nullptr;
+        }
+        catch (const RuntimeError&) {
+            table->outputs.resize(start);
+            table->failed[entry] = 1;
+        }
+        if (table->outputs.size() > maxBytes) {
+            return nullptr;
+        }
+        // Next input vector, the last value varying fastest (matching lookup's indexing)
+        for (size_t i = values.size(); i-- > 0;) {
+            if (values[i] < table->domain[i].high) {
+                ++values[i];
+                break;
+            }
+            values[i] = table->domain[i].low;
+        }
+    }
+    table->offsets.push_back(static_cast<uint32_t>(table->outputs.size()));
+    return table;
+}
+
+bool OutputTable::lookup(InputSpan inputs, std::string& output) const {
+    if (inputs.size < domain.size()) {
+        return false;
+    }
+    size_t entry = 0;
+    for (size_t i = 0; i < domain.size(); ++i) {
+        int value = inputs.data[i];
+        if (value < domain[i].low || value > domain[i].high) {
+            return false;
+        }
+        entry = entry * (static_cast<size_t>(static_cast<int64_t>(domain[i].high) - domain[i].low) + 1) +
+                static_cast<size_t>(static_cast<int64_t>(value) - domain[i].low);
+    }
+    if (failed[entry]) {
+        return false;
+    }
+    output.append(outputs, offsets[entry], offsets[entry + 1] - offsets[entry]);
+    return true;
+}
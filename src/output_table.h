@@ -0,0 +1,55 @@
+/**
+ * @file output_table.h
+ * @brief Precomputed outputs over a small input domain (tier 3)
+ */
+
+#pragma once
+
+#include "ast.h"
+#include "runtime.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+// OutputTable class: The output of every run over a small input domain, computed ahead of
+// time so that a run becomes a lookup. The domain is a range of values for each of the
+// first inputCount input values, inputCount being the most any path through the program
+// reads. Runs outside the domain, and runs that fail, are left to the execution tiers.
+class OutputTable {
+public:
+    struct Range {
+        int low;
+        int high;
+    };
+
+    // Number of runs in a domain (saturating at SIZE_MAX)
+    static size_t domainSize(const std::vector<Range>& domain) {
+        size_t size = 1;
+        for (const auto& range : domain) {
+            size_t width = static_cast<size_t>(static_cast<int64_t>(range.high) - range.low + 1);
+            if (size > std::numeric_limits<size_t>::max() / width) {
+                return std::numeric_limits<size_t>::max();
+            }
+            size *= width;
+        }
+        return size;
+    }
+
+    static std::unique_ptr<OutputTable> build(const Program& program, std::vector<Range> domain,
+                                              OutputFormat format, size_t maxBytes);
+
+    // Append the output of a run; false when the run is not in the table
+    bool lookup(InputSpan inputs, std::string& output) const;
+
+    size_t entryCount() const { return failed.size(); }
+
+private:
+    std::vector<Range> domain;
+    std::vector<uint32_t> offsets; // Entry i's output is outputs[offsets[i], offsets[i + 1])
+    std::vector<uint8_t> failed;   // Entries whose run raised a RuntimeError
+    std::string outputs;
+};
@@ -0,0 +1,325 @@
+/**
+ * @file parser.cpp
+ * @brief Recursive-descent parsing with error recovery, and incremental recompilation
+ */
+
+#include "parser.h"
+
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+
+std::unique_ptr<Program> Parser::parse(std::vector<StatementExtent>* extents) {
+    auto program = std::make_unique<Program>();
+    symbols = sharedProgram ? &sharedProgram->symbols : &program->symbols;
+    expressions = sharedProgram ? &sharedProgram->expressions : &program->expressions;
+    while (currentType() != TokenType::END) {
+        bool parsed = true;
+        try {
+            program->statements.push_back(parseStatement());
+        }
+        catch (const ParseError& e) {
+            parsed = false;
+            if (recover(e)) {
+                // Stray endif at the top level: it has been reported, skip it
+                ++position;
+                if (currentType() == TokenType::SEMICOLON) {
+                    ++position;
+                }
+                else if (currentType() == TokenType::END) {
+                    recoveredToEnd = true; // A ';' after the end would have been skipped too
+                }
+            }
+        }
+        if (extents) {
+            extents->push_back({ position, parsed });
+        }
+    }
+    return program;
+}
+
+int Parser::numberValue(size_t index) const {
+    std::string_view text = tokens.text(index);
+    int value = 0;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec != std::errc()) {
+        throw ParseError("Number out of range: " + tokenText(index), tokens[index].offset);
+    }
+    return value;
+}
+
+void Parser::fail(const std::string& expected) const {
+    std::string found = currentType() == TokenType::END ? "end of file" : "'" + tokenText(position) + "'";
+    throw ParseError("Expected " + expected + " but found " + found, tokens[position].offset);
+}
+
+size_t Parser::consume(TokenType type) {
+    if (currentType() != type) {
+        fail(tokenTypeName(type));
+    }
+    return position++;
+}
+
+bool Parser::recover(const ParseError& error) {
+    diagnosticList.push_back({ error.offset, error.what() });
+    while (true) {
+        TokenType type = currentType();
+        if (type == TokenType::END || type == TokenType::ENDIF) {
+            recoveredToEnd = recoveredToEnd || type == TokenType::END;
+            return type == TokenType::ENDIF;
+        }
+        ++position;
+        if (type == TokenType::SEMICOLON) {
+            return false;
+        }
+    }
+}
+
+// Parse a statement
+StmtPtr Parser::parseStatement() {
+    if (currentType() == TokenType::IF) {
+        return parseIfStatement();
+    }
+    else {
+        auto stmt = parseSimpleStatement();
+        consume(TokenType::SEMICOLON);
+        return stmt;
+    }
+}
+
+// Parse an if statement
+StmtPtr Parser::parseIfStatement() {
+    SourceOffset start = tokens[consume(TokenType::IF)].offset;
+    std::vector<SourceOffset> offsets;
+    auto condition = parseExpression(offsets);
+    consume(TokenType::THEN);
+    std::vector<StmtPtr> thenStatements;
+    while (currentType() != TokenType::ENDIF && currentType() != TokenType::END) {
+        try {
+            thenStatements.push_back(parseStatement());
+        }
+        catch (const ParseError& e) {
+            recover(e);
+        }
+    }
+    consume(TokenType::ENDIF);
+    consume(TokenType::SEMICOLON);
+    return located(std::make_unique<IfStatement>(IfStatement{ condition, std::move(thenStatements) }), start, std::move(offsets));
+}
+
+// Parse a simple statement
+StmtPtr Parser::parseSimpleStatement() {
+    if (currentType() == TokenType::IDENTIFIER) {
+        return parseAssignStatement();
+    }
+    else if (currentType() == TokenType::PRINT) {
+        return parsePrintStatement();
+    }
+    else if (currentType() == TokenType::INPUT) {
+        return parseInputStatement();
+    }
+    else {
+        fail("a statement");
+    }
+}
+
+// Parse an assignment statement
+StmtPtr Parser::parseAssignStatement() {
+    size_t target = consume(TokenType::IDENTIFIER);
+    consume(TokenType::ASSIGN);
+    std::vector<SourceOffset> offsets;
+    auto expression = parseExpression(offsets);
+    auto stmt = std::make_unique<AssignStatement>(AssignStatement{ tokenText(target), expression });
+    stmt->slot = symbols->slotFor(stmt->identifier);
+    return located(std::move(stmt), tokens[target].offset, std::move(offsets));
+}
+
+// Parse a print statement
+StmtPtr Parser::parsePrintStatement() {
+    SourceOffset start = tokens[consume(TokenType::PRINT)].offset;
+    consume(TokenType::LPAREN);
+    std::vector<SourceOffset> offsets;
+    auto expression = parseExpression(offsets);
+    consume(TokenType::RPAREN);
+    return located(std::make_unique<PrintStatement>(PrintStatement{ expression, printCount++ }), start, std::move(offsets));
+}
+
+// Parse an input statement
+StmtPtr Parser::parseInputStatement() {
+    SourceOffset start = tokens[consume(TokenType::INPUT)].offset;
+    consume(TokenType::LPAREN);
+    std::string identifier = tokenText(consume(TokenType::IDENTIFIER));
+    consume(TokenType::RPAREN);
+    auto stmt = std::make_unique<InputStatement>(InputStatement{ identifier });
+    stmt->slot = symbols->slotFor(identifier);
+    return located(std::move(stmt), start);
+}
+
+// Parse an expression; an identical one parsed before, anywhere in the program, yields the same node
+const Expression* Parser::parseExpression(std::vector<SourceOffset>& offsets) {
+    auto left = parsePrimary(offsets);
+    while (currentType() == TokenType::COMPARE_OP || currentType() == TokenType::CALCULATE_OP) {
+        BinaryOp kind;
+        if (!binaryOpFromText(tokens.text(position), kind)) {
+            throw ParseError("Unexpected binary operator: " + tokenText(position), tokens[position].offset);
+        }
+        size_t op = consume(currentType());
+        auto right = parsePrimary(offsets);
+        left = expressions->binary(kind, left, right);
+        offsets.push_back(tokens[op].offset);
+    }
+    return left;
+}
+
+// Parse a primary expression
+const Expression* Parser::parsePrimary(std::vector<SourceOffset>& offsets) {
+    if (currentType() == TokenType::IDENTIFIER) {
+        size_t name = consume(TokenType::IDENTIFIER);
+        std::string identifier = tokenText(name);
+        offsets.push_back(tokens[name].offset);
+        return expressions->variable(identifier, symbols->slotFor(identifier));
+    }
+    else if (currentType() == TokenType::NUMBER) {
+        size_t number = consume(TokenType::NUMBER);
+        const Expression* node = expressions->number(numberValue(number));
+        offsets.push_back(tokens[number].offset);
+        return node;
+    }
+    else if (currentType() == TokenType::LPAREN) {
+        consume(TokenType::LPAREN);
+        auto expression = parseExpression(offsets);
+        consume(TokenType::RPAREN);
+        return expression;
+    }
+    else {
+        fail("an expression");
+    }
+}
+
+const std::vector<Diagnostic>& IncrementalCompiler::applyEdit(size_t offset, size_t removedLength, const std::string& insertedText) {
+    if (offset > sourceCode.size() || removedLength > sourceCode.size() - offset) {
+        throw std::out_of_range("Edit outside of the script");
+    }
+    size_t editEnd = offset + removedLength;
+
+    // Damaged units: every top-level statement touching [offset, editEnd], and a broken
+    // one just before them (a stray endif takes in a following ';')
+    size_t first = 0;
+    while (first < units.size() && units[first].end < offset) ++first;
+    size_t last = first;
+    while (last < units.size() && units[last].begin <= editEnd) ++last;
+    if (first > 0 && !units[first - 1].parsed) {
+        --first;
+    }
+
+    // Source region between the undamaged neighbours; the gaps hold only whitespace (and
+    // characters the lexer rejects), so lexing can restart at either boundary
+    size_t regionBegin = first > 0 ? units[first - 1].end : 0;
+    size_t regionEnd = last < units.size() ? units[last].begin : sourceCode.size();
+    regionBegin = std::min(regionBegin, offset);
+    regionEnd = std::max(regionEnd, editEnd);
+
+    // Diagnostics inside the region are replaced by recompile(); later ones move with the source
+    bool regionReachesEnd = regionEnd == sourceCode.size();
+    diagnosticList.erase(std::remove_if(diagnosticList.begin(), diagnosticList.end(),
+                                        [&](const Diagnostic& diagnostic) {
+                                            return diagnostic.offset >= regionBegin &&
+                                                   (regionReachesEnd || diagnostic.offset < regionEnd);
+                                        }),
+                         diagnosticList.end());
+
+    sourceCode.replace(offset, removedLength, insertedText);
+    ptrdiff_t delta = static_cast<ptrdiff_t>(insertedText.size()) - static_cast<ptrdiff_t>(removedLength);
+    size_t statement = statementIndex(last);
+    for (size_t i = last; i < units.size(); ++i) {
+        units[i].begin += delta;
+        units[i].end += delta;
+        if (delta != 0 && units[i].parsed) {
+            shiftSourceOffsets(programAst.statements[statement++].get(), delta);
+        }
+    }
+    for (auto& diagnostic : diagnosticList) {
+        if (diagnostic.offset >= regionEnd) {
+            diagnostic.offset = static_cast<SourceOffset>(diagnostic.offset + delta);
+        }
+    }
+    tokens.rebind(sourceCode);
+    tokens.shift(last < units.size() ? units[last].firstToken : tokens.size(), delta);
+    recompile(first, last, regionBegin, regionEnd + delta);
+    return diagnosticList;
+}
+
+void IncrementalCompiler::recompile(size_t first, size_t last, size_t regionBegin, size_t regionEnd) {
+    TokenStream regionTokens;
+    std::vector<Parser::StatementExtent> extents;
+    std::vector<Diagnostic> regionDiagnostics;
+    std::unique_ptr<Program> parsed;
+    while (true) {
+        Lexer lexer(sourceCode, regionBegin, regionEnd);
+        regionTokens = lexer.tokenize();
+        extents.clear();
+        Parser parser(regionTokens, &programAst);
+        parsed = parser.parse(&extents);
+        if (!parser.reachedEnd() || last == units.size()) {
+            regionDiagnostics = lexer.diagnostics();
+            regionDiagnostics.insert(regionDiagnostics.end(), parser.diagnostics().begin(), parser.diagnostics().end());
+            break;
+        }
+        ++last;
+        regionEnd = last < units.size() ? units[last].begin : sourceCode.size();
+    }
+    regionTokens.pop(); // END
+
+    // The region's diagnostics replace any left inside it by statements it grew over (up to
+    // the end of the source when the region reaches it, for errors at the end of file)
+    bool reachesEnd = regionEnd == sourceCode.size();
+    diagnosticList.erase(std::remove_if(diagnosticList.begin(), diagnosticList.end(),
+                                        [&](const Diagnostic& diagnostic) {
+                                            return diagnostic.offset >= regionBegin &&
+                                                   (reachesEnd || diagnostic.offset < regionEnd);
+                                        }),
+                         diagnosticList.end());
+    diagnosticList.insert(diagnosticList.end(), regionDiagnostics.begin(), regionDiagnostics.end());
+    std::stable_sort(diagnosticList.begin(), diagnosticList.end(),
+                     [](const Diagnostic& a, const Diagnostic& b) { return a.offset < b.offset; });
+
+    size_t tokenBegin = first < units.size() ? units[first].firstToken : tokens.size();
+    size_t tokenEnd = last < units.size() ? units[last].firstToken : tokens.size();
+    ptrdiff_t tokenDelta = static_cast<ptrdiff_t>(regionTokens.size()) - static_cast<ptrdiff_t>(tokenEnd - tokenBegin);
+    tokens.splice(tokenBegin, tokenEnd, regionTokens, regionTokens.size());
+    tokens.rebind(sourceCode);
+
+    std::vector<Unit> newUnits;
+    size_t extentBegin = 0;
+    for (const auto& extent : extents) {
+        const Token& lastToken = regionTokens[extent.end - 1];
+        newUnits.push_back({ regionTokens[extentBegin].offset, size_t(lastToken.offset) + lastToken.length,
+                             tokenBegin + extentBegin, extent.end - extentBegin, extent.parsed });
+        extentBegin = extent.end;
+    }
+    for (size_t i = last; i < units.size(); ++i) {
+        units[i].firstToken += tokenDelta;
+    }
+    size_t statementBegin = statementIndex(first);
+    size_t statementEnd = statementBegin;
+    for (size_t i = first; i < last; ++i) {
+        statementEnd += units[i].parsed ? 1 : 0;
+    }
+    units.erase(units.begin() + first, units.begin() + last);
+    units.insert(units.begin() + first, newUnits.begin(), newUnits.end());
+
+    auto& statements = programAst.statements;
+    statements.erase(statements.begin() + statementBegin, statements.begin() + statementEnd);
+    statements.insert(statements.begin() + statementBegin,
+                      std::make_move_iterator(parsed->statements.begin()),
+                      std::make_move_iterator(parsed->statements.end()));
+    uint32_t nextPrintId = 0;
+    numberPrintStatements(statements, nextPrintId);
+
+    if (programAst.expressions.size() > 2 * std::max<size_t>(expressionsKept, minimumTableRebuild)) {
+        ExpressionTable expressions;
+        reinternExpressions(statements, expressions);
+        programAst.expressions = std::move(expressions);
+        expressionsKept = programAst.expressions.size();
+    }
+}
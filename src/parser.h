@@ -0,0 +1,164 @@
+/**
+ * @file parser.h
+ * @brief The parser and the incremental compiler built on it
+ */
+
+#pragma once
+
+#include "ast.h"
+#include "lexer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Parser class: Parses tokens into an AST
+class Parser {
+public:
+    // Variables are resolved to slots of the new program's symbol table, and expressions
+    // hash-consed in its expression table, or in those of sharedProgram when statements are
+    // parsed for an existing program
+    explicit Parser(const TokenStream& tokens, Program* sharedProgram = nullptr)
+        : tokens(tokens), position(0), sharedProgram(sharedProgram) {}
+
+    // The tokens of one top-level statement: it ends just before token `end`, and `parsed`
+    // is false when a syntax error left nothing of it (the recovery skipped its tokens)
+    struct StatementExtent {
+        size_t end;
+        bool parsed;
+    };
+
+    // Parse the whole token stream; extents, if given, receives every top-level statement's
+    // extent, so together they cover all tokens. Syntax errors do not stop parsing: each one
+    // is recorded in diagnostics() and the parser resynchronizes on the next ';' or 'endif'.
+    std::unique_ptr<Program> parse(std::vector<StatementExtent>* extents = nullptr);
+
+    // Errors found by parse(); empty (and unallocated) for a valid program
+    const std::vector<Diagnostic>& diagnostics() const { return diagnosticList; }
+
+    // True when an error recovery ran into the end of the tokens: parsed as part of a longer
+    // source, the statement might have taken in what follows
+    bool reachedEnd() const { return recoveredToEnd; }
+
+private:
+    // Syntax error raised at a token and caught at the enclosing statement
+    struct ParseError : std::runtime_error {
+        SourceOffset offset;
+        ParseError(const std::string& message, SourceOffset offset) : std::runtime_error(message), offset(offset) {}
+    };
+
+    const TokenStream& tokens;
+    size_t position;
+    Program* sharedProgram;
+    SymbolTable* symbols = nullptr;
+    ExpressionTable* expressions = nullptr;
+    uint32_t printCount = 0;
+    std::vector<Diagnostic> diagnosticList;
+    bool recoveredToEnd = false;
+
+    TokenType currentType() const {
+        return tokens.kind(position);
+    }
+
+    std::string tokenText(size_t index) const {
+        return std::string(tokens.text(index));
+    }
+
+    // Integer value of a number literal; like std::stoi, a fractional part is dropped
+    int numberValue(size_t index) const;
+
+    // Attach its source offset, and those of the occurrences in its expression, to a
+    // freshly built statement
+    template <typename Node>
+    static std::unique_ptr<Node> located(std::unique_ptr<Node> node, SourceOffset offset,
+                                         std::vector<SourceOffset> expressionOffsets = {}) {
+        node->offset = offset;
+        node->expressionOffsets = std::move(expressionOffsets);
+        return node;
+    }
+
+    [[noreturn]] void fail(const std::string& expected) const;
+
+    // Check the current token's type and move past it; returns its index
+    size_t consume(TokenType type);
+
+    // Panic-mode recovery: record the error, then skip to just past the next ';',
+    // or up to the next 'endif' so the enclosing if block can still be closed.
+    // Returns true when it stopped at an 'endif'.
+    bool recover(const ParseError& error);
+
+    StmtPtr parseStatement();
+    StmtPtr parseIfStatement();
+    StmtPtr parseSimpleStatement();
+    StmtPtr parseAssignStatement();
+    StmtPtr parsePrintStatement();
+    StmtPtr parseInputStatement();
+    // An expression's node; the offsets of its occurrences are appended to offsets
+    const Expression* parseExpression(std::vector<SourceOffset>& offsets);
+    const Expression* parsePrimary(std::vector<SourceOffset>& offsets);
+};
+
+// IncrementalCompiler class: Keeps the token stream and the top-level statements between
+// edits of a script. An edit re-lexes only the source between the neighbouring undamaged
+// statements and re-parses only the top-level statements (or whole if blocks) it touches;
+// the rest of Program::statements is kept as is. Syntax errors stay local as well: a
+// statement that does not parse is kept as a unit with no statement, and its diagnostics
+// are replaced only when an edit reaches it. Re-parsed statements intern their expressions
+// in the program's table, which is rebuilt from the live statements once replaced ones have
+// left it twice the size it had after the last rebuild.
+class IncrementalCompiler {
+public:
+    explicit IncrementalCompiler(std::string source) : sourceCode(std::move(source)) {
+        recompile(0, 0, 0, sourceCode.size());
+    }
+
+    const std::string& source() const { return sourceCode; }
+    Program& program() { return programAst; }
+    const TokenStream& tokenStream() const { return tokens; }
+
+    // Errors in the current source, in source order, as compileScript would report them;
+    // program() only runs when there are none
+    const std::vector<Diagnostic>& diagnostics() const { return diagnosticList; }
+
+    // Replace removedLength characters at offset with insertedText; returns the diagnostics
+    // of the edited script
+    const std::vector<Diagnostic>& applyEdit(size_t offset, size_t removedLength, const std::string& insertedText);
+
+private:
+    // The expression table is not rebuilt before it holds twice this many nodes
+    static constexpr size_t minimumTableRebuild = 256;
+
+    // One top-level statement: its source range and token range. A unit that is not parsed
+    // holds tokens a syntax error made the parser skip, and has no statement in the program.
+    struct Unit {
+        size_t begin;
+        size_t end;
+        size_t firstToken;
+        size_t tokenCount;
+        bool parsed;
+    };
+
+    std::string sourceCode;
+    TokenStream tokens;
+    std::vector<Unit> units;
+    Program programAst;
+    std::vector<Diagnostic> diagnosticList;
+    size_t expressionsKept = 0; // Nodes in the expression table when it was last rebuilt
+
+    // Index in Program::statements of the first statement at or after a unit
+    size_t statementIndex(size_t unit) const {
+        size_t index = 0;
+        for (size_t i = 0; i < unit; ++i) {
+            index += units[i].parsed ? 1 : 0;
+        }
+        return index;
+    }
+
+    // Re-lex [regionBegin, regionEnd) and re-parse it in place of units [first, last). While
+    // an error recovery runs into the end of the region, the region grows by one following
+    // statement at a time: in the whole source, the recovery would have skipped into it.
+    void recompile(size_t first, size_t last, size_t regionBegin, size_t regionEnd);
+};
@@ -0,0 +1,127 @@
+/**
+ * @file partial_evaluator.cpp
+ * @brief Partial evaluation into a residual script
+ */
+
+#include "partial_evaluator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+std::string PartialEvaluator::residualSource() {
+    size_t variableCount = compiled.program->symbols.names.size();
+    Environment env;
+    env.states.assign(variableCount, VariableState::UNASSIGNED);
+    env.values.assign(variableCount, 0);
+    std::string source;
+    evaluateStatements(compiled.program->statements, env, source, 0);
+    return source;
+}
+
+PartialEvaluator::Residual PartialEvaluator::evaluate(const Expression* expression, const Environment& env) {
+    if (auto binOp = dynamic_cast<const BinaryOperation*>(expression)) {
+        Residual left = evaluate(binOp->left, env);
+        Residual right = evaluate(binOp->right, env);
+        if (left.isConstant && right.isConstant) {
+            return { true, applyBinaryOp(binOp->op, left.value, right.value), {} };
+        }
+        // Operators associate to the left with no precedence, so only a compound right
+        // operand needs parentheses
+        std::string rightText = text(right);
+        if (!right.isConstant && dynamic_cast<const BinaryOperation*>(binOp->right)) {
+            rightText = "(" + rightText + ")";
+        }
+        return { false, 0, text(left) + " " + binaryOpText(binOp->op) + " " + rightText };
+    }
+    else if (auto ident = dynamic_cast<const Identifier*>(expression)) {
+        if (env.states[ident->slot] == VariableState::KNOWN) {
+            return { true, env.values[ident->slot], {} };
+        }
+        // Unassigned variables are left for the residual script to report at run time
+        return { false, 0, ident->name };
+    }
+    else if (auto num = dynamic_cast<const Number*>(expression)) {
+        return { true, num->value, {} };
+    }
+    else {
+        throw std::runtime_error("Unexpected expression");
+    }
+}
+
+void PartialEvaluator::evaluateStatements(const std::vector<StmtPtr>& statements, Environment& env, std::string& source, int depth) {
+    for (auto& statement : statements) {
+        evaluateStatement(statement.get(), env, source, depth);
+    }
+}
+
+void PartialEvaluator::evaluateStatement(const Statement* statement, Environment& env, std::string& source, int depth) {
+    if (auto assignStmt = dynamic_cast<const AssignStatement*>(statement)) {
+        Residual value = evaluate(assignStmt->expression, env);
+        if (value.isConstant) {
+            env.states[assignStmt->slot] = VariableState::KNOWN;
+            env.values[assignStmt->slot] = value.value;
+        }
+        else {
+            appendLine(source, depth, assignStmt->identifier + " = " + value.text + ";");
+            env.states[assignStmt->slot] = VariableState::DYNAMIC;
+        }
+    }
+    else if (auto printStmt = dynamic_cast<const PrintStatement*>(statement)) {
+        appendLine(source, depth, "print(" + text(evaluate(printStmt->expression, env)) + ");");
+    }
+    else if (auto inputStmt = dynamic_cast<const InputStatement*>(statement)) {
+        if (env.minInputs == env.maxInputs && env.minInputs < fixedInputs.size()) {
+            env.states[inputStmt->slot] = VariableState::KNOWN;
+            env.values[inputStmt->slot] = fixedInputs[env.minInputs];
+        }
+        else if (env.minInputs >= fixedInputs.size()) {
+            appendLine(source, depth, "input(" + inputStmt->identifier + ");");
+            env.states[inputStmt->slot] = VariableState::DYNAMIC;
+        }
+        else {
+            throw std::runtime_error(compiled.lines.describe(compiled.path, inputStmt->offset) +
+                                     ": input(" + inputStmt->identifier +
+                                     ") may or may not read a fixed input value");
+        }
+        ++env.minInputs;
+        ++env.maxInputs;
+    }
+    else if (auto ifStmt = dynamic_cast<const IfStatement*>(statement)) {
+        Residual condition = evaluate(ifStmt->compareExpression, env);
+        if (condition.isConstant) {
+            if (condition.value) {
+                evaluateStatements(ifStmt->thenStatements, env, source, depth);
+            }
+            return;
+        }
+
+        Environment inner = env;
+        std::string body;
+        evaluateStatements(ifStmt->thenStatements, inner, body, depth + 1);
+
+        // Variables the body changed hold their value in the residual script on both paths
+        for (uint32_t slot = 0; slot < env.states.size(); ++slot) {
+            bool changed = inner.states[slot] != env.states[slot] ||
+                           (inner.states[slot] == VariableState::KNOWN && inner.values[slot] != env.values[slot]);
+            if (!changed) {
+                continue;
+            }
+            if (env.states[slot] == VariableState::KNOWN) {
+                appendLine(source, depth, nameOf(slot) + " = " + constantText(env.values[slot]) + ";");
+            }
+            if (inner.states[slot] == VariableState::KNOWN) {
+                appendLine(body, depth + 1, nameOf(slot) + " = " + constantText(inner.values[slot]) + ";");
+            }
+            env.states[slot] = VariableState::DYNAMIC;
+        }
+        env.minInputs = std::min(env.minInputs, inner.minInputs);
+        env.maxInputs = std::max(env.maxInputs, inner.maxInputs);
+
+        appendLine(source, depth, "if (" + condition.text + ") then");
+        source += body;
+        appendLine(source, depth, "endif;");
+    }
+    else {
+        throw std::runtime_error("Unexpected statement");
+    }
+}
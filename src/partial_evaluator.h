@@ -0,0 +1,83 @@
+/**
+ * @file partial_evaluator.h
+ * @brief Specialization of programs on fixed input values
+ */
+
+#pragma once
+
+#include "program.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// PartialEvaluator class: Specializes a program on fixed values for the start of its input.
+// Input statements that are sure to read one of the fixed values are run at compile time,
+// and the resulting constants are propagated and folded through the program. Whatever
+// still depends on the remaining input is written out as a residual script, which reads
+// only the input values after the fixed ones.
+class PartialEvaluator {
+public:
+    PartialEvaluator(const CompiledProgram& compiled, std::vector<int> fixedInputs)
+        : compiled(compiled), fixedInputs(std::move(fixedInputs)) {}
+
+    // The residual script's source; throws std::runtime_error when an input statement may
+    // or may not read a fixed value, depending on the path taken at run time
+    std::string residualSource();
+
+private:
+    enum class VariableState : uint8_t {
+        UNASSIGNED, // Not assigned on any path
+        KNOWN,      // Holds a value known at compile time (not yet stored in the residual)
+        DYNAMIC     // Held, if at all, by the residual script's variable
+    };
+
+    // The variables, and how many input values have been read: at least minInputs and at
+    // most maxInputs, depending on the path taken
+    struct Environment {
+        std::vector<VariableState> states;
+        std::vector<int> values;
+        size_t minInputs = 0;
+        size_t maxInputs = 0;
+    };
+
+    // An expression after partial evaluation: a constant, or residual source text
+    struct Residual {
+        bool isConstant;
+        int value;
+        std::string text;
+    };
+
+    const CompiledProgram& compiled;
+    std::vector<int> fixedInputs;
+
+    const std::string& nameOf(uint32_t slot) const {
+        return compiled.program->symbols.names[slot];
+    }
+
+    // Source text for a constant; the language has no negative literals
+    static std::string constantText(int value) {
+        if (value == std::numeric_limits<int>::min()) {
+            return "(0-2147483647-1)";
+        }
+        if (value < 0) {
+            return "(0-" + std::to_string(-value) + ")";
+        }
+        return std::to_string(value);
+    }
+
+    static std::string text(const Residual& residual) {
+        return residual.isConstant ? constantText(residual.value) : residual.text;
+    }
+
+    static void appendLine(std::string& source, int depth, const std::string& line) {
+        source.append(static_cast<size_t>(depth) * 4, ' ');
+        source += line;
+        source.push_back('\n');
+    }
+
+    Residual evaluate(const Expression* expression, const Environment& env);
+    void evaluateStatements(const std::vector<StmtPtr>& statements, Environment& env, std::string& source, int depth);
+    void evaluateStatement(const Statement* statement, Environment& env, std::string& source, int depth);
+};
@@ -0,0 +1,25 @@
+/**
+ * @file platform.h
+ * @brief Platform detection shared by the compiler's modules
+ */
+
+#pragma once
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GLSL_HAS_MMAP 1
+#endif
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#ifdef _MSC_VER
+#define GLSL_NOINLINE __declspec(noinline)
+#else
+#define GLSL_NOINLINE __attribute__((noinline))
+#endif
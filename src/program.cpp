@@ -0,0 +1,57 @@
+/**
+ * @file program.cpp
+ * @brief Compiling scripts into snapshots
+ */
+
+#include "program.h"
+#include "alloc_stats.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+std::shared_ptr<CompiledProgram> compileScript(const std::string& path, std::string source, CompileStats* stats) {
+    auto compiled = std::make_shared<CompiledProgram>();
+    compiled->path = path;
+    compiled->source = std::move(source);
+    compiled->sourceHash = fnv1a64(compiled->source.data(), compiled->source.size());
+
+    auto phaseStart = alloc_stats::now();
+    Lexer lexer(compiled->source);
+    auto tokens = lexer.tokenize();
+    if (stats) {
+        stats->lex = alloc_stats::since(phaseStart);
+        phaseStart = alloc_stats::now();
+    }
+
+    Parser parser(tokens);
+    compiled->program = parser.parse();
+    if (stats) {
+        stats->parse = alloc_stats::since(phaseStart);
+    }
+
+    // Report every lexical and syntax error at once
+    if (!lexer.diagnostics().empty() || !parser.diagnostics().empty()) {
+        std::vector<Diagnostic> diagnostics = lexer.diagnostics();
+        diagnostics.insert(diagnostics.end(), parser.diagnostics().begin(), parser.diagnostics().end());
+        std::stable_sort(diagnostics.begin(), diagnostics.end(),
+                         [](const Diagnostic& a, const Diagnostic& b) { return a.offset < b.offset; });
+        std::string text = formatDiagnostics(path, compiled->source, diagnostics);
+        text.pop_back();
+        throw std::runtime_error(text);
+    }
+    return compiled;
+}
+
+std::shared_ptr<CompiledProgram> snapshotScript(const std::string& path, IncrementalCompiler& compiler) {
+    auto compiled = std::make_shared<CompiledProgram>();
+    compiled->path = path;
+    compiled->source = compiler.source();
+    compiled->sourceHash = fnv1a64(compiled->source.data(), compiled->source.size());
+    compiled->program = std::make_unique<Program>();
+    compiled->program->symbols = compiler.program().symbols;
+    for (const auto& statement : compiler.program().statements) {
+        compiled->program->statements.push_back(cloneStatement(statement.get(), compiled->program->expressions));
+    }
+    return compiled;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file program.h
+ * @brief Compiled scripts: snapshots of a source and its AST
+ */
+
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// 64-bit FNV-1a hash
+inline uint64_t fnv1a64(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// CompiledProgram structure: An immutable, compiled script. Runs share it through
+// std::shared_ptr, so a run keeps its snapshot alive even after a newer one is published.
+struct CompiledProgram {
+    std::string path;
+    std::string source;
+    std::unique_ptr<Program> program;
+    LineTable lines{ source };
+    uint64_t version = 0;
+    uint64_t sourceHash = 0; // Identifies the program in the ResultCache
+    // Set when loaded from a ProgramBundle: the program then holds only its symbol table
+    std::shared_ptr<const Bytecode> linked;
+};
+
+// Allocation figures for the phases of compileScript (filled in with --alloc-stats)
+struct CompileStats {
+    std::string lex;
+    std::string parse;
+};
+
+// Compile a script into a snapshot; throws std::runtime_error listing every diagnostic
+// when it does not compile
+std::shared_ptr<CompiledProgram> compileScript(const std::string& path, std::string source,
+                                               CompileStats* stats = nullptr);
+
+// Snapshot of an IncrementalCompiler's script, which must have no diagnostics. The program
+// is copied, so later edits leave the snapshot alone.
+std::shared_ptr<CompiledProgram> snapshotScript(const std::string& path, IncrementalCompiler& compiler);
@@ -0,0 +1,195 @@
+/**
+ * @file reactive.cpp
+ * @brief Reactive re-evaluation of a program as its inputs change
+ */
+
+#include "reactive.h"
+#include "engine.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+std::vector<ReactiveEvaluator::PrintChange> ReactiveEvaluator::run() {
+    std::vector<PrintChange> changes;
+    if (!consistent) {
+        // The last run stopped part way and its changes were never reported: start over,
+        // retracting every print reported so far
+        for (uint32_t id = 0; id < reported.size(); ++id) {
+            if (reported[id]) {
+                changes.push_back({ id, false, 0 });
+            }
+        }
+        std::fill(records.begin(), records.end(), Record());
+    }
+    std::fill(assigned.begin(), assigned.end(), 0);
+    std::fill(dirty.begin(), dirty.end(), 0);
+    inputIndex = 0;
+    consistent = false;
+    uint32_t index = 0;
+    walk(compiled.program->statements, index, changes);
+    consistent = true;
+    for (const auto& change : changes) {
+        reported[change.id] = change.present;
+    }
+    return changes;
+}
+
+void ReactiveEvaluator::collectReads(const Expression* expression, std::vector<uint32_t>& reads) {
+    if (auto binOp = dynamic_cast<const BinaryOperation*>(expression)) {
+        collectReads(binOp->left, reads);
+        collectReads(binOp->right, reads);
+    }
+    else if (auto ident = dynamic_cast<const Identifier*>(expression)) {
+        reads.push_back(ident->slot);
+    }
+}
+
+void ReactiveEvaluator::indexStatements(const std::vector<StmtPtr>& statements) {
+    for (auto& statement : statements) {
+        size_t id = infos.size();
+        infos.push_back({ statement.get(), {}, 1 });
+        if (auto assignStmt = dynamic_cast<const AssignStatement*>(statement.get())) {
+            collectReads(assignStmt->expression, infos[id].reads);
+        }
+        else if (auto printStmt = dynamic_cast<const PrintStatement*>(statement.get())) {
+            collectReads(printStmt->expression, infos[id].reads);
+            printCount = std::max(printCount, printStmt->id + 1);
+        }
+        else if (auto ifStmt = dynamic_cast<const IfStatement*>(statement.get())) {
+            collectReads(ifStmt->compareExpression, infos[id].reads);
+            indexStatements(ifStmt->thenStatements);
+            infos[id].subtreeSize = static_cast<uint32_t>(infos.size() - id);
+        }
+    }
+}
+
+int ReactiveEvaluator::evaluate(const Expression* expression, const Statement* statement) {
+    if (auto binOp = dynamic_cast<const BinaryOperation*>(expression)) {
+        int left = evaluate(binOp->left, statement);
+        int right = evaluate(binOp->right, statement);
+        return applyBinaryOp(binOp->op, left, right);
+    }
+    else if (auto ident = dynamic_cast<const Identifier*>(expression)) {
+        if (!assigned[ident->slot]) {
+            throw RuntimeError("Undefined variable '" + ident->name + "'", readOffset(statement, ident->slot));
+        }
+        return variables[ident->slot];
+    }
+    else if (auto num = dynamic_cast<const Number*>(expression)) {
+        return num->value;
+    }
+    else {
+        throw std::runtime_error("Unexpected expression");
+    }
+}
+
+void ReactiveEvaluator::retract(uint32_t first, uint32_t count, std::vector<PrintChange>& changes) {
+    for (uint32_t id = first; id < first + count; ++id) {
+        if (!records[id].executed) {
+            continue;
+        }
+        const Statement* statement = infos[id].statement;
+        if (auto assignStmt = dynamic_cast<const AssignStatement*>(statement)) {
+            dirty[assignStmt->slot] = 1;
+        }
+        else if (auto inputStmt = dynamic_cast<const InputStatement*>(statement)) {
+            dirty[inputStmt->slot] = 1;
+        }
+        else if (auto printStmt = dynamic_cast<const PrintStatement*>(statement)) {
+            changes.push_back({ printStmt->id, false, 0 });
+        }
+        records[id] = Record();
+    }
+}
+
+void ReactiveEvaluator::walk(const std::vector<StmtPtr>& statements, uint32_t& index, std::vector<PrintChange>& changes) {
+    for (auto& statement : statements) {
+        uint32_t id = index++;
+        if (auto assignStmt = dynamic_cast<const AssignStatement*>(statement.get())) {
+            store(id, assignStmt->slot, evaluateOrReuse(id, assignStmt->expression));
+        }
+        else if (auto printStmt = dynamic_cast<const PrintStatement*>(statement.get())) {
+            int value = evaluateOrReuse(id, printStmt->expression);
+            if (!records[id].executed || records[id].value != value) {
+                changes.push_back({ printStmt->id, true, value });
+            }
+            records[id] = { true, value };
+        }
+        else if (auto inputStmt = dynamic_cast<const InputStatement*>(statement.get())) {
+            if (inputIndex >= inputs.size()) {
+                throw RuntimeError("Not enough input values for input(" + inputStmt->identifier + ")", inputStmt->offset);
+            }
+            store(id, inputStmt->slot, inputs[inputIndex++]);
+        }
+        else if (auto ifStmt = dynamic_cast<const IfStatement*>(statement.get())) {
+            bool taken = evaluateOrReuse(id, ifStmt->compareExpression) != 0;
+            bool wasTaken = records[id].executed && records[id].value;
+            records[id] = { true, taken };
+            uint32_t bodySize = infos[id].subtreeSize - 1;
+            if (taken) {
+                walk(ifStmt->thenStatements, index, changes);
+            }
+            else {
+                if (wasTaken) {
+                    retract(index, bodySize, changes);
+                }
+                index += bodySize;
+            }
+        }
+        else {
+            throw std::runtime_error("Unexpected statement");
+        }
+    }
+}
+
+int runReactive(const CompiledProgram& compiled, InputSpan initialInputs, bool stats) {
+    ReactiveEvaluator evaluator(compiled, std::vector<int>(initialInputs.data, initialInputs.data + initialInputs.size));
+    uint64_t updates = 0;
+    auto report = [&]() {
+        try {
+            for (const auto& change : evaluator.run()) {
+                if (change.present) {
+                    std::cout << "print " << change.id << " " << change.value << "\n";
+                }
+                else {
+                    std::cout << "clear " << change.id << "\n";
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            std::cout << "error " << describeError(e, compiled) << "\n";
+        }
+        std::cout << "done" << std::endl;
+    };
+
+    report();
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        std::istringstream fields(line);
+        size_t index;
+        int value;
+        if (!(fields >> index >> value)) {
+            std::cout << "error Expected '<index> <value>' but found '" << line << "'\n" << "done" << std::endl;
+            continue;
+        }
+        try {
+            evaluator.setInput(index, value);
+        }
+        catch (const std::exception& e) {
+            std::cout << "error " << e.what() << "\n" << "done" << std::endl;
+            continue;
+        }
+        ++updates;
+        report();
+    }
+    if (stats) {
+        std::cerr << "updates: " << updates << ", statements evaluated: " << evaluator.statementsEvaluated() << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file reactive.h
+ * @brief Reactive re-evaluation of a program as its inputs change
+ */
+
+#pragma once
+
+#include "ast.h"
+#include "program.h"
+#include "runtime.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ReactiveEvaluator class: Keeps a run of a program so that, when input values change,
+// only the statements they affect are evaluated again. Each statement's reads are known
+// from the tree; a run records what every statement computed, and the next run walks the
+// statements again, evaluating only those that read a variable whose value may differ
+// from the recorded run ("dirty"). If statements whose outcome flips add or retract their
+// whole body. Each run reports the prints whose value changed, appeared or disappeared.
+class ReactiveEvaluator {
+public:
+    struct PrintChange {
+        uint32_t id;
+        bool present; // False when the print no longer runs
+        int value;
+    };
+
+    ReactiveEvaluator(const CompiledProgram& compiled, std::vector<int> inputs)
+        : compiled(compiled), inputs(std::move(inputs)),
+          variables(compiled.program->symbols.names.size()),
+          assigned(compiled.program->symbols.names.size()),
+          dirty(compiled.program->symbols.names.size()) {
+        indexStatements(compiled.program->statements);
+        records.resize(infos.size());
+        reported.resize(printCount);
+    }
+
+    // Change (or, one past the end, append) an input value
+    void setInput(size_t index, int value) {
+        if (index > inputs.size()) {
+            throw std::runtime_error("Input index " + std::to_string(index) + " is past the end of the input");
+        }
+        if (index == inputs.size()) {
+            inputs.push_back(value);
+        }
+        else {
+            inputs[index] = value;
+        }
+    }
+
+    // Bring the run up to date with the inputs; throws RuntimeError like a normal run
+    std::vector<PrintChange> run();
+
+    // Statements evaluated over all runs (the rest reused their recorded result)
+    uint64_t statementsEvaluated() const { return evaluatedCount; }
+
+private:
+    struct StatementInfo {
+        const Statement* statement;
+        std::vector<uint32_t> reads; // Slots read by the statement's own expression
+        uint32_t subtreeSize;        // Statements in its subtree, itself included
+    };
+
+    // What a statement did in the recorded run
+    struct Record {
+        bool executed = false;
+        int value = 0; // Assigned, read or printed value, or whether an if's body ran
+    };
+
+    const CompiledProgram& compiled;
+    std::vector<int> inputs;
+    std::vector<StatementInfo> infos; // In preorder
+    std::vector<Record> records;
+    std::vector<uint8_t> reported; // By print id: present as of the last changes returned
+    uint32_t printCount = 0;
+    std::vector<int> variables;
+    std::vector<uint8_t> assigned;
+    std::vector<uint8_t> dirty; // Value (or assignedness) may differ from the recorded run at this point
+    size_t inputIndex = 0;
+    bool consistent = true;
+    uint64_t evaluatedCount = 0;
+
+    static void collectReads(const Expression* expression, std::vector<uint32_t>& reads);
+    void indexStatements(const std::vector<StmtPtr>& statements);
+
+    bool readsDirty(uint32_t id) const {
+        for (uint32_t slot : infos[id].reads) {
+            if (dirty[slot]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Evaluate the expression of a statement, which holds the source offsets of its occurrences
+    int evaluate(const Expression* expression, const Statement* statement);
+
+    // Evaluate a statement's expression unless its recorded value still holds
+    int evaluateOrReuse(uint32_t id, const Expression* expression) {
+        if (records[id].executed && !readsDirty(id)) {
+            return records[id].value;
+        }
+        ++evaluatedCount;
+        return evaluate(expression, infos[id].statement);
+    }
+
+    // A variable got a value: it is dirty from here on if that differs from the recorded run
+    void store(uint32_t id, uint32_t slot, int value) {
+        dirty[slot] = !records[id].executed || records[id].value != value;
+        variables[slot] = value;
+        assigned[slot] = 1;
+        records[id] = { true, value };
+    }
+
+    // An if body that ran in the recorded run does not run now: what it assigned may
+    // differ and what it printed is gone
+    void retract(uint32_t first, uint32_t count, std::vector<PrintChange>& changes);
+
+    void walk(const std::vector<StmtPtr>& statements, uint32_t& index, std::vector<PrintChange>& changes);
+};
+
+// Reactive mode: run the program once, then apply input changes read from stdin, one
+// "<index> <value>" per line, re-evaluating only what they affect. Prints are reported as
+// "print <id> <value>" when they change and "clear <id>" when they no longer run; every
+// batch of changes ends with "done" (or "error <message>" then "done").
+int runReactive(const CompiledProgram& compiled, InputSpan initialInputs, bool stats);
@@ -0,0 +1,262 @@
+/**
+ * @file register_allocator.cpp
+ * @brief Liveness and linear-scan register allocation over bytecode registers
+ */
+
+#include "bytecode.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <utility>
+
+void instructionRegisters(const Instruction& in, int32_t& def, int32_t& use1, int32_t& use2) {
+    def = use1 = use2 = -1;
+    switch (in.op) {
+    case OpCode::LOAD_CONST:
+    case OpCode::INPUT:
+    case OpCode::INPUT_EXPECT: def = in.a; break;
+    case OpCode::MOVE:
+    case OpCode::ADD_CONST:
+    case OpCode::SUBTRACT_CONST:
+    case OpCode::CONST_SUBTRACT:
+    case OpCode::MULTIPLY_CONST:
+    case OpCode::SHIFT_LEFT_CONST: def = in.a; use1 = in.b; break;
+    case OpCode::JUMP_IF_FALSE:
+    case OpCode::JUMP_IF_TRUE: use1 = in.b; break;
+    case OpCode::JUMP_IF_GREATER:
+    case OpCode::JUMP_IF_LESS:
+    case OpCode::JUMP_IF_EQUAL:
+    case OpCode::JUMP_IF_NOT_EQUAL:
+    case OpCode::JUMP_IF_GREATER_EQUAL:
+    case OpCode::JUMP_IF_LESS_EQUAL: use1 = in.b; use2 = in.c; break;
+    case OpCode::PRINT: use1 = in.a; break;
+    case OpCode::JUMP:
+    case OpCode::CHECK_ASSIGNED:
+    case OpCode::MARK_ASSIGNED:
+    case OpCode::CHARGE:
+    case OpCode::HALT: break;
+    default: def = in.a; use1 = in.b; use2 = in.c; break; // Binary operators
+    }
+}
+
+Liveness::Liveness(const Bytecode& bytecode, uint32_t firstRegister) : bytecode(bytecode), first(firstRegister) {
+    const size_t count = bytecode.code.size();
+    const size_t tracked = bytecode.registerCount > first ? bytecode.registerCount - first : 0;
+
+    // Basic blocks
+    std::vector<uint8_t> leader(count + 1, 0);
+    leader[0] = 1;
+    for (size_t pc = 0; pc < count; ++pc) {
+        OpCode op = bytecode.code[pc].op;
+        if (op == OpCode::JUMP || isConditionalJump(op)) {
+            leader[static_cast<size_t>(bytecode.code[pc].a)] = 1;
+            leader[pc + 1] = 1;
+        }
+        else if (op == OpCode::HALT) {
+            leader[pc + 1] = 1;
+        }
+    }
+    blockIndex.assign(count, 0);
+    for (size_t pc = 0; pc < count; ++pc) {
+        if (leader[pc]) {
+            blockList.push_back({ pc, pc, {} });
+        }
+        blockList.back().to = pc;
+        blockIndex[pc] = blockList.size() - 1;
+    }
+    for (auto& block : blockList) {
+        const Instruction& last = bytecode.code[block.to];
+        if (last.op == OpCode::JUMP || isConditionalJump(last.op)) {
+            block.successors.push_back(blockIndex[static_cast<size_t>(last.a)]);
+        }
+        if (last.op != OpCode::JUMP && last.op != OpCode::HALT && block.to + 1 < count) {
+            block.successors.push_back(blockIndex[block.to + 1]);
+        }
+    }
+
+    // Registers read before being written (gen) and written (kill) in each block, as bitsets
+    const size_t words = (tracked + 63) / 64;
+    auto tracks = [&](int32_t reg) { return reg >= static_cast<int32_t>(first); };
+    auto setBit = [&](std::vector<uint64_t>& set, int32_t reg) {
+        size_t index = static_cast<size_t>(reg) - first;
+        set[index / 64] |= uint64_t(1) << (index % 64);
+    };
+    std::vector<std::vector<uint64_t>> gen(blockList.size(), std::vector<uint64_t>(words));
+    std::vector<std::vector<uint64_t>> kill(blockList.size(), std::vector<uint64_t>(words));
+    for (size_t b = 0; b < blockList.size(); ++b) {
+        for (size_t pc = blockList[b].from; pc <= blockList[b].to; ++pc) {
+            int32_t def, use1, use2;
+            instructionRegisters(bytecode.code[pc], def, use1, use2);
+            for (int32_t use : { use1, use2 }) {
+                if (tracks(use) && !bit(kill[b], use)) {
+                    setBit(gen[b], use);
+                }
+            }
+            if (tracks(def)) {
+                setBit(kill[b], def);
+            }
+        }
+    }
+    in.assign(blockList.size(), std::vector<uint64_t>(words));
+    out.assign(blockList.size(), std::vector<uint64_t>(words));
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t b = blockList.size(); b-- > 0;) {
+            for (size_t w = 0; w < words; ++w) {
+                uint64_t blockOut = 0;
+                for (size_t successor : blockList[b].successors) {
+                    blockOut |= in[successor][w];
+                }
+                uint64_t blockIn = gen[b][w] | (blockOut & ~kill[b][w]);
+                if (blockOut != out[b][w] || blockIn != in[b][w]) {
+                    out[b][w] = blockOut;
+                    in[b][w] = blockIn;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+bool Liveness::liveAfter(size_t pc, int32_t reg) const {
+    const Block& block = blockList[blockIndex[pc]];
+    for (size_t next = pc + 1; next <= block.to; ++next) {
+        int32_t def, use1, use2;
+        instructionRegisters(bytecode.code[next], def, use1, use2);
+        if (use1 == reg || use2 == reg) {
+            return true;
+        }
+        if (def == reg) {
+            return false;
+        }
+    }
+    return bit(out[blockIndex[pc]], reg);
+}
+
+RegisterAssignment allocateRegisters(const Bytecode& bytecode, uint32_t available, uint32_t firstRegister) {
+    RegisterAssignment assignment;
+    assignment.machine.assign(bytecode.registerCount, -1);
+    assignment.spillSlot.assign(bytecode.registerCount, -1);
+    const size_t count = bytecode.code.size();
+    if (bytecode.registerCount <= firstRegister || count == 0) {
+        return assignment;
+    }
+    Liveness liveness(bytecode, firstRegister);
+
+    // One interval per register, covering every position where it is live
+    constexpr size_t none = std::numeric_limits<size_t>::max();
+    std::vector<size_t> start(bytecode.registerCount, none);
+    std::vector<size_t> end(bytecode.registerCount, 0);
+    auto cover = [&](int32_t reg, size_t position) {
+        if (reg >= static_cast<int32_t>(firstRegister)) {
+            start[static_cast<size_t>(reg)] = std::min(start[static_cast<size_t>(reg)], position);
+            end[static_cast<size_t>(reg)] = std::max(end[static_cast<size_t>(reg)], position);
+        }
+    };
+    const auto& blocks = liveness.blocks();
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        for (uint32_t reg = firstRegister; reg < bytecode.registerCount; ++reg) {
+            if (liveness.liveIn(b, static_cast<int32_t>(reg))) {
+                cover(static_cast<int32_t>(reg), 2 * blocks[b].from);
+            }
+            if (liveness.liveOut(b, static_cast<int32_t>(reg))) {
+                cover(static_cast<int32_t>(reg), 2 * blocks[b].to + 1);
+            }
+        }
+        for (size_t pc = blocks[b].from; pc <= blocks[b].to; ++pc) {
+            int32_t def, use1, use2;
+            instructionRegisters(bytecode.code[pc], def, use1, use2);
+            for (int32_t use : { use1, use2 }) {
+                cover(use, 2 * pc);
+            }
+            cover(def, 2 * pc + 1);
+        }
+    }
+    std::vector<size_t> order;
+    for (uint32_t reg = firstRegister; reg < bytecode.registerCount; ++reg) {
+        if (start[reg] != none) {
+            order.push_back(reg);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) { return start[x] < start[y]; });
+
+    // Assign machine registers in order of interval start; when all are taken, whichever of
+    // the new interval and the active one ending last ends later is spilled
+    std::set<std::pair<size_t, size_t>> active; // (end, register)
+    std::set<int32_t> freeRegisters;
+    int32_t used = 0;
+    std::vector<size_t> spilled;
+    for (size_t reg : order) {
+        while (!active.empty() && active.begin()->first < start[reg]) {
+            freeRegisters.insert(assignment.machine[active.begin()->second]);
+            active.erase(active.begin());
+        }
+        if (freeRegisters.empty() && static_cast<uint32_t>(used) < available) {
+            freeRegisters.insert(used++);
+        }
+        if (!freeRegisters.empty()) {
+            assignment.machine[reg] = *freeRegisters.begin();
+            freeRegisters.erase(freeRegisters.begin());
+            active.insert({ end[reg], reg });
+            continue;
+        }
+        if (!active.empty() && std::prev(active.end())->first > end[reg]) {
+            size_t victim = std::prev(active.end())->second;
+            active.erase(std::prev(active.end()));
+            assignment.machine[reg] = assignment.machine[victim];
+            assignment.machine[victim] = -1;
+            active.insert({ end[reg], reg });
+            spilled.push_back(victim);
+        }
+        else {
+            spilled.push_back(reg);
+        }
+    }
+    assignment.machineRegisters = static_cast<uint32_t>(used);
+
+    // Spill slots, by the same scan over the spilled intervals (only once they are all known:
+    // a victim's interval began before the one that displaced it)
+    std::sort(spilled.begin(), spilled.end(), [&](size_t x, size_t y) { return start[x] < start[y]; });
+    active.clear();
+    std::set<int32_t> freeSlots;
+    for (size_t reg : spilled) {
+        while (!active.empty() && active.begin()->first < start[reg]) {
+            freeSlots.insert(assignment.spillSlot[active.begin()->second]);
+            active.erase(active.begin());
+        }
+        if (freeSlots.empty()) {
+            freeSlots.insert(static_cast<int32_t>(assignment.spillSlots++));
+        }
+        assignment.spillSlot[reg] = *freeSlots.begin();
+        freeSlots.erase(freeSlots.begin());
+        active.insert({ end[reg], reg });
+    }
+    assignment.spilled = static_cast<uint32_t>(spilled.size());
+    return assignment;
+}
+
+void compactRegisters(Bytecode& bytecode) {
+    const uint32_t variables = bytecode.variableCount;
+    RegisterAssignment assignment = allocateRegisters(bytecode, std::numeric_limits<uint32_t>::max(), variables);
+    auto rewrite = [&](int32_t& reg) {
+        if (reg >= static_cast<int32_t>(variables)) {
+            reg = static_cast<int32_t>(variables) + assignment.machine[static_cast<size_t>(reg)];
+        }
+    };
+    for (auto& in : bytecode.code) {
+        int32_t def, use1, use2;
+        instructionRegisters(in, def, use1, use2);
+        if (def >= 0) {
+            rewrite(in.a);
+        }
+        if (use1 >= 0) {
+            rewrite(in.op == OpCode::PRINT ? in.a : in.b);
+        }
+        if (use2 >= 0) {
+            rewrite(in.c);
+        }
+    }
+    bytecode.registerCount = variables + assignment.machineRegisters;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file result_cache.cpp
+ * @brief CLOCK-evicted output cache
+ */
+
+#include "result_cache.h"
+
+#include <algorithm>
+#include <utility>
+
+size_t ResultCache::entryOverhead() {
+    // An index node holds a next pointer and the (key, position) pair, and the index keeps
+    // about one bucket pointer per entry
+    return sizeof(Entry) + sizeof(void*) + sizeof(std::pair<const uint64_t, size_t>) + sizeof(void*) + sizeof(size_t);
+}
+
+bool ResultCache::lookup(uint64_t programHash, InputSpan inputs, std::string& output) {
+    auto found = index.find(keyOf(programHash, inputs));
+    if (found != index.end()) {
+        Entry& entry = entries[found->second];
+        if (entry.programHash == programHash && entry.inputs.size() == inputs.size &&
+            std::equal(entry.inputs.begin(), entry.inputs.end(), inputs.data)) {
+            entry.referenced = true;
+            output += entry.output;
+            ++counters.hits;
+            return true;
+        }
+    }
+    ++counters.misses;
+    return false;
+}
+
+void ResultCache::insert(uint64_t programHash, InputSpan inputs, const std::string& output) {
+    size_t cost = entryOverhead() + inputs.size * sizeof(int) + output.size();
+    if (cost > capacity) {
+        return;
+    }
+    uint64_t key = keyOf(programHash, inputs);
+    auto found = index.find(key);
+    if (found != index.end()) {
+        evict(found->second);
+    }
+    while (counters.bytes + cost > capacity) {
+        evictOne();
+    }
+
+    size_t position;
+    if (!freeSlots.empty()) {
+        position = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        position = entries.size();
+        entries.emplace_back();
+    }
+    Entry& entry = entries[position];
+    entry.programHash = programHash;
+    entry.key = key;
+    entry.inputs.assign(inputs.data, inputs.data + inputs.size);
+    entry.output = output;
+    entry.cost = cost;
+    entry.used = true;
+    entry.referenced = false;
+    index[key] = position;
+    counters.bytes += cost;
+    ++counters.entries;
+    ++counters.insertions;
+}
+
+void ResultCache::evict(size_t position) {
+    Entry& entry = entries[position];
+    index.erase(entry.key);
+    counters.bytes -= entry.cost;
+    --counters.entries;
+    ++counters.evictions;
+    entry = Entry();
+    freeSlots.push_back(position);
+}
+
+void ResultCache::evictOne() {
+    for (;;) {
+        hand = hand < entries.size() ? hand : 0;
+        Entry& entry = entries[hand++];
+        if (!entry.used) {
+            continue;
+        }
+        if (entry.referenced) {
+            entry.referenced = false;
+            continue;
+        }
+        evict(hand - 1);
+        return;
+    }
+}
@@ -0,0 +1,75 @@
+/**
+ * @file result_cache.h
+ * @brief Memoized run outputs (--result-cache=)
+ */
+
+#pragma once
+
+#include "program.h"
+#include "runtime.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ResultCache class: Remembers the output of runs by (program, input values), so a repeated
+// input vector is answered without running the program. Runs are pure functions of their
+// input, so a recorded output stays valid for as long as its program does. Memory use is
+// bounded by a byte budget, which counts each entry's bookkeeping as well as its data, and
+// entries are evicted in CLOCK order: a hit sets an entry's reference bit, and the sweeping
+// hand gives referenced entries a second chance.
+class ResultCache {
+public:
+    struct Metrics {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+        size_t bytes = 0;
+        size_t entries = 0;
+    };
+
+    explicit ResultCache(size_t capacityBytes) : capacity(capacityBytes) {}
+
+    // What an entry costs against the budget besides its input values and output: the Entry
+    // in the clock ring, its node and bucket in the index, and its place on freeSlots
+    static size_t entryOverhead();
+
+    // Copy the recorded output of a run into output; false when there is none
+    bool lookup(uint64_t programHash, InputSpan inputs, std::string& output);
+
+    // Record the output of a run, evicting older entries to stay within the budget
+    void insert(uint64_t programHash, InputSpan inputs, const std::string& output);
+
+    const Metrics& metrics() const { return counters; }
+
+private:
+    struct Entry {
+        uint64_t programHash = 0;
+        uint64_t key = 0;
+        std::vector<int> inputs;
+        std::string output;
+        size_t cost = 0;
+        bool used = false;
+        bool referenced = false;
+    };
+
+    size_t capacity;
+    std::vector<Entry> entries; // The clock ring; unused slots are on freeSlots
+    std::vector<size_t> freeSlots;
+    std::unordered_map<uint64_t, size_t> index;
+    size_t hand = 0;
+    Metrics counters;
+
+    static uint64_t keyOf(uint64_t programHash, InputSpan inputs) {
+        return fnv1a64(inputs.data, inputs.size * sizeof(int), programHash);
+    }
+
+    void evict(size_t position);
+
+    // Advance the clock hand to the first entry that has not been referenced since the
+    // last sweep and evict it
+    void evictOne();
+};
@@ -0,0 +1,30 @@
+/**
+ * @file runtime.cpp
+ * @brief Run limit checks
+ */
+
+#include "runtime.h"
+
+#include <vector>
+
+bool needsBlockCharges(const Program& program) {
+    constexpr uint64_t maxPrintBytes = 12; // "-2147483648\n"; the binary formats use less
+    uint64_t statements = 0;
+    uint64_t prints = 0;
+    std::vector<const std::vector<StmtPtr>*> pending = { &program.statements };
+    while (!pending.empty()) {
+        const auto* list = pending.back();
+        pending.pop_back();
+        statements += list->size();
+        for (const auto& stmt : *list) {
+            if (dynamic_cast<const PrintStatement*>(stmt.get())) {
+                ++prints;
+            }
+            else if (auto ifStmt = dynamic_cast<const IfStatement*>(stmt.get())) {
+                pending.push_back(&ifStmt->thenStatements);
+            }
+        }
+    }
+    return (runLimits.fuel != 0 && statements > runLimits.fuel) ||
+           (runLimits.outputBytes != 0 && prints * maxPrintBytes > runLimits.outputBytes);
+}
@@ -0,0 +1,157 @@
+/**
+ * @file runtime.h
+ * @brief What every engine shares at run time: inputs, errors, run limits and output formats
+ */
+
+#pragma once
+
+#include "ast.h"
+#include "lexer.h"
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+class InputSource;
+
+// Input values consumed by InputStatement: a non-owning view, so binary input can be read in
+// place. Streamed input also has a source, asked for the next values once a run has used up
+// the view (so runs over complete input never pay for it).
+struct InputSpan {
+    const int* data = nullptr;
+    size_t size = 0;
+    InputSource* source = nullptr;
+};
+
+// InputSource class: Supplies input values while a run is in progress
+class InputSource {
+public:
+    virtual ~InputSource() = default;
+
+    // Replace the view with the next values (at least one); false at the end of the input
+    virtual bool next(InputSpan& span) = 0;
+};
+
+// Called by a run that has read every value in its view: true when the source supplied
+// more, which are then read from index 0
+inline bool nextInputs(InputSpan& inputs, size_t& index) {
+    if (!inputs.source || !inputs.source->next(inputs)) {
+        return false;
+    }
+    index = 0;
+    return true;
+}
+
+// RuntimeError structure: An execution error and the source offset of the node that raised it
+struct RuntimeError : std::runtime_error {
+    SourceOffset offset;
+    RuntimeError(const std::string& message, SourceOffset offset) : std::runtime_error(message), offset(offset) {}
+};
+
+// LimitError structure: A run stopped by one of the runLimits below
+struct LimitError : RuntimeError {
+    using RuntimeError::RuntimeError;
+};
+
+// Per-run limits for untrusted scripts (--max-fuel, --max-output, --max-state); zero means
+// unlimited. Fuel is counted in statements but charged a whole statement list (a block) at
+// a time, when the block is entered; the output size is checked at the same points and at
+// the end of the run, so a run may overshoot the output limit by one block's prints. Every
+// engine charges at the same points and fails the same run with the same error.
+struct RunLimits {
+    uint64_t fuel = 0;
+    size_t outputBytes = 0;
+    size_t stateBytes = 0; // Input values and variable slots of one run (not the heap it uses)
+
+    bool chargesBlocks() const { return fuel != 0 || outputBytes != 0; }
+};
+
+inline RunLimits runLimits;
+
+// RunBudget structure: What one run has left under runLimits. charge() is the cheap check
+// made at every block; fail() raises the error for whichever limit was exceeded.
+struct RunBudget {
+    int64_t fuelLeft;
+    size_t outputLimit; // Output size (of the whole buffer) the run may reach
+    SourceOffset lastBlock = 0; // Offset of the block charged last (where output overshoots are reported)
+
+    explicit RunBudget(size_t outputStart)
+        : fuelLeft(runLimits.fuel != 0 ? static_cast<int64_t>(runLimits.fuel) : std::numeric_limits<int64_t>::max()),
+          outputLimit(runLimits.outputBytes != 0 ? outputStart + runLimits.outputBytes : std::numeric_limits<size_t>::max()) {}
+
+    bool charge(uint64_t statements, size_t outputSize, SourceOffset offset) {
+        fuelLeft -= static_cast<int64_t>(statements);
+        lastBlock = offset;
+        return fuelLeft >= 0 && outputSize <= outputLimit;
+    }
+
+    // Fail a run at its end if its output is over the limit
+    void checkOutput(size_t outputSize) const {
+        if (outputSize > outputLimit) {
+            fail(lastBlock);
+        }
+    }
+
+    [[noreturn]] void fail(SourceOffset offset) const {
+        if (fuelLeft < 0) {
+            throw LimitError("Fuel limit of " + std::to_string(runLimits.fuel) + " statements exceeded", offset);
+        }
+        throw LimitError("Output limit of " + std::to_string(runLimits.outputBytes) + " bytes exceeded", offset);
+    }
+};
+
+// Whether runs of a program need their blocks charged at all. Without loops a run executes
+// every statement at most once, so a program whose statements and prints all fit within the
+// limits can never exceed them, and its runs skip the charges (and their cost) entirely.
+bool needsBlockCharges(const Program& program);
+
+// Output formats for PrintStatement values:
+//   TEXT   - decimal text, one value per line
+//   RAW    - little-endian int32 values back to back
+//   FRAMED - a header ("GLOF", version, 3 reserved bytes) then 8-byte records of
+//            little-endian u32 print statement id and i32 value; every run ends
+//            with an end-of-run record whose id is endOfRunId
+enum class OutputFormat { TEXT, RAW, FRAMED };
+
+namespace framed_output {
+    constexpr char header[8] = { 'G', 'L', 'O', 'F', 1, 0, 0, 0 };
+    constexpr uint32_t endOfRunId = 0xFFFFFFFF;
+}
+
+inline void appendInt32(std::string& output, uint32_t value) {
+    char bytes[4] = {
+        static_cast<char>(value & 0xFF), static_cast<char>((value >> 8) & 0xFF),
+        static_cast<char>((value >> 16) & 0xFF), static_cast<char>((value >> 24) & 0xFF)
+    };
+    output.append(bytes, sizeof(bytes));
+}
+
+// Append one printed value in the given output format
+inline void appendPrintedValue(std::string& output, OutputFormat format, uint32_t printId, int value) {
+    switch (format) {
+    case OutputFormat::TEXT: {
+        char digits[16];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        output.append(digits, result.ptr);
+        output.push_back('\n');
+        break;
+    }
+    case OutputFormat::FRAMED:
+        appendInt32(output, printId);
+        [[fallthrough]];
+    case OutputFormat::RAW:
+        appendInt32(output, static_cast<uint32_t>(value));
+        break;
+    }
+}
+
+// Append whatever marks the end of a run in the given output format
+inline void appendEndOfRun(std::string& output, OutputFormat format) {
+    if (format == OutputFormat::FRAMED) {
+        appendInt32(output, framed_output::endOfRunId);
+        appendInt32(output, 0);
+    }
+}
@@ -0,0 +1,139 @@
+/**
+ * @file wasm.cpp
+ * @brief Translation of programs to WebAssembly
+ */
+
+#include "wasm.h"
+
+#include <utility>
+
+namespace wasm {
+    std::string ModuleEmitter::emit() {
+        std::string module("\0asm\1\0\0\0", 8);
+
+        // Types: (i32 i32) -> i32, (i32 i32) -> (), () -> ()
+        std::string types;
+        appendUnsigned(types, 3);
+        types += std::string{ static_cast<char>(FUNC), 2, static_cast<char>(I32), static_cast<char>(I32),
+                              1, static_cast<char>(I32) };
+        types += std::string{ static_cast<char>(FUNC), 2, static_cast<char>(I32), static_cast<char>(I32), 0 };
+        types += std::string{ static_cast<char>(FUNC), 0, 0 };
+        appendSection(module, 1, types);
+
+        std::string imports;
+        appendUnsigned(imports, 3);
+        const std::pair<const char*, uint8_t> imported[] = { { "input", 0 }, { "print", 1 }, { "undefined", 1 } };
+        for (const auto& [name, type] : imported) {
+            appendName(imports, "env");
+            appendName(imports, name);
+            imports.push_back(0); // Function import
+            appendUnsigned(imports, type);
+        }
+        appendSection(module, 2, imports);
+
+        appendSection(module, 3, std::string{ 1, 2 }); // One function, of type () -> ()
+
+        std::string exports;
+        appendUnsigned(exports, 1);
+        appendName(exports, "run");
+        exports.push_back(0);
+        appendUnsigned(exports, RUN_FUNCTION);
+        appendSection(module, 7, exports);
+
+        // Code: locals 0..n-1 hold the variables, n..2n-1 their assigned flags
+        std::string body;
+        if (variableCount > 0) {
+            appendUnsigned(body, 1);
+            appendUnsigned(body, uint64_t(variableCount) * 2);
+            body.push_back(static_cast<char>(I32));
+        }
+        else {
+            appendUnsigned(body, 0);
+        }
+        code.swap(body);
+        emitStatements(program.statements);
+        code.push_back(static_cast<char>(END));
+        std::string codeSection;
+        appendUnsigned(codeSection, 1);
+        appendUnsigned(codeSection, code.size());
+        codeSection += code;
+        appendSection(module, 10, codeSection);
+
+        std::string names;
+        appendName(names, "variables");
+        appendUnsigned(names, variableCount);
+        for (const auto& name : program.symbols.names) {
+            appendName(names, name);
+        }
+        appendSection(module, 0, names);
+        return module;
+    }
+
+    void ModuleEmitter::markAssigned(uint32_t slot) {
+        if (!definite[slot]) {
+            constant(1);
+            op(LOCAL_SET, variableCount + slot);
+        }
+    }
+
+    void ModuleEmitter::emitStatements(const std::vector<StmtPtr>& statements) {
+        for (const auto& stmt : statements) {
+            if (auto assignStmt = dynamic_cast<const AssignStatement*>(stmt.get())) {
+                emitExpression(assignStmt->expression, stmt.get());
+                op(LOCAL_SET, assignStmt->slot);
+                markAssigned(assignStmt->slot);
+                definite[assignStmt->slot] = true;
+            }
+            else if (auto printStmt = dynamic_cast<const PrintStatement*>(stmt.get())) {
+                constant(static_cast<int32_t>(printStmt->id));
+                emitExpression(printStmt->expression, stmt.get());
+                op(CALL, PRINT_FUNCTION);
+            }
+            else if (auto inputStmt = dynamic_cast<const InputStatement*>(stmt.get())) {
+                constant(static_cast<int32_t>(inputStmt->slot));
+                constant(static_cast<int32_t>(inputStmt->offset));
+                op(CALL, INPUT_FUNCTION);
+                op(LOCAL_SET, inputStmt->slot);
+                markAssigned(inputStmt->slot);
+                definite[inputStmt->slot] = true;
+            }
+            else if (auto ifStmt = dynamic_cast<const IfStatement*>(stmt.get())) {
+                emitExpression(ifStmt->compareExpression, stmt.get());
+                op(IF);
+                code.push_back(static_cast<char>(EMPTY_BLOCK));
+                std::vector<bool> before = definite;
+                emitStatements(ifStmt->thenStatements);
+                definite = std::move(before);
+                op(END);
+            }
+        }
+    }
+
+    void ModuleEmitter::emitExpression(const Expression* expr, const Statement* statement) {
+        if (auto number = dynamic_cast<const Number*>(expr)) {
+            constant(number->value);
+        }
+        else if (auto ident = dynamic_cast<const Identifier*>(expr)) {
+            if (!definite[ident->slot]) {
+                op(LOCAL_GET, variableCount + ident->slot);
+                op(I32_EQZ);
+                op(IF);
+                code.push_back(static_cast<char>(EMPTY_BLOCK));
+                constant(static_cast<int32_t>(ident->slot));
+                constant(static_cast<int32_t>(readOffset(statement, ident->slot)));
+                op(CALL, UNDEFINED_FUNCTION);
+                op(UNREACHABLE);
+                op(END);
+            }
+            op(LOCAL_GET, ident->slot);
+        }
+        else if (auto binOp = dynamic_cast<const BinaryOperation*>(expr)) {
+            emitExpression(binOp->left, statement);
+            emitExpression(binOp->right, statement);
+            static const Opcode opcodes[] = {
+                I32_ADD, I32_SUB, I32_MUL, I32_GT_S, I32_LT_S, I32_EQ, I32_NE, I32_GE_S, I32_LE_S
+            };
+            op(opcodes[static_cast<size_t>(binOp->op)]);
+        }
+    }
+}
@@ -0,0 +1,96 @@
+/**
+ * @file wasm.h
+ * @brief WebAssembly module emission
+ */
+
+#pragma once
+
+#include "ast.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// WebAssembly module emitter. Translates a Program into a module that a WebAssembly
+// runtime can run sandboxed: the module has no memory, variables and their assigned flags
+// are function locals, and if statements become structured if blocks. It imports
+//     env.input(slot, offset) -> value   the next input value; the host traps when none is left
+//     env.print(id, value)
+//     env.undefined(slot, offset)        a variable was read before assignment; the host traps
+// and exports run(). A custom section "variables" lists the variable names by slot, for
+// the host's error messages.
+namespace wasm {
+    enum Opcode : uint8_t {
+        UNREACHABLE = 0x00, IF = 0x04, END = 0x0B, CALL = 0x10,
+        LOCAL_GET = 0x20, LOCAL_SET = 0x21, I32_CONST = 0x41, I32_EQZ = 0x45,
+        I32_EQ = 0x46, I32_NE = 0x47, I32_LT_S = 0x48, I32_GT_S = 0x4A, I32_LE_S = 0x4C, I32_GE_S = 0x4E,
+        I32_ADD = 0x6A, I32_SUB = 0x6B, I32_MUL = 0x6C
+    };
+    constexpr uint8_t I32 = 0x7F, FUNC = 0x60, EMPTY_BLOCK = 0x40;
+    constexpr uint32_t INPUT_FUNCTION = 0, PRINT_FUNCTION = 1, UNDEFINED_FUNCTION = 2, RUN_FUNCTION = 3;
+
+    inline void appendUnsigned(std::string& out, uint64_t value) {
+        do {
+            uint8_t byte = value & 0x7F;
+            value >>= 7;
+            out.push_back(static_cast<char>(value ? byte | 0x80 : byte));
+        } while (value);
+    }
+
+    inline void appendSigned(std::string& out, int64_t value) {
+        for (;;) {
+            uint8_t byte = value & 0x7F;
+            value >>= 7;
+            bool done = (value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40));
+            out.push_back(static_cast<char>(done ? byte : byte | 0x80));
+            if (done) {
+                return;
+            }
+        }
+    }
+
+    inline void appendName(std::string& out, const std::string& name) {
+        appendUnsigned(out, name.size());
+        out += name;
+    }
+
+    inline void appendSection(std::string& out, uint8_t id, const std::string& content) {
+        out.push_back(static_cast<char>(id));
+        appendUnsigned(out, content.size());
+        out += content;
+    }
+
+    // ModuleEmitter class: Emits the binary module for one Program. Reads of variables that
+    // are definitely assigned on every path skip the assigned check.
+    class ModuleEmitter {
+    public:
+        explicit ModuleEmitter(const Program& program)
+            : program(program), variableCount(static_cast<uint32_t>(program.symbols.names.size())),
+              definite(variableCount) {}
+
+        std::string emit();
+
+    private:
+        const Program& program;
+        uint32_t variableCount;
+        std::vector<bool> definite; // Per slot: assigned on every path to the current point
+        std::string code;
+
+        void op(Opcode opcode) { code.push_back(static_cast<char>(opcode)); }
+
+        void op(Opcode opcode, uint32_t immediate) {
+            op(opcode);
+            appendUnsigned(code, immediate);
+        }
+
+        void constant(int32_t value) {
+            op(I32_CONST);
+            appendSigned(code, value);
+        }
+
+        void markAssigned(uint32_t slot);
+        void emitStatements(const std::vector<StmtPtr>& statements);
+        void emitExpression(const Expression* expr, const Statement* statement);
+    };
+}
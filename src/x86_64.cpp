@@ -0,0 +1,480 @@
+/**
+ * @file x86_64.cpp
+ * @brief x86-64 instruction encoding and the bytecode translator
+ */
+
+#include "x86_64.h"
+
+#include <limits>
+#include <utility>
+
+namespace x86_64 {
+    enum Condition : int { E = 0x4, NE = 0x5, L = 0xC, GE = 0xD, LE = 0xE, G = 0xF };
+
+    inline Condition conditionOf(OpCode op) {
+        switch (op) {
+        case OpCode::GREATER: case OpCode::JUMP_IF_GREATER: return G;
+        case OpCode::LESS: case OpCode::JUMP_IF_LESS: return L;
+        case OpCode::EQUAL: case OpCode::JUMP_IF_EQUAL: return E;
+        case OpCode::NOT_EQUAL: case OpCode::JUMP_IF_NOT_EQUAL: return NE;
+        case OpCode::GREATER_EQUAL: case OpCode::JUMP_IF_GREATER_EQUAL: return GE;
+        default: return LE;
+        }
+    }
+
+    // Machine registers used by the generated code; rax, rcx and rdx are scratch, r11 holds
+    // results bound for a spill slot
+    constexpr uint32_t RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7;
+    constexpr uint32_t R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15;
+    constexpr uint32_t allocatable[] = { RBX, RBP, R12, R13, R14, R15 };
+
+    // Stack frame, above the saved registers: the assigned flags, the context, the spill slots
+    constexpr int32_t ASSIGNED = 0, CONTEXT = 8, SPILLS = 16;
+
+    // Opcodes (32-bit operands unless noted); group opcodes take their operation in reg
+    constexpr uint8_t ADD_RM_R = 0x01, SUB_RM_R = 0x29, XOR_RM_R = 0x31, CMP_RM_R = 0x39, TEST_RM_R = 0x85;
+    constexpr uint8_t MOV_RM_R = 0x89, MOV_R_RM = 0x8B, LEA = 0x8D, GROUP_IMM32 = 0x81, GROUP_IMM8 = 0x83;
+    constexpr uint8_t IMUL_R_RM_IMM32 = 0x69, IMUL_R_RM_IMM8 = 0x6B;
+    constexpr uint8_t SHIFT_IMM8 = 0xC1, GROUP_UNARY = 0xF7, CMP_RM8_IMM8 = 0x80, MOV_RM8_IMM8 = 0xC6;
+    constexpr uint8_t CALL_RM = 0xFF;
+    constexpr uint32_t ADD_IMM = 0, SUB_IMM = 5, CMP_IMM = 7, SHL = 4, NEG = 3, CALL = 2;
+
+    bool CodeGenerator::generate(std::vector<uint8_t>& code) {
+        assignment = allocateRegisters(bytecode, sizeof(allocatable) / sizeof(allocatable[0]));
+        // Pushing six registers keeps the return address's misalignment, so a frame of 8
+        // (mod 16) bytes aligns the stack for calls
+        const uint64_t frame = SPILLS + (uint64_t(assignment.spillSlots) * 4 + 15) / 16 * 16 + 8;
+        if (frame > uint64_t(std::numeric_limits<int32_t>::max()) ||
+            bytecode.variableCount > uint32_t(std::numeric_limits<int32_t>::max())) {
+            return false;
+        }
+        size_t count = bytecode.code.size();
+        labels.assign(count + 3, 0);
+        errorExit = count;
+        deoptimizeExit = count + 1;
+        epilogue = count + 2;
+
+        // Prologue: save the callee-saved registers, make the frame and keep the arguments
+        for (uint32_t reg : { RBP, RBX, R12, R13, R14, R15 }) {
+            if (reg >= 8) {
+                byte(0x41);
+            }
+            byte(0x50 + (reg & 7)); // push
+        }
+        registerForm({ GROUP_IMM32 }, SUB_IMM, RSP, true);
+        int32(static_cast<uint32_t>(frame));
+        memoryForm({ MOV_RM_R }, RDI, RSP, ASSIGNED, true);
+        memoryForm({ MOV_RM_R }, RSI, RSP, CONTEXT, true);
+
+        Liveness liveness(bytecode);
+        for (size_t pc = 0; pc < count; ++pc) {
+            labels[pc] = out.size();
+            if (native_code::feedsOnlyNext(bytecode, liveness, pc) && fuse(bytecode.code[pc], bytecode.code[pc + 1])) {
+                ++pc;
+                labels[pc] = labels[pc - 1];
+            }
+            else {
+                translate(bytecode.code[pc]);
+            }
+        }
+
+        // Undefined-variable stubs, the shared exits and the epilogue
+        for (const auto& stub : stubs) {
+            labels[stub.label] = out.size();
+            call(offsetof(Context, undefined), stub.slot, stub.offset);
+            jump(-1, errorExit);
+        }
+        labels[errorExit] = out.size();
+        immediate(RAX, 2);
+        jump(-1, epilogue);
+        labels[deoptimizeExit] = out.size();
+        immediate(RAX, 1);
+        labels[epilogue] = out.size();
+        registerForm({ GROUP_IMM32 }, ADD_IMM, RSP, true);
+        int32(static_cast<uint32_t>(frame));
+        for (uint32_t reg : { R15, R14, R13, R12, RBX, RBP }) {
+            if (reg >= 8) {
+                byte(0x41);
+            }
+            byte(0x58 + (reg & 7)); // pop
+        }
+        byte(0xC3); // ret
+
+        // rel32 displacements count from the end of the instruction
+        for (const auto& fixup : fixups) {
+            auto distance = static_cast<int64_t>(labels[fixup.label]) - static_cast<int64_t>(fixup.position + 4);
+            if (distance < std::numeric_limits<int32_t>::min() || distance > std::numeric_limits<int32_t>::max()) {
+                return false;
+            }
+            for (size_t i = 0; i < 4; ++i) {
+                out[fixup.position + i] = static_cast<uint8_t>(static_cast<uint32_t>(distance) >> (8 * i));
+            }
+        }
+        code = std::move(out);
+        return true;
+    }
+
+    void CodeGenerator::translate(const Instruction& in) {
+        switch (in.op) {
+        case OpCode::LOAD_CONST: {
+            uint32_t result = target(in.a);
+            if (in.b == 0) {
+                registerForm({ XOR_RM_R }, result, result);
+            }
+            else {
+                immediate(result, static_cast<uint32_t>(in.b));
+            }
+            finish(in.a, result);
+            break;
+        }
+        case OpCode::MOVE:
+            store(in.a, load(in.b, RAX));
+            break;
+        case OpCode::ADD:
+        case OpCode::SUBTRACT:
+        case OpCode::MULTIPLY: {
+            uint32_t left = load(in.b, RAX);
+            uint32_t right = load(in.c, RCX);
+            uint32_t result = target(in.a);
+            if (in.op == OpCode::ADD && result != left && result != right) {
+                lea(result, left, static_cast<int32_t>(right), 1, 0);
+            }
+            else if (result == right && result != left) {
+                if (in.op == OpCode::SUBTRACT) {
+                    move(RDX, left);
+                    registerForm({ SUB_RM_R }, right, RDX);
+                    move(result, RDX);
+                }
+                else if (in.op == OpCode::ADD) {
+                    registerForm({ ADD_RM_R }, left, result);
+                }
+                else {
+                    registerForm({ 0x0F, 0xAF }, result, left); // imul
+                }
+            }
+            else {
+                move(result, left);
+                if (in.op == OpCode::MULTIPLY) {
+                    registerForm({ 0x0F, 0xAF }, result, right);
+                }
+                else {
+                    registerForm({ in.op == OpCode::ADD ? ADD_RM_R : SUB_RM_R }, right, result);
+                }
+            }
+            finish(in.a, result);
+            break;
+        }
+        case OpCode::GREATER:
+        case OpCode::LESS:
+        case OpCode::EQUAL:
+        case OpCode::NOT_EQUAL:
+        case OpCode::GREATER_EQUAL:
+        case OpCode::LESS_EQUAL: {
+            uint32_t left = load(in.b, RAX);
+            registerForm({ CMP_RM_R }, load(in.c, RCX), left);
+            uint32_t result = target(in.a);
+            registerForm({ 0x0F, static_cast<uint8_t>(0x90 + conditionOf(in.op)) }, 0, RAX); // setcc al
+            registerForm({ 0x0F, 0xB6 }, result, RAX);                                      // movzx
+            finish(in.a, result);
+            break;
+        }
+        case OpCode::ADD_CONST:
+        case OpCode::SUBTRACT_CONST:
+        case OpCode::CONST_SUBTRACT:
+        case OpCode::MULTIPLY_CONST:
+        case OpCode::SHIFT_LEFT_CONST: {
+            uint32_t value = load(in.b, RAX);
+            uint32_t result = target(in.a);
+            auto constant = static_cast<uint32_t>(in.c);
+            if (in.op == OpCode::MULTIPLY_CONST && (constant == 3 || constant == 5 || constant == 9)) {
+                lea(result, value, static_cast<int32_t>(value), constant - 1, 0);
+            }
+            else if (in.op == OpCode::MULTIPLY_CONST && in.c >= -128 && in.c <= 127) {
+                registerForm({ IMUL_R_RM_IMM8 }, result, value);
+                byte(constant);
+            }
+            else if (in.op == OpCode::MULTIPLY_CONST) {
+                registerForm({ IMUL_R_RM_IMM32 }, result, value);
+                int32(constant);
+            }
+            else if (in.op == OpCode::CONST_SUBTRACT) {
+                move(result, value);
+                registerForm({ GROUP_UNARY }, NEG, result);
+                if (constant != 0) {
+                    arithmetic(ADD_IMM, result, in.c);
+                }
+            }
+            else if (in.op == OpCode::SHIFT_LEFT_CONST) {
+                move(result, value);
+                registerForm({ SHIFT_IMM8 }, SHL, result);
+                byte(static_cast<uint32_t>(in.c));
+            }
+            else if (result != value) {
+                lea(result, value, -1, 1, static_cast<int32_t>(in.op == OpCode::ADD_CONST ? constant : 0u - constant));
+            }
+            else {
+                arithmetic(in.op == OpCode::ADD_CONST ? ADD_IMM : SUB_IMM, result, in.c);
+            }
+            finish(in.a, result);
+            break;
+        }
+        case OpCode::JUMP:
+            jump(-1, static_cast<size_t>(in.a));
+            break;
+        case OpCode::JUMP_IF_FALSE:
+        case OpCode::JUMP_IF_TRUE: {
+            uint32_t value = load(in.b, RAX);
+            registerForm({ TEST_RM_R }, value, value);
+            jump(in.op == OpCode::JUMP_IF_FALSE ? E : NE, static_cast<size_t>(in.a));
+            break;
+        }
+        case OpCode::JUMP_IF_GREATER:
+        case OpCode::JUMP_IF_LESS:
+        case OpCode::JUMP_IF_EQUAL:
+        case OpCode::JUMP_IF_NOT_EQUAL:
+        case OpCode::JUMP_IF_GREATER_EQUAL:
+        case OpCode::JUMP_IF_LESS_EQUAL: {
+            uint32_t left = load(in.b, RAX);
+            registerForm({ CMP_RM_R }, load(in.c, RCX), left);
+            jump(conditionOf(in.op), static_cast<size_t>(in.a));
+            break;
+        }
+        case OpCode::INPUT:
+        case OpCode::INPUT_EXPECT: {
+            call(offsetof(Context, input), static_cast<uint32_t>(in.a), static_cast<uint32_t>(in.b));
+            registerForm({ TEST_RM_R }, RAX, RAX);
+            jump(NE, errorExit);
+            memoryForm({ MOV_R_RM }, RCX, RSP, CONTEXT, true);
+            uint32_t result = target(in.a);
+            memoryForm({ MOV_R_RM }, result, RCX, offsetof(Context, value));
+            finish(in.a, result);
+            if (in.op == OpCode::INPUT_EXPECT) {
+                compareConstant(result, in.c);
+                jump(NE, deoptimizeExit);
+            }
+            break;
+        }
+        case OpCode::PRINT:
+            call(offsetof(Context, print), static_cast<uint32_t>(in.b), load(in.a, RDX), true);
+            break;
+        case OpCode::CHECK_ASSIGNED:
+            memoryForm({ MOV_R_RM }, RAX, RSP, ASSIGNED, true);
+            memoryForm({ CMP_RM8_IMM8 }, CMP_IMM, RAX, in.a);
+            byte(0);
+            jump(E, labels.size()); // To a stub reporting the error
+            stubs.push_back({ labels.size(), static_cast<uint32_t>(in.a), static_cast<uint32_t>(in.b) });
+            labels.push_back(0);
+            break;
+        case OpCode::MARK_ASSIGNED:
+            memoryForm({ MOV_R_RM }, RAX, RSP, ASSIGNED, true);
+            memoryForm({ MOV_RM8_IMM8 }, 0, RAX, in.a);
+            byte(1);
+            break;
+        case OpCode::CHARGE:
+            call(offsetof(Context, charge), static_cast<uint32_t>(in.a), static_cast<uint32_t>(in.b));
+            registerForm({ TEST_RM_R }, RAX, RAX);
+            jump(NE, errorExit);
+            break;
+        case OpCode::HALT:
+            immediate(RAX, 0);
+            jump(-1, epilogue);
+            break;
+        }
+    }
+
+    bool CodeGenerator::fuse(const Instruction& first, const Instruction& next) {
+        const int32_t fed = first.a;
+        const bool compareAndBranch = next.op >= OpCode::JUMP_IF_GREATER && next.op <= OpCode::JUMP_IF_LESS_EQUAL;
+        if (first.op == OpCode::LOAD_CONST && (isComparison(next.op) || compareAndBranch)) {
+            // Compare against an immediate, swapping the condition when the constant is on the left
+            Condition condition = conditionOf(next.op);
+            int32_t other = next.c;
+            if (next.b != fed) {
+                other = next.b;
+            }
+            else if (condition != E && condition != NE) {
+                condition = condition == G ? L : condition == L ? G : condition == GE ? LE : GE;
+            }
+            compareConstant(load(other, RAX), first.b);
+            if (compareAndBranch) {
+                jump(condition, static_cast<size_t>(next.a));
+                return true;
+            }
+            uint32_t result = target(next.a);
+            registerForm({ 0x0F, static_cast<uint8_t>(0x90 + condition) }, 0, RAX); // setcc al
+            registerForm({ 0x0F, 0xB6 }, result, RAX);                            // movzx
+            finish(next.a, result);
+            return true;
+        }
+        if (first.op == OpCode::LOAD_CONST && next.op == OpCode::PRINT) {
+            call(offsetof(Context, print), static_cast<uint32_t>(next.b), static_cast<uint32_t>(first.b));
+            return true;
+        }
+        if (first.op == OpCode::SHIFT_LEFT_CONST && first.c <= 3 && next.op == OpCode::ADD) {
+            // lea result, [addend + value * 2^c]
+            uint32_t addend = load(next.b == fed ? next.c : next.b, RAX);
+            uint32_t value = load(first.b, RCX);
+            uint32_t result = target(next.a);
+            lea(result, addend, static_cast<int32_t>(value), 1u << first.c, 0);
+            finish(next.a, result);
+            return true;
+        }
+        if (isComparison(first.op) && (next.op == OpCode::JUMP_IF_FALSE || next.op == OpCode::JUMP_IF_TRUE)) {
+            uint32_t left = load(first.b, RAX);
+            registerForm({ CMP_RM_R }, load(first.c, RCX), left);
+            Condition condition = conditionOf(first.op);
+            jump(next.op == OpCode::JUMP_IF_FALSE ? condition ^ 1 : condition, static_cast<size_t>(next.a));
+            return true;
+        }
+        return false;
+    }
+
+    void CodeGenerator::int32(uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            byte(value >> (8 * i));
+        }
+    }
+
+    void CodeGenerator::registerForm(std::initializer_list<uint8_t> opcode, uint32_t reg, uint32_t rm, bool wide) {
+        uint32_t rex = (wide ? 8 : 0) | (reg >= 8 ? 4 : 0) | (rm >= 8 ? 1 : 0);
+        if (rex) {
+            byte(0x40 | rex);
+        }
+        for (uint8_t part : opcode) {
+            byte(part);
+        }
+        byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+    }
+
+    void CodeGenerator::memoryForm(std::initializer_list<uint8_t> opcode, uint32_t reg, uint32_t base, int32_t disp,
+                                   bool wide) {
+        uint32_t rex = (wide ? 8 : 0) | (reg >= 8 ? 4 : 0) | (base >= 8 ? 1 : 0);
+        if (rex) {
+            byte(0x40 | rex);
+        }
+        for (uint8_t part : opcode) {
+            byte(part);
+        }
+        byte(0x80 | (reg & 7) << 3 | (base & 7)); // [base + disp32]
+        if ((base & 7) == RSP) {
+            byte(0x24); // SIB: no index
+        }
+        int32(static_cast<uint32_t>(disp));
+    }
+
+    void CodeGenerator::arithmetic(uint32_t operation, uint32_t reg, int32_t value) {
+        if (value >= -128 && value <= 127) {
+            registerForm({ GROUP_IMM8 }, operation, reg);
+            byte(static_cast<uint32_t>(value));
+        }
+        else {
+            registerForm({ GROUP_IMM32 }, operation, reg);
+            int32(static_cast<uint32_t>(value));
+        }
+    }
+
+    void CodeGenerator::lea(uint32_t result, uint32_t base, int32_t index, uint32_t scale, int32_t disp) {
+        // A SIB byte for an index or an rsp/r12 base (its index of rsp means none); a base of
+        // rbp/r13 always takes a displacement
+        uint32_t indexReg = index < 0 ? RSP : static_cast<uint32_t>(index);
+        uint32_t rex = (result >= 8 ? 4 : 0) | (indexReg >= 8 ? 2 : 0) | (base >= 8 ? 1 : 0);
+        if (rex) {
+            byte(0x40 | rex);
+        }
+        byte(LEA);
+        uint32_t mod = disp == 0 && (base & 7) != RBP ? 0x00 : disp >= -128 && disp <= 127 ? 0x40 : 0x80;
+        bool sib = index >= 0 || (base & 7) == RSP;
+        byte(mod | (result & 7) << 3 | (sib ? RSP : base & 7));
+        if (sib) {
+            uint32_t log = scale == 8 ? 3 : scale == 4 ? 2 : scale == 2 ? 1 : 0;
+            byte(log << 6 | (indexReg & 7) << 3 | (base & 7));
+        }
+        if (mod == 0x40) {
+            byte(static_cast<uint32_t>(disp));
+        }
+        else if (mod == 0x80) {
+            int32(static_cast<uint32_t>(disp));
+        }
+    }
+
+    void CodeGenerator::compareConstant(uint32_t value, int32_t constant) {
+        if (constant == 0) {
+            registerForm({ TEST_RM_R }, value, value);
+        }
+        else {
+            arithmetic(CMP_IMM, value, constant);
+        }
+    }
+
+    void CodeGenerator::move(uint32_t to, uint32_t from) {
+        if (to != from) {
+            registerForm({ MOV_RM_R }, from, to);
+        }
+    }
+
+    void CodeGenerator::immediate(uint32_t reg, uint32_t value) {
+        if (reg >= 8) {
+            byte(0x41);
+        }
+        byte(0xB8 + (reg & 7)); // mov r32, imm32
+        int32(value);
+    }
+
+    void CodeGenerator::jump(int condition, size_t label) {
+        if (condition < 0) {
+            byte(0xE9);
+        }
+        else {
+            byte(0x0F);
+            byte(0x80 + static_cast<uint32_t>(condition));
+        }
+        fixups.push_back({ out.size(), label });
+        int32(0);
+    }
+
+    uint32_t CodeGenerator::load(int32_t reg, uint32_t scratch) {
+        int32_t mapped = assignment.machine[static_cast<size_t>(reg)];
+        if (mapped >= 0) {
+            return allocatable[mapped];
+        }
+        memoryForm({ MOV_R_RM }, scratch, RSP, spillOffset(reg));
+        return scratch;
+    }
+
+    uint32_t CodeGenerator::target(int32_t reg) {
+        int32_t mapped = assignment.machine[static_cast<size_t>(reg)];
+        return mapped >= 0 ? allocatable[mapped] : R11;
+    }
+
+    void CodeGenerator::finish(int32_t reg, uint32_t computed) {
+        if (assignment.machine[static_cast<size_t>(reg)] < 0) {
+            memoryForm({ MOV_RM_R }, computed, RSP, spillOffset(reg));
+        }
+    }
+
+    void CodeGenerator::store(int32_t reg, uint32_t value) {
+        int32_t mapped = assignment.machine[static_cast<size_t>(reg)];
+        if (mapped < 0) {
+            memoryForm({ MOV_RM_R }, value, RSP, spillOffset(reg));
+        }
+        else {
+            move(allocatable[mapped], value);
+        }
+    }
+
+    int32_t CodeGenerator::spillOffset(int32_t reg) const {
+        return SPILLS + assignment.spillSlot[static_cast<size_t>(reg)] * 4;
+    }
+
+    void CodeGenerator::call(size_t callback, uint32_t first, uint32_t second, bool secondIsRegister) {
+        if (secondIsRegister) {
+            move(RDX, second);
+        }
+        else {
+            immediate(RDX, second);
+        }
+        immediate(RSI, first);
+        memoryForm({ MOV_R_RM }, RDI, RSP, CONTEXT, true);
+        memoryForm({ CALL_RM }, CALL, RDI, static_cast<int32_t>(callback));
+    }
+}
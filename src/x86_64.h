@@ -0,0 +1,99 @@
+/**
+ * @file x86_64.h
+ * @brief x86-64 code generation for optimized bytecode
+ */
+
+#pragma once
+
+#include "bytecode.h"
+#include "native_code.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+// x86-64 native code (see native_code.h) for the System V calling convention. The bytecode
+// registers live in the callee-saved machine registers rbx, rbp and r12-r15; the run's
+// arguments and the spill slots are kept in the stack frame. Constants become (8-bit where
+// they fit) immediates, lea computes sums into a new register and multiplies by 3, 5 and 9,
+// and a comparison feeding a branch becomes cmp (test against zero) and jcc. Generating
+// code works on any host (--dump-native); running it needs x86-64 Linux.
+namespace x86_64 {
+    using native_code::Context;
+
+    // CodeGenerator class: Translates one Bytecode; generate() is false when the stack frame
+    // or the variables are beyond 32-bit displacements
+    class CodeGenerator {
+    public:
+        explicit CodeGenerator(const Bytecode& bytecode) : bytecode(bytecode) {}
+
+        bool generate(std::vector<uint8_t>& code);
+
+        // The spill slots in the generated function's stack frame
+        uint32_t spillSlots() const { return assignment.spillSlots; }
+
+    private:
+        struct Fixup {
+            size_t position; // Of a rel32 displacement
+            size_t label;
+        };
+
+        struct Stub {
+            size_t label;
+            uint32_t slot;
+            uint32_t offset;
+        };
+
+        const Bytecode& bytecode;
+        std::vector<uint8_t> out;
+        std::vector<size_t> labels; // Native position of each bytecode instruction, exit and stub
+        std::vector<Fixup> fixups;
+        std::vector<Stub> stubs;
+        RegisterAssignment assignment; // Machine registers index allocatable (x86_64.cpp)
+        size_t errorExit = 0, deoptimizeExit = 0, epilogue = 0;
+
+        void byte(uint32_t value) { out.push_back(static_cast<uint8_t>(value)); }
+        void int32(uint32_t value);
+
+        // An instruction with a register operand (reg, or an opcode extension) and a register
+        // (rm) or [base + disp32] operand; wide selects 64-bit operands
+        void registerForm(std::initializer_list<uint8_t> opcode, uint32_t reg, uint32_t rm, bool wide = false);
+        void memoryForm(std::initializer_list<uint8_t> opcode, uint32_t reg, uint32_t base, int32_t disp,
+                        bool wide = false);
+
+        // Emit one instruction; fuse() emits it together with the next one when a pattern
+        // matches (and the next one only reads its result) and is false otherwise
+        void translate(const Instruction& in);
+        bool fuse(const Instruction& first, const Instruction& next);
+
+        // A group 1 operation (add, sub, cmp) of reg with an immediate
+        void arithmetic(uint32_t operation, uint32_t reg, int32_t value);
+
+        // lea result, [base + index * scale + disp]; index < 0 for none
+        void lea(uint32_t result, uint32_t base, int32_t index, uint32_t scale, int32_t disp);
+
+        // The flags of value - constant
+        void compareConstant(uint32_t value, int32_t constant);
+
+        void move(uint32_t to, uint32_t from);
+        void immediate(uint32_t reg, uint32_t value);
+
+        // jmp (condition < 0) or jcc to a label
+        void jump(int condition, size_t label);
+
+        // The machine register holding a bytecode register's value, loading it into scratch if needed
+        uint32_t load(int32_t reg, uint32_t scratch);
+
+        // Where to compute a bytecode register's new value, and storing it there afterwards
+        uint32_t target(int32_t reg);
+        void finish(int32_t reg, uint32_t computed);
+
+        void store(int32_t reg, uint32_t value);
+
+        int32_t spillOffset(int32_t reg) const;
+
+        // Call a context callback with (context, first, second); second may be a register
+        void call(size_t callback, uint32_t first, uint32_t second, bool secondIsRegister = false);
+    };
+}
@@ -0,0 +1,289 @@
+/**
+ * @file aarch64_emulator.h
+ * @brief An interpreter for the AArch64 subset the native code generator emits
+ */
+
+#pragma once
+
+#include "native_code.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Aarch64Emulator class: Runs code from aarch64::CodeGenerator on any host, so that the
+// tests check it against the tree interpreter without AArch64 hardware or qemu-user. The
+// registers hold host addresses, and loads and stores go straight to host memory (the
+// stack is a buffer of the emulator's). blr may only call the native_code callbacks; each
+// call then scrambles the caller-saved registers, and the run fails unless the code kept
+// the callee-saved ones. Any instruction outside the subset throws.
+class Aarch64Emulator {
+public:
+    explicit Aarch64Emulator(std::vector<uint32_t> code) : code(std::move(code)), stack(1 << 16) {}
+
+    int32_t run(uint8_t* assigned, native_code::Context* context) {
+        uint64_t saved[32];
+        for (uint32_t reg = 0; reg < 31; ++reg) {
+            x[reg] = saved[reg] = 0x5EED000000000000 + reg;
+        }
+        x[0] = address(assigned);
+        x[1] = address(context);
+        x[30] = returnSentinel;
+        sp = saved[31] = address(stack.data() + stack.size());
+        size_t pc = 0;
+        for (uint64_t steps = 0; steps < maxSteps; ++steps) {
+            if (pc >= code.size()) {
+                fail("ran off the end of the code", pc);
+            }
+            uint32_t word = code[pc];
+            size_t next = pc + 1;
+            if (!step(word, pc, next)) {
+                for (uint32_t reg = 19; reg <= 29; ++reg) {
+                    if (x[reg] != saved[reg]) {
+                        fail("x" + std::to_string(reg) + " not restored", pc);
+                    }
+                }
+                if (sp != saved[31]) {
+                    fail("sp not restored", pc);
+                }
+                return static_cast<int32_t>(x[0]);
+            }
+            pc = next;
+        }
+        throw std::runtime_error("emulated code did not return");
+    }
+
+private:
+    static constexpr uint64_t returnSentinel = 0xDEAD0000;
+    static constexpr uint64_t maxSteps = 100000000;
+
+    std::vector<uint32_t> code;
+    std::vector<uint8_t> stack;
+    uint64_t x[31] = {};
+    uint64_t sp = 0;
+    bool n = false, z = false, c = false, v = false;
+
+    template <typename T>
+    static uint64_t address(T* pointer) { return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pointer)); }
+
+    [[noreturn]] static void fail(const std::string& message, size_t pc) {
+        throw std::runtime_error("emulated AArch64 at word " + std::to_string(pc) + ": " + message);
+    }
+
+    // Register 31 is the zero register or sp, depending on the instruction
+    uint64_t read(uint32_t reg, bool is64, bool spForm = false) const {
+        uint64_t value = reg == 31 ? (spForm ? sp : 0) : x[reg];
+        return is64 ? value : value & 0xFFFFFFFF;
+    }
+
+    void write(uint32_t reg, uint64_t value, bool is64, bool spForm = false) {
+        value = is64 ? value : value & 0xFFFFFFFF;
+        if (reg != 31) {
+            x[reg] = value;
+        }
+        else if (spForm) {
+            sp = value;
+        }
+    }
+
+    uint64_t addWithCarry(uint64_t a, uint64_t b, bool carry, bool is64, bool setFlags) {
+        uint64_t mask = is64 ? ~uint64_t(0) : 0xFFFFFFFF;
+        a &= mask;
+        b &= mask;
+        uint64_t result = (a + b + carry) & mask;
+        if (setFlags) {
+            uint64_t sign = is64 ? uint64_t(1) << 63 : uint64_t(1) << 31;
+            n = (result & sign) != 0;
+            z = result == 0;
+            c = is64 ? (result < a || (carry && result == a)) : ((a + b + carry) >> 32) != 0;
+            v = ((a ^ result) & (b ^ result) & sign) != 0;
+        }
+        return result;
+    }
+
+    bool holds(uint32_t condition) const {
+        bool result;
+        switch (condition >> 1) {
+        case 0: result = z; break;
+        case 1: result = c; break;
+        case 2: result = n; break;
+        case 3: result = v; break;
+        case 4: result = c && !z; break;
+        case 5: result = n == v; break;
+        case 6: result = n == v && !z; break;
+        default: result = true; break;
+        }
+        return (condition & 1) && condition != 15 ? !result : result;
+    }
+
+    static int64_t signExtend(uint64_t value, uint32_t bits) {
+        uint64_t sign = uint64_t(1) << (bits - 1);
+        return static_cast<int64_t>((value ^ sign) - sign);
+    }
+
+    template <typename T>
+    T load(uint64_t at) const {
+        T value;
+        std::memcpy(&value, reinterpret_cast<const void*>(static_cast<uintptr_t>(at)), sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void store(uint64_t at, T value) {
+        std::memcpy(reinterpret_cast<void*>(static_cast<uintptr_t>(at)), &value, sizeof(T));
+    }
+
+    // Execute one instruction; false once the function returns
+    bool step(uint32_t word, size_t pc, size_t& next) {
+        const bool is64 = word >> 31;
+        const uint32_t rd = word & 31, rn = (word >> 5) & 31, rm = (word >> 16) & 31;
+        if ((word & 0x1F200000) == 0x0B000000) { // add/sub (shifted register)
+            uint32_t shift = (word >> 22) & 3, amount = (word >> 10) & 63;
+            uint64_t operand = read(rm, is64);
+            operand = shift == 0 ? operand << amount : shift == 1 ? operand >> amount
+                      : static_cast<uint64_t>(is64 ? static_cast<int64_t>(operand) >> amount
+                                                   : static_cast<int64_t>(static_cast<int32_t>(operand) >> amount));
+            bool subtract = (word >> 30) & 1;
+            write(rd, addWithCarry(read(rn, is64), subtract ? ~operand : operand, subtract, is64, (word >> 29) & 1), is64);
+        }
+        else if ((word & 0x1F800000) == 0x11000000) { // add/sub (immediate)
+            uint64_t operand = static_cast<uint64_t>((word >> 10) & 0xFFF) << ((word >> 22) & 1 ? 12 : 0);
+            bool subtract = (word >> 30) & 1, setFlags = (word >> 29) & 1;
+            write(rd, addWithCarry(read(rn, is64, true), subtract ? ~operand : operand, subtract, is64, setFlags), is64,
+                  !setFlags);
+        }
+        else if ((word & 0x7F200000) == 0x2A000000) { // orr (shifted register), as mov
+            if ((word >> 22) & 3) {
+                fail("shifted orr", pc);
+            }
+            write(rd, read(rn, is64) | read(rm, is64) << ((word >> 10) & 63), is64);
+        }
+        else if ((word & 0x7FE00000) == 0x1B000000) { // madd/msub
+            uint64_t product = read(rn, is64) * read(rm, is64);
+            uint64_t addend = read((word >> 10) & 31, is64);
+            write(rd, (word >> 15) & 1 ? addend - product : addend + product, is64);
+        }
+        else if ((word & 0x7FE00C00) == 0x1A800400) { // csinc
+            write(rd, holds((word >> 12) & 15) ? read(rn, is64) : read(rm, is64) + 1, is64);
+        }
+        else if ((word & 0x1F800000) == 0x12800000) { // movn/movz/movk
+            uint32_t opc = (word >> 29) & 3, shift = ((word >> 21) & 3) * 16;
+            uint64_t imm = static_cast<uint64_t>((word >> 5) & 0xFFFF) << shift;
+            if (opc == 0) {
+                write(rd, ~imm, is64);
+            }
+            else if (opc == 2) {
+                write(rd, imm, is64);
+            }
+            else if (opc == 3) {
+                write(rd, (read(rd, is64) & ~(uint64_t(0xFFFF) << shift)) | imm, is64);
+            }
+            else {
+                fail("unallocated move wide", pc);
+            }
+        }
+        else if ((word & 0xFFC00000) == 0x53000000) { // ubfm (lsl, lsr)
+            uint32_t immr = (word >> 16) & 63, imms = (word >> 10) & 63;
+            uint64_t value = read(rn, false);
+            uint64_t result = imms >= immr ? (value >> immr) & ((uint64_t(2) << (imms - immr)) - 1)
+                                           : (value & ((uint64_t(2) << imms) - 1)) << (32 - immr);
+            write(rd, result, false);
+        }
+        else if ((word & 0x3F000000) == 0x39000000) { // ldr/str (unsigned offset)
+            uint32_t size = word >> 30, opc = (word >> 22) & 3;
+            uint64_t at = read(rn, true, true) + (static_cast<uint64_t>((word >> 10) & 0xFFF) << size);
+            if (opc > 1 || size == 1) {
+                fail("load or store form", pc);
+            }
+            if (opc == 0 && size == 0) {
+                store<uint8_t>(at, static_cast<uint8_t>(read(rd, false)));
+            }
+            else if (opc == 0) {
+                size == 2 ? store<uint32_t>(at, static_cast<uint32_t>(read(rd, false))) : store<uint64_t>(at, read(rd, true));
+            }
+            else {
+                write(rd, size == 0 ? load<uint8_t>(at) : size == 2 ? load<uint32_t>(at) : load<uint64_t>(at), true);
+            }
+        }
+        else if ((word & 0xFC000000) == 0xA8000000) { // stp/ldp (64-bit)
+            uint32_t mode = (word >> 23) & 3, rt2 = (word >> 10) & 31;
+            int64_t offset = signExtend((word >> 15) & 0x7F, 7) * 8;
+            uint64_t base = read(rn, true, true);
+            uint64_t at = mode == 1 ? base : base + static_cast<uint64_t>(offset);
+            if ((word >> 22) & 1) {
+                write(rd, load<uint64_t>(at), true);
+                write(rt2, load<uint64_t>(at + 8), true);
+            }
+            else {
+                store<uint64_t>(at, read(rd, true));
+                store<uint64_t>(at + 8, read(rt2, true));
+            }
+            if (mode == 1 || mode == 3) {
+                write(rn, base + static_cast<uint64_t>(offset), true, true);
+            }
+            else if (mode != 2) {
+                fail("no-allocate pair", pc);
+            }
+        }
+        else if ((word & 0xFC000000) == 0x14000000) { // b
+            next = pc + static_cast<size_t>(signExtend(word & 0x3FFFFFF, 26));
+        }
+        else if ((word & 0xFF000010) == 0x54000000) { // b.cond
+            if (holds(word & 15)) {
+                next = pc + static_cast<size_t>(signExtend((word >> 5) & 0x7FFFF, 19));
+            }
+        }
+        else if ((word & 0x7E000000) == 0x34000000) { // cbz/cbnz
+            if ((read(rd, is64) == 0) != static_cast<bool>((word >> 24) & 1)) {
+                next = pc + static_cast<size_t>(signExtend((word >> 5) & 0x7FFFF, 19));
+            }
+        }
+        else if ((word & 0xFFFFFC1F) == 0xD63F0000) { // blr
+            call(read(rn, true), pc);
+            x[30] = address(code.data() + pc + 1);
+        }
+        else if (word == 0xD65F03C0) { // ret
+            if (x[30] != returnSentinel) {
+                fail("return to an unexpected address", pc);
+            }
+            return false;
+        }
+        else {
+            char hex[16];
+            std::snprintf(hex, sizeof(hex), "%08x", word);
+            fail(std::string("instruction ") + hex + " is not emulated", pc);
+        }
+        return true;
+    }
+
+    void call(uint64_t target, size_t pc) {
+        auto* context = reinterpret_cast<native_code::Context*>(static_cast<uintptr_t>(x[0]));
+        auto first = static_cast<uint32_t>(x[1]), second = static_cast<uint32_t>(x[2]);
+        uint64_t result;
+        if (target == address(native_code::contextInput)) {
+            result = static_cast<uint32_t>(native_code::contextInput(context, first, second));
+        }
+        else if (target == address(native_code::contextPrint)) {
+            native_code::contextPrint(context, first, static_cast<int32_t>(second));
+            result = 0xBAD;
+        }
+        else if (target == address(native_code::contextUndefined)) {
+            native_code::contextUndefined(context, first, second);
+            result = 0xBAD;
+        }
+        else if (target == address(native_code::contextCharge)) {
+            result = static_cast<uint32_t>(native_code::contextCharge(context, first, second));
+        }
+        else {
+            fail("call to an unknown address", pc);
+        }
+        for (uint32_t reg = 1; reg <= 18; ++reg) {
+            x[reg] = 0xBAD0000000000000 + reg;
+        }
+        x[0] = result;
+        n = z = c = v = true;
+    }
+};
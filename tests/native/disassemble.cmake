@@ -0,0 +1,48 @@
+# Disassemble the machine code the native engine generates for a script:
+#   cmake -DCOMPILER=<GLSLCompiler> -DLLVM_MC=<llvm-mc> -DSCRIPT=<code file>
+#         -DARCH=aarch64|x86-64 [-DWORK_DIR=<directory>] [-DEXPECT=<text>|<text>...]
+#         -P disassemble.cmake
+# The code is written with --dump-native; every byte of it must decode as an instruction,
+# and the listing must contain each EXPECT text (the instruction selection to check).
+foreach(variable COMPILER LLVM_MC SCRIPT ARCH)
+    if(NOT DEFINED ${variable})
+        message(FATAL_ERROR "disassemble.cmake needs -D${variable}=...")
+    endif()
+endforeach()
+if(NOT DEFINED WORK_DIR)
+    set(WORK_DIR ${CMAKE_CURRENT_BINARY_DIR})
+endif()
+get_filename_component(name ${SCRIPT} NAME_WE)
+set(code ${WORK_DIR}/${name}.${ARCH}.bin)
+set(listing ${WORK_DIR}/${name}.${ARCH}.txt)
+
+execute_process(COMMAND ${COMPILER} --dump-native ${SCRIPT} ${code} --target=${ARCH}
+                RESULT_VARIABLE dumpResult ERROR_VARIABLE dumpError)
+if(NOT dumpResult EQUAL 0)
+    message(FATAL_ERROR "--dump-native failed: ${dumpError}")
+endif()
+
+# llvm-mc --disassemble reads bytes written as 0x.. tokens
+file(READ ${code} hex HEX)
+string(REGEX REPLACE "(..)" "0x\\1 " bytes "${hex}")
+file(WRITE ${listing} "${bytes}\n")
+if(ARCH STREQUAL "aarch64")
+    set(triple aarch64)
+else()
+    set(triple x86_64)
+endif()
+execute_process(COMMAND ${LLVM_MC} --disassemble -triple=${triple} ${listing}
+                RESULT_VARIABLE mcResult OUTPUT_VARIABLE instructions ERROR_VARIABLE mcError)
+if(NOT mcResult EQUAL 0 OR mcError MATCHES "invalid|warning")
+    message(FATAL_ERROR "llvm-mc rejects the ${ARCH} code for ${SCRIPT}:\n${mcError}")
+endif()
+if(DEFINED EXPECT)
+    string(REPLACE "|" ";" expected "${EXPECT}")
+    foreach(text IN LISTS expected)
+        string(FIND "${instructions}" "${text}" found)
+        if(found EQUAL -1)
+            message(FATAL_ERROR "No '${text}' in the ${ARCH} code for ${SCRIPT}:\n${instructions}")
+        endif()
+    endforeach()
+endif()
+message(STATUS "${SCRIPT}: ${ARCH} code disassembles")
@@ -0,0 +1,2116 @@
+/**
+ * @file tests.cpp
+ * @brief Feature tests for the GLSL compiler
+ *
+ * The tests link the GLSLCore library, so they reach the engines, codecs and file formats
+ * directly. Every TEST is one ctest test (see tests/CMakeLists.txt):
+ * `GLSLTests <name>` runs one of them and `GLSLTests` runs them all.
+ */
+
+#include "aarch64.h"
+#include "alloc_stats.h"
+#include "ast.h"
+#include "bundle.h"
+#include "bytecode.h"
+#include "bytecode_compiler.h"
+#include "bytecode_vm.h"
+#include "cli.h"
+#include "codecs.h"
+#include "engine.h"
+#include "hot_swap.h"
+#include "interpreter.h"
+#include "io.h"
+#include "lexer.h"
+#include "native_code.h"
+#include "native_vm.h"
+#include "output_table.h"
+#include "parser.h"
+#include "partial_evaluator.h"
+#include "platform.h"
+#include "program.h"
+#include "reactive.h"
+#include "result_cache.h"
+#include "runtime.h"
+#include "wasm.h"
+#include "x86_64.h"
+
+#include "aarch64_emulator.h"
+#include "wasm_interpreter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+// Test registry and checks
+namespace testing {
+    using TestFunction = void (*)();
+
+    struct TestCase {
+        const char* name;
+        TestFunction function;
+    };
+
+    std::vector<TestCase>& registry() {
+        static std::vector<TestCase> tests;
+        return tests;
+    }
+
+    struct Registration {
+        Registration(const char* name, TestFunction function) {
+            registry().push_back({ name, function });
+        }
+    };
+
+    // Thrown by a test that cannot run on this host (reported to ctest as skipped)
+    struct Skipped : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    // Name of the running test; temporary files are named after it
+    std::string currentTest;
+
+    [[noreturn]] void fail(const char* file, int line, const std::string& message) {
+        throw std::runtime_error(std::string(file) + ":" + std::to_string(line) + ": " + message);
+    }
+
+    template <typename T>
+    std::string show(const T& value) {
+        std::ostringstream text;
+        text << value;
+        return text.str();
+    }
+
+    inline std::string show(const std::string& value) {
+        return "\"" + value + "\"";
+    }
+}
+
+#define TEST(name)                                                                        \
+    static void test_##name();                                                            \
+    static testing::Registration register_##name(#name, test_##name);                    \
+    static void test_##name()
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            testing::fail(__FILE__, __LINE__, "check failed: " #condition);               \
+        }                                                                                 \
+    } while (false)
+
+#define CHECK_EQ(actual, expected)                                                        \
+    do {                                                                                  \
+        const auto actualValue = (actual);                                                \
+        const auto expectedValue = (expected);                                            \
+        if (!(actualValue == expectedValue)) {                                            \
+            testing::fail(__FILE__, __LINE__, #actual " is " + testing::show(actualValue) + \
+                                                  ", expected " + testing::show(expectedValue)); \
+        }                                                                                 \
+    } while (false)
+
+#define CHECK_THROWS(expression, message)                                                 \
+    do {                                                                                  \
+        bool thrown = false;                                                              \
+        try {                                                                             \
+            (void)(expression);                                                           \
+        }                                                                                 \
+        catch (const std::exception& e) {                                                 \
+            thrown = true;                                                                \
+            if (std::string(e.what()).find(message) == std::string::npos) {               \
+                testing::fail(__FILE__, __LINE__, #expression " threw \"" + std::string(e.what()) + "\""); \
+            }                                                                             \
+        }                                                                                 \
+        if (!thrown) {                                                                    \
+            testing::fail(__FILE__, __LINE__, #expression " did not throw");              \
+        }                                                                                 \
+    } while (false)
+
+// TemporaryFile class: A file in the working directory, removed when the test ends
+class TemporaryFile {
+public:
+    explicit TemporaryFile(const std::string& contents = "", const std::string& suffix = ".tmp") {
+        static int counter = 0;
+        filePath = testing::currentTest + "_" + std::to_string(counter++) + suffix;
+        write(contents);
+    }
+
+    ~TemporaryFile() {
+        std::remove(filePath.c_str());
+    }
+
+    TemporaryFile(const TemporaryFile&) = delete;
+    TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+    const std::string& path() const { return filePath; }
+
+    void write(const std::string& contents) const {
+        std::ofstream file(filePath, std::ios::binary);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    }
+
+private:
+    std::string filePath;
+};
+
+// ScopedValue class: Puts back the value a global setting (runLimits, registerAllocation)
+// had when it was made, once the scope ends, so a test that fails leaves no setting behind
+template <typename T>
+class ScopedValue {
+public:
+    explicit ScopedValue(T& variable) : variable(variable), saved(variable) {}
+
+    ~ScopedValue() {
+        variable = saved;
+    }
+
+    ScopedValue(const ScopedValue&) = delete;
+    ScopedValue& operator=(const ScopedValue&) = delete;
+
+private:
+    T& variable;
+    T saved;
+};
+
+// Input values in the text format (one integer per line)
+std::string inputText(const std::vector<int>& values) {
+    std::string text;
+    for (int value : values) {
+        text += std::to_string(value) + "\n";
+    }
+    return text;
+}
+
+std::shared_ptr<const CompiledProgram> compile(const std::string& source) {
+    return compileScript("test.code", source);
+}
+
+// Run a program once per input vector, on one engine so that it moves up the tiers. Returns
+// every run's output, each followed by its error (described as the command line does)
+std::string runEngine(const std::shared_ptr<const CompiledProgram>& compiled, EngineKind kind,
+                      const std::vector<std::vector<int>>& inputs, OutputFormat format = OutputFormat::TEXT) {
+    ExecutionEngine engine(compiled, kind, format);
+    std::string result;
+    for (const auto& values : inputs) {
+        std::string output;
+        try {
+            engine.run({ values.data(), values.size() }, output);
+        }
+        catch (const std::exception& e) {
+            output += "error: " + describeError(e, *compiled) + "\n";
+        }
+        result += output;
+    }
+    return result;
+}
+
+// The sample script from inputfiles/
+const char* const sampleScript =
+    "input(a);\n"
+    "input(b);\n"
+    "t=1;\n"
+    "f=0;\n"
+    "if a==b then\n"
+    "  print(t);\n"
+    "endif;\n"
+    "if a!=b then\n"
+    "  print(f);\n"
+    "endif;\n"
+    "print(40+4);";
+
+// ScriptShape structure: What randomScript draws from. By default expressions end in the
+// variables and the numbers 0 to 20; a list of constants (drawn as often as variables)
+// steers programs into the compilers' immediate forms, and a pool makes the statements'
+// expressions repeat, alone or as the sum of two.
+struct ScriptShape {
+    std::vector<std::string> constants;
+    size_t pooledExpressions = 0;
+};
+
+// A random script over the variables a-e: inputs, assignments, prints and nested ifs, with
+// expressions mixing arithmetic and comparisons. Variables may be read before they are
+// assigned and inputs may run out, so some runs fail.
+std::string randomScript(std::mt19937& random, const ScriptShape& shape = {}) {
+    const char* const variables[] = { "a", "b", "c", "d", "e" };
+    const char* const operators[] = { "+", "-", "*", ">", "<", "==", "!=", ">=", "<=" };
+    auto pick = [&](size_t count) { return static_cast<size_t>(random() % count); };
+    auto constant = [&]() {
+        return shape.constants.empty() ? std::to_string(pick(21)) : shape.constants[pick(shape.constants.size())];
+    };
+    std::function<std::string(int)> expression = [&](int depth) -> std::string {
+        size_t choice = pick(10);
+        if (depth > 3 || choice < 3) {
+            bool variable = shape.constants.empty() ? pick(5) < 3 : pick(2) == 0;
+            return variable ? variables[pick(5)] : constant();
+        }
+        if (choice < 4) {
+            return "(" + expression(depth + 1) + ")";
+        }
+        std::string right = expression(depth + 1);
+        return expression(depth + 1) + " " + operators[pick(9)] + " " + (pick(2) ? right : "(" + right + ")");
+    };
+    std::vector<std::string> pool;
+    for (size_t i = 0; i < shape.pooledExpressions; ++i) {
+        pool.push_back("(" + expression(1) + ")");
+    }
+    auto statementExpression = [&]() {
+        if (pool.empty()) {
+            return expression(0);
+        }
+        return pick(3) ? pool[pick(pool.size())] : pool[pick(pool.size())] + " + " + pool[pick(pool.size())];
+    };
+    std::function<void(std::string&, size_t, int)> statements = [&](std::string& script, size_t count, int depth) {
+        for (size_t i = 0; i < count; ++i) {
+            size_t choice = pick(20);
+            if (choice < 6) {
+                script += std::string(variables[pick(5)]) + " = " + statementExpression() + ";\n";
+            }
+            else if (choice < 10) {
+                script += "print(" + statementExpression() + ");\n";
+            }
+            else if (choice < 13) {
+                script += std::string("input(") + variables[pick(5)] + ");\n";
+            }
+            else if (depth < 3) {
+                script += "if " + statementExpression() + " then\n";
+                statements(script, pick(5), depth + 1);
+                script += "endif;\n";
+            }
+        }
+    };
+    std::string script;
+    for (size_t i = 0, inputs = pick(6); i < inputs; ++i) {
+        script += std::string("input(") + variables[i] + ");\n";
+    }
+    statements(script, 1 + pick(15), 0);
+    return script;
+}
+
+// Input vectors for runs of a random script: up to maxValues values each, in [-bound, bound]
+std::vector<std::vector<int>> randomInputs(std::mt19937& random, size_t runs, size_t maxValues, int bound) {
+    std::vector<std::vector<int>> inputs(runs);
+    for (auto& values : inputs) {
+        values.resize(random() % (maxValues + 1));
+        for (int& value : values) {
+            value = static_cast<int>(random() % (2 * static_cast<uint32_t>(bound) + 1)) - bound;
+        }
+    }
+    return inputs;
+}
+
+// AArch64 code for a program's optimized bytecode, run on the emulator once per input
+// vector; the results read as runEngine's
+std::string runEmulatedAarch64(const std::shared_ptr<const CompiledProgram>& compiled,
+                               const std::vector<std::vector<int>>& inputs) {
+    auto bytecode = BytecodeCompiler(*compiled->program, true).compile();
+    std::vector<uint32_t> code;
+    if (!aarch64::CodeGenerator(*bytecode).generate(code)) {
+        throw std::runtime_error("no AArch64 code generated");
+    }
+    Aarch64Emulator emulator(std::move(code));
+    std::vector<uint8_t> assigned(std::max<size_t>(compiled->program->symbols.names.size(), 1));
+    std::string result;
+    for (const auto& values : inputs) {
+        std::string output;
+        std::fill(assigned.begin(), assigned.end(), 0);
+        try {
+            native_code::RunState state({ values.data(), values.size() }, output, OutputFormat::TEXT);
+            state.finish(emulator.run(assigned.data(), &state.context), *compiled->program);
+        }
+        catch (const RuntimeError& e) {
+            output += "error: " + describeError(e, *compiled) + "\n";
+        }
+        result += output;
+    }
+    return result;
+}
+
+// Where a differential test runs programs besides the tree interpreter: the engines, and the
+// AArch64 code on the emulator. NATIVE is left out on hosts that cannot run native code.
+enum class Backend { BASELINE, BYTECODE, NATIVE, EMULATED_AARCH64 };
+
+// Run a program on each backend once per input vector and check that it prints what the
+// tree interpreter prints and fails the same way; a mismatch names the backend and the script
+void checkAgainstTree(const std::shared_ptr<const CompiledProgram>& compiled, const std::vector<std::vector<int>>& inputs,
+                      std::initializer_list<Backend> backends) {
+    std::string expected = runEngine(compiled, EngineKind::TREE, inputs);
+    for (Backend backend : backends) {
+        std::string actual;
+        const char* name = "";
+        switch (backend) {
+        case Backend::BASELINE:
+            name = "baseline";
+            actual = runEngine(compiled, EngineKind::BASELINE, inputs);
+            break;
+        case Backend::BYTECODE:
+            name = "bytecode";
+            actual = runEngine(compiled, EngineKind::BYTECODE, inputs);
+            break;
+        case Backend::NATIVE:
+            if (!NativeVM::supported()) {
+                continue;
+            }
+            name = "native";
+            actual = runEngine(compiled, EngineKind::NATIVE, inputs);
+            break;
+        case Backend::EMULATED_AARCH64:
+            name = "emulated AArch64";
+            actual = runEmulatedAarch64(compiled, inputs);
+            break;
+        }
+        if (actual != expected) {
+            testing::fail(__FILE__, __LINE__, std::string(name) + " output " + testing::show(actual) + ", expected " +
+                                                  testing::show(expected) + ", for the script\n" + compiled->source);
+        }
+    }
+}
+
+// Batch mode: every input file runs in order (while later ones are read ahead), a failing
+// run is reported and the batch goes on
+TEST(batch) {
+    auto compiled = compile(sampleScript);
+    std::vector<std::vector<int>> inputs;
+    for (int i = 0; i < 10; ++i) {
+        inputs.push_back({ i % 3, i % 2 });
+    }
+    inputs.push_back({ 7 }); // Not enough input values
+    inputs.push_back({ 5, 5 });
+
+    std::deque<TemporaryFile> files;
+    std::vector<std::string> paths;
+    for (const auto& values : inputs) {
+        paths.push_back(files.emplace_back(inputText(values)).path());
+    }
+    paths.insert(paths.begin() + 5, "missing.input"); // Fails to load; the next files still run
+
+    std::string expected;
+    for (const auto& values : inputs) {
+        std::string output = runEngine(compiled, EngineKind::TREE, { values });
+        expected += output.substr(0, output.find("error: ")); // Batch mode reports errors on stderr
+    }
+
+    ProgramSlot slot(compiled);
+    for (auto kind : { EngineKind::TREE, EngineKind::BASELINE, EngineKind::BYTECODE, EngineKind::TIERED }) {
+        std::ostringstream out;
+        int status;
+        {
+            OutputWriter writer(false, out);
+            status = runBatch(slot, paths, kind, OutputFormat::TEXT, writer);
+        }
+        CHECK_EQ(status, 1);
+        CHECK_EQ(out.str(), expected);
+    }
+}
+
+std::vector<int> spanValues(InputSpan span) {
+    return std::vector<int>(span.data, span.data + span.size);
+}
+
+// A stream whose writes wait until the test opens it, like a slow disk or a full pipe
+class GatedBuffer : public std::stringbuf {
+public:
+    void open() {
+        std::lock_guard<std::mutex> lock(mutex);
+        opened = true;
+        changed.notify_all();
+    }
+
+    // Open the gate once timeout has passed, unless it was opened before
+    void openAfter(std::chrono::seconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait_for(lock, timeout, [this]() { return opened; });
+        opened = true;
+        changed.notify_all();
+    }
+
+    bool isOpen() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return opened;
+    }
+
+    // Wait until a write is held at the gate
+    void waitForWriter() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return waiting || opened; });
+    }
+
+protected:
+    std::streamsize xsputn(const char* data, std::streamsize size) override {
+        std::unique_lock<std::mutex> lock(mutex);
+        waiting = true;
+        changed.notify_all();
+        changed.wait(lock, [this]() { return opened; });
+        return std::stringbuf::xsputn(data, size);
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool opened = false;
+    bool waiting = false;
+};
+
+// Output writer: while a write is stuck, runs go on and their output queues up behind it
+// (up to OutputWriter::queueDepth buffers), then everything is written in order
+TEST(output_writer) {
+    auto compiled = compile(sampleScript);
+    GatedBuffer gate;
+    std::ostream out(&gate);
+    std::string expected;
+    {
+        OutputWriter writer(false, out);
+        ExecutionEngine engine(compiled, EngineKind::TIERED, OutputFormat::TEXT);
+        // Opens the gate after a while in case submit blocks, so a failure does not hang
+        std::thread fallback([&gate]() { gate.openAfter(std::chrono::seconds(10)); });
+        for (size_t run = 0; run <= OutputWriter::queueDepth; ++run) {
+            std::vector<int> values = { static_cast<int>(run % 3), static_cast<int>(run % 2) };
+            std::string output;
+            engine.run({ values.data(), values.size() }, output);
+            expected += output;
+            writer.submit(std::move(output));
+            if (run == 0) {
+                gate.waitForWriter();
+            }
+        }
+        CHECK(!gate.isOpen());
+        gate.open();
+        writer.finish();
+        fallback.join();
+    }
+    CHECK_EQ(gate.str(), expected);
+
+    // The prefetch pool hands files out in order, each with its own load error
+    std::deque<TemporaryFile> files;
+    std::vector<std::string> paths;
+    for (int i = 0; i < 20; ++i) {
+        paths.push_back(i == 7 ? "missing.input" : files.emplace_back(inputText({ i })).path());
+    }
+    InputPrefetcher prefetcher(paths, 3, 4);
+    for (int i = 0; i < 20; ++i) {
+        if (i == 7) {
+            CHECK_THROWS(prefetcher.next(), "Error opening 'missing.input'.");
+        }
+        else {
+            CHECK(spanValues(prefetcher.next().span()) == std::vector<int>{ i });
+        }
+    }
+}
+
+// Binary input format: every width and encoding loads the values it was packed from, and
+// damaged files are rejected
+TEST(binary_input) {
+    std::vector<int> values = { 0, 1, -1, 404, -70000, std::numeric_limits<int>::max(),
+                                std::numeric_limits<int>::min(), 3, 3, 3 };
+    auto compiled = compile(sampleScript);
+    TemporaryFile text(inputText(values));
+    std::string expected = runEngine(compiled, EngineKind::TREE, { spanValues(InputBuffer::load(text.path()).span()) });
+    for (size_t width : { 4, 8 }) {
+        for (auto encoding : { binary_input::Encoding::RAW, binary_input::Encoding::DELTA_VARINT }) {
+            std::string packed = binary_input::pack(values, width, encoding);
+            TemporaryFile file(packed);
+            InputBuffer inputs = InputBuffer::load(file.path());
+            CHECK(spanValues(inputs.span()) == values);
+            CHECK_EQ(runEngine(compiled, EngineKind::TIERED, { spanValues(inputs.span()) }), expected);
+
+            TemporaryFile truncated(packed.substr(0, packed.size() - 1));
+            CHECK_THROWS(InputBuffer::load(truncated.path()), "Truncated binary input");
+        }
+    }
+
+    std::string wide = binary_input::pack({ 1 }, 8, binary_input::Encoding::RAW);
+    wide[binary_input::headerSize + 4] = 1; // 2^32 + 1
+    TemporaryFile outOfRange(wide);
+    CHECK_THROWS(InputBuffer::load(outOfRange.path()), "Input value out of range");
+
+    std::string header = binary_input::pack({}, 4, binary_input::Encoding::DELTA_VARINT);
+    std::string hugeCount = header;
+    hugeCount[15] = 0x10; // A count no file can hold
+    TemporaryFile huge(hugeCount);
+    CHECK_THROWS(InputBuffer::load(huge.path()), "Truncated binary input");
+    std::string badVersion = header;
+    badVersion[4] = 9;
+    TemporaryFile unsupported(badVersion);
+    CHECK_THROWS(InputBuffer::load(unsupported.path()), "Unsupported binary input header");
+}
+
+// Output formats: framed output is a (print id, value) frame per print and an end-of-run
+// frame, raw output the values alone, and every engine writes the same bytes
+TEST(output_formats) {
+    auto compiled = compile("input(a);\nprint(a);\nif a > 2 then\n  print(a * 2);\nendif;\nprint(0 - a);\n");
+    std::string framed;
+    for (auto [id, value] : { std::pair<uint32_t, int>{ 0, 5 }, { 1, 10 }, { 2, -5 }, { framed_output::endOfRunId, 0 } }) {
+        appendInt32(framed, id);
+        appendInt32(framed, static_cast<uint32_t>(value));
+    }
+    CHECK_EQ(runEngine(compiled, EngineKind::TREE, { { 5 } }, OutputFormat::FRAMED), framed);
+    std::string raw;
+    for (int value : { 1, -1 }) {
+        appendInt32(raw, static_cast<uint32_t>(value));
+    }
+    CHECK_EQ(runEngine(compiled, EngineKind::TREE, { { 1 } }, OutputFormat::RAW), raw);
+
+    std::vector<std::vector<int>> inputs;
+    for (int i = 0; i < 3000; ++i) {
+        inputs.push_back({ i % 10 - 3 });
+    }
+    for (auto format : { OutputFormat::TEXT, OutputFormat::RAW, OutputFormat::FRAMED }) {
+        std::string expected = runEngine(compiled, EngineKind::TREE, inputs, format);
+        for (auto kind : { EngineKind::BASELINE, EngineKind::BYTECODE, EngineKind::TIERED }) {
+            CHECK(runEngine(compiled, kind, inputs, format) == expected);
+        }
+    }
+}
+
+// Compressed streams: data round-trips, compressed inputs and outputs match plain ones, and
+// damaged or hostile streams are rejected without growing past their declared size
+TEST(compressed_streams) {
+    std::mt19937 random(54);
+    std::string noise(3 * glz::blockSize + 17, '\0');
+    for (auto& byte : noise) {
+        byte = static_cast<char>(random());
+    }
+    std::string numbers;
+    for (int i = 0; i < 50000; ++i) {
+        numbers += std::to_string(i % 700 - 350) + "\n";
+    }
+    for (const std::string& data : { std::string(), std::string("abc"), std::string(200000, 'x'), noise, numbers }) {
+        std::string compressed = glz::compress(data.data(), data.size());
+        CHECK(glz::decompress(compressed.data(), compressed.size()) == data);
+    }
+
+    auto compiled = compile(sampleScript);
+    std::string compressedNumbers = glz::compress(numbers.data(), numbers.size());
+    TemporaryFile plainInput(numbers);
+    TemporaryFile compressedInput(compressedNumbers);
+    CHECK(spanValues(InputBuffer::load(compressedInput.path()).span()) ==
+          spanValues(InputBuffer::load(plainInput.path()).span()));
+
+    std::ostringstream plainOutput;
+    std::ostringstream compressedOutput;
+    {
+        OutputWriter plain(false, plainOutput);
+        OutputWriter compressed(true, compressedOutput);
+        for (int i = 0; i < 2000; ++i) {
+            std::string output = runEngine(compiled, EngineKind::TREE, { { i % 3, i % 2 } });
+            plain.submit(output);
+            compressed.submit(output);
+        }
+    }
+    std::string written = compressedOutput.str();
+    CHECK(glz::decompress(written.data(), written.size()) == plainOutput.str());
+
+    CHECK_THROWS(glz::decompress(compressedNumbers.data(), compressedNumbers.size() - 3), "Corrupt compressed data");
+    CHECK_THROWS(glz::decompress(numbers.data(), numbers.size()), "Missing compressed stream header");
+
+    // One literal and a match of about 255 KB, in a block that declares 16 bytes
+    std::string hostile = { static_cast<char>(0x1F), 'a', 1, 0 };
+    hostile.append(1000, static_cast<char>(255));
+    hostile.push_back(0);
+    std::string out;
+    CHECK_THROWS(glz::decompressBlock(hostile.data(), hostile.size(), 16, out), "Corrupt compressed data");
+    CHECK(out.size() <= 16);
+    hostile[0] = static_cast<char>(0xF0); // A literal run longer than the block
+    out.clear();
+    CHECK_THROWS(glz::decompressBlock(hostile.data(), hostile.size(), 16, out), "Corrupt compressed data");
+    CHECK(out.size() <= 16);
+
+    // Random damage either decodes to no more than the declared sizes or is rejected
+    for (int i = 0; i < 2000; ++i) {
+        std::string damaged = compressedNumbers;
+        for (int flips = 0; flips < 3; ++flips) {
+            damaged[random() % damaged.size()] ^= static_cast<char>(1 + random() % 255);
+        }
+        try {
+            std::string decoded = glz::decompress(damaged.data(), damaged.size());
+            CHECK(decoded.size() <= damaged.size() / 8 * glz::blockSize);
+        }
+        catch (const std::runtime_error&) {
+        }
+    }
+}
+
+// A readable dump of statements: kinds, source offsets (a statement's, then those of the
+// occurrences in its expression), names and print ids
+std::string describeStatements(const std::vector<StmtPtr>& statements);
+
+std::string describeExpression(const Expression* expression) {
+    if (auto binOp = dynamic_cast<const BinaryOperation*>(expression)) {
+        return "(" + describeExpression(binOp->left) + binaryOpText(binOp->op) + " " + describeExpression(binOp->right) + ")";
+    }
+    if (auto ident = dynamic_cast<const Identifier*>(expression)) {
+        return ident->name;
+    }
+    return std::to_string(static_cast<const Number*>(expression)->value);
+}
+
+std::string describeStatements(const std::vector<StmtPtr>& statements) {
+    std::string text;
+    for (const auto& statement : statements) {
+        text += "@" + std::to_string(statement->offset) + " ";
+        if (auto assignStmt = dynamic_cast<const AssignStatement*>(statement.get())) {
+            text += assignStmt->identifier + " = " + describeExpression(assignStmt->expression);
+        }
+        else if (auto printStmt = dynamic_cast<const PrintStatement*>(statement.get())) {
+            text += "print#" + std::to_string(printStmt->id) + " " + describeExpression(printStmt->expression);
+        }
+        else if (auto inputStmt = dynamic_cast<const InputStatement*>(statement.get())) {
+            text += "input " + inputStmt->identifier;
+        }
+        else if (auto ifStmt = dynamic_cast<const IfStatement*>(statement.get())) {
+            text += "if " + describeExpression(ifStmt->compareExpression) + " {\n" +
+                    describeStatements(ifStmt->thenStatements) + "}";
+        }
+        for (SourceOffset offset : statement->expressionOffsets) {
+            text += " @" + std::to_string(offset);
+        }
+        text += "\n";
+    }
+    return text;
+}
+
+// Incremental compilation: after every random edit, valid or not, the tokens, statements,
+// diagnostics and behaviour match compiling the edited script from scratch
+TEST(incremental_compiler) {
+    std::mt19937 random(55);
+    const std::vector<std::string> pieces = { "input(a);", "input(b);", "x=a+1;", "print(x);", "if a==b then ", "endif;",
+                                              "print(a*b);", "y=(a-b)*2;", "print(y);", " ", "\n", "zz", "1", "=", ";",
+                                              "@", "endif", "(", ")", "then", "if a then" };
+    const std::string initial = "input(a);\ninput(b);\nx=a+b;\nif a==b then\n print(x);\n y=2;\nendif;\nprint(y);\n";
+    const std::vector<int> inputs = { 3, 3, 5, 1, 2 };
+    IncrementalCompiler compiler(initial);
+    int invalid = 0;
+    for (int edit = 0; edit < 6000; ++edit) {
+        const std::string& source = compiler.source();
+        size_t offset = random() % (source.size() + 1);
+        size_t removed = std::min<size_t>(random() % 4, source.size() - offset);
+        std::string inserted = random() % 2 ? pieces[random() % pieces.size()] : "";
+        if (source.size() > 400) {
+            offset = 0;
+            removed = source.size();
+            inserted = initial;
+        }
+        const auto& diagnostics = compiler.applyEdit(offset, removed, inserted);
+
+        Lexer lexer(compiler.source());
+        TokenStream tokens = lexer.tokenize();
+        Parser parser(tokens);
+        auto program = parser.parse();
+        std::vector<Diagnostic> expected = lexer.diagnostics();
+        expected.insert(expected.end(), parser.diagnostics().begin(), parser.diagnostics().end());
+        std::stable_sort(expected.begin(), expected.end(),
+                         [](const Diagnostic& a, const Diagnostic& b) { return a.offset < b.offset; });
+        CHECK_EQ(formatDiagnostics("script", compiler.source(), diagnostics),
+                 formatDiagnostics("script", compiler.source(), expected));
+
+        tokens.pop();
+        const TokenStream& incremental = compiler.tokenStream();
+        CHECK_EQ(incremental.size(), tokens.size());
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            CHECK(incremental.kind(i) == tokens.kind(i) && incremental[i].offset == tokens[i].offset &&
+                  incremental.text(i) == tokens.text(i));
+        }
+        uint32_t nextPrintId = 0;
+        numberPrintStatements(program->statements, nextPrintId); // A print an error cut short keeps its id
+        CHECK_EQ(describeStatements(compiler.program().statements), describeStatements(program->statements));
+        if (!diagnostics.empty()) {
+            ++invalid;
+            continue;
+        }
+        std::string expectedOutput;
+        std::string output;
+        for (auto [run, out] : { std::pair<Program*, std::string*>{ program.get(), &expectedOutput }, { &compiler.program(), &output } }) {
+            Interpreter interpreter(run, { inputs.data(), inputs.size() }, *out);
+            try {
+                interpreter.interpret();
+            }
+            catch (const RuntimeError& e) {
+                *out += e.what();
+            }
+        }
+        CHECK_EQ(output, expectedOutput);
+    }
+    CHECK(invalid > 1000);
+
+    // An error stays local: statements away from it (and from later edits) are kept
+    std::string source;
+    for (int i = 0; i < 50; ++i) {
+        source += "x" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+    }
+    IncrementalCompiler local(source);
+    Statement* middle = local.program().statements[25].get();
+    CHECK_EQ(local.applyEdit(0, 0, "x = ;").size(), size_t(1));
+    CHECK_EQ(local.applyEdit(local.source().size(), 0, "print(x49)").size(), size_t(2));
+    CHECK(local.program().statements[25].get() == middle);
+    CHECK(local.applyEdit(local.source().size(), 0, ";").size() == 1);
+    CHECK(local.program().statements[25].get() == middle);
+    CHECK(local.applyEdit(0, 5, "").empty());
+    CHECK(local.program().statements[25].get() == middle);
+}
+
+// Watch mode: a changed script is compiled incrementally and published; a broken one is
+// reported and the previous version stays in service
+TEST(watch) {
+    TemporaryFile script("input(a);\nprint(a);\n", ".code");
+    ProgramSlot slot(compileScript(script.path(), readFile(script.path())));
+    ScriptWatcher watcher(slot, script.path(), readFile(script.path()));
+    ProgramSlot::Reader reader(slot);
+    auto rewrite = [&](const std::string& source) {
+        script.write(source);
+        auto now = std::filesystem::last_write_time(script.path());
+        std::filesystem::last_write_time(script.path(), now + std::chrono::seconds(1));
+    };
+    auto waitForVersion = [&](uint64_t version) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (reader.current()->version < version && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return reader.current()->version;
+    };
+
+    rewrite("input(a);\nprint(a * 2);\n");
+    CHECK_EQ(waitForVersion(1), uint64_t(1));
+    CHECK_EQ(runEngine(reader.current(), EngineKind::TREE, { { 21 } }), std::string("42\n"));
+
+    rewrite("input(a);\nprint(a * );\n");
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    CHECK_EQ(reader.current()->version, uint64_t(1));
+
+    rewrite("input(a);\nprint(a * 3);\nprint(a);\n");
+    CHECK_EQ(waitForVersion(2), uint64_t(2));
+    CHECK_EQ(runEngine(reader.current(), EngineKind::TIERED, { { 2 } }), std::string("6\n2\n"));
+}
+
+// Node pool: trees built on one thread and freed on another go back to the heap that built
+// them, whether the builder lives on (as the watcher does) or has exited (as a thread per
+// tree, or a tree freed on a short-lived thread); the chunks carved out stay bounded however
+// many trees move between threads
+TEST(node_pool) {
+    if (nodeAllocator != AllocatorKind::POOL) {
+        throw testing::Skipped("AST nodes do not come from the pool");
+    }
+    std::string script = "input(a);\nb = 1;\n";
+    for (int i = 0; i < 200; ++i) {
+        script += "b = ((a + b) * " + std::to_string(i) + ") - (b > a);\nprint(b);\n";
+    }
+    const size_t slack = 16; // Chunks for the few trees alive at once, a few times over
+
+    BoundedQueue<std::shared_ptr<const CompiledProgram>> built(2);
+    std::thread builder([&]() {
+        for (int i = 0; i < 200; ++i) {
+            built.push(compile(script));
+        }
+        built.close();
+    });
+    std::shared_ptr<const CompiledProgram> tree;
+    size_t warm = 0;
+    for (int i = 0; built.pop(tree); ++i) {
+        tree.reset();
+        if (i == 20) {
+            warm = NodePool::chunkCount();
+        }
+    }
+    builder.join();
+    CHECK(NodePool::chunkCount() <= warm + slack);
+
+    for (int i = 0; i < 200; ++i) {
+        if (i == 20) {
+            warm = NodePool::chunkCount();
+        }
+        if (i % 2) {
+            std::thread([&]() { tree = compile(script); }).join();
+            tree.reset();
+        }
+        else {
+            tree = compile(script);
+            std::thread([dropped = std::move(tree)]() mutable { dropped.reset(); }).join();
+        }
+    }
+    CHECK(NodePool::chunkCount() <= warm + slack);
+}
+
+// --alloc-stats: once an engine has run, repeated runs allocate nothing on the running
+// thread except to start a tier change
+TEST(alloc_stats) {
+    auto compiled = compile(sampleScript);
+    std::vector<int> values = { 3, 3 };
+    for (auto kind : { EngineKind::TREE, EngineKind::BASELINE, EngineKind::BYTECODE, EngineKind::TIERED }) {
+        ExecutionEngine engine(compiled, kind, OutputFormat::TEXT);
+        std::string output;
+        engine.run({ values.data(), values.size() }, output);
+        alloc_stats::Snapshot firstTierChanges = engine.tierChangeAllocations();
+        alloc_stats::Snapshot repeatAllocations = { 0, 0 };
+        bool sameOutput = true;
+        alloc_stats::enabled = true;
+        for (int run = 0; run < 20000; ++run) {
+            output.clear();
+            auto start = alloc_stats::now();
+            engine.run({ values.data(), values.size() }, output);
+            alloc_stats::accumulate(repeatAllocations, start);
+            sameOutput = sameOutput && output == "1\n44\n";
+        }
+        alloc_stats::enabled = false;
+        alloc_stats::Snapshot tierChanges = engine.tierChangeAllocations();
+        CHECK(sameOutput);
+        CHECK_EQ(repeatAllocations.count - (tierChanges.count - firstTierChanges.count), uint64_t(0));
+        CHECK_EQ(repeatAllocations.bytes - (tierChanges.bytes - firstTierChanges.bytes), uint64_t(0));
+        if (kind == EngineKind::TIERED) {
+            CHECK(tierChanges.count > firstTierChanges.count);
+        }
+    }
+}
+
+// --max-fuel and --max-output: every engine fails the same runs with the same error, and
+// the tiered engine's output table (built from runs over the limits) never changes that
+TEST(run_limits) {
+    ScopedValue<RunLimits> restoreLimits(runLimits);
+    auto compiled = compile("input(a); input(b); print(a);\n"
+                            "if a > 5 then if b > 3 then print(1); print(2); print(3); endif; endif;\n");
+    std::mt19937 random(72);
+    std::vector<std::vector<int>> inputs(20000);
+    for (auto& values : inputs) {
+        values = { static_cast<int>(random() % 21), static_cast<int>(random() % 21) };
+    }
+    for (auto limits : { RunLimits{ 0, 8, 0 }, RunLimits{ 4, 0, 0 }, RunLimits{ 0, 2, 0 } }) {
+        runLimits = limits;
+        std::string expected = runEngine(compiled, EngineKind::TREE, inputs);
+        CHECK(expected.find("limit of") != std::string::npos);
+        for (auto kind : { EngineKind::BASELINE, EngineKind::BYTECODE, EngineKind::TIERED }) {
+            CHECK_EQ(runEngine(compiled, kind, inputs), expected);
+        }
+    }
+    runLimits = RunLimits{ 0, 8, 0 };
+    CHECK_EQ(runEngine(compiled, EngineKind::TREE, { { 10, 4 } }),
+             std::string("10\n1\n2\n3\nerror: test.code:2:29: runtime error: Output limit of 8 bytes exceeded\n"));
+    CHECK(OutputTable::build(*compiled->program, { { 0, 20 }, { 0, 20 } }, OutputFormat::TEXT, 1 << 20) == nullptr);
+
+    // The state limit counts input values and variable slots (a and b) at 4 bytes each
+    runLimits = RunLimits{ 0, 0, 16 };
+    CHECK_EQ(runEngine(compiled, EngineKind::TIERED, { { 1, 2 } }), std::string("1\n"));
+    CHECK(runEngine(compiled, EngineKind::TIERED, { { 1, 2, 3 } }).find("State limit of 16 bytes") != std::string::npos);
+}
+
+// Native code generation (any host): an AArch64 branch beyond the reach of its encoding
+// makes generate() fail, so the engine keeps the bytecode instead of jumping to a wrong
+// target; x86-64 branches reach anywhere
+TEST(native_codegen) {
+    auto generates = [](const std::string& source, bool x86) {
+        auto compiled = compile(source);
+        auto bytecode = BytecodeCompiler(*compiled->program, true).compile();
+        std::vector<uint32_t> code;
+        std::vector<uint8_t> x86Code;
+        return x86 ? x86_64::CodeGenerator(*bytecode).generate(x86Code) : aarch64::CodeGenerator(*bytecode).generate(code);
+    };
+    auto ifWithPrints = [](size_t prints) {
+        std::string source = "input(a);\nif a > 5 then\n";
+        for (size_t i = 0; i < prints; ++i) {
+            source += "print(a);\n";
+        }
+        return source + "endif;\nprint(1);\n";
+    };
+    for (bool x86 : { false, true }) {
+        CHECK(generates(sampleScript, x86));
+        CHECK(generates(ifWithPrints(1000), x86));
+        CHECK_EQ(generates(ifWithPrints(70000), x86), x86);
+    }
+#if defined(__aarch64__)
+    CHECK_THROWS(ExecutionEngine(compile(ifWithPrints(70000)), EngineKind::NATIVE, OutputFormat::TEXT),
+                 NativeVM::supported() ? "too large" : "Linux host");
+#else
+    if (!NativeVM::supported()) {
+        CHECK_THROWS(ExecutionEngine(compile(sampleScript), EngineKind::NATIVE, OutputFormat::TEXT), "Linux host");
+    }
+#endif
+}
+
+// Native engine (AArch64 or x86-64 Linux; AArch64 also under qemu-user): random programs
+// give the tree interpreter's output and errors
+TEST(native) {
+    if (!NativeVM::supported()) {
+        throw testing::Skipped("the native engine needs an AArch64 or x86-64 Linux host");
+    }
+    std::mt19937 random(70);
+    for (int program = 0; program < 300; ++program) {
+        auto compiled = compile(randomScript(random));
+        checkAgainstTree(compiled, randomInputs(random, 20, 11, 20), { Backend::NATIVE });
+    }
+}
+
+// AArch64 code on any host, run by the test's emulator (which also checks that calls keep
+// the callee-saved registers): random programs, some with more values live at once than
+// there are machine registers, and run limits give the tree interpreter's output and errors
+TEST(aarch64_emulation) {
+    ScopedValue<RunLimits> restoreLimits(runLimits);
+    std::mt19937 random(70);
+    for (int program = 0; program < 300; ++program) {
+        auto compiled = compile(randomScript(random));
+        checkAgainstTree(compiled, randomInputs(random, 20, 11, 20), { Backend::EMULATED_AARCH64 });
+    }
+
+    std::string script;
+    for (char name = 'a'; name <= 'l'; ++name) {
+        script += std::string("input(") + name + ");\n";
+    }
+    script += "print(a * b + c * d - e * f + g * h - i * j + k * l);\n";
+    for (char name = 'a'; name <= 'l'; ++name) {
+        script += std::string("if ") + name + " > 3 then print(" + name + " - 1000000); endif;\n";
+    }
+    auto compiled = compile(script);
+    std::vector<std::vector<int>> inputs;
+    for (int i = 0; i < 20; ++i) {
+        inputs.emplace_back();
+        for (int j = 0; j < 12 - i % 3; ++j) {
+            inputs.back().push_back(static_cast<int>(random() % 11) - 2);
+        }
+    }
+    CHECK_EQ(runEmulatedAarch64(compiled, inputs), runEngine(compiled, EngineKind::TREE, inputs));
+    runLimits = RunLimits{ 5, 0, 0 };
+    CHECK_EQ(runEmulatedAarch64(compiled, inputs), runEngine(compiled, EngineKind::TREE, inputs));
+    runLimits = RunLimits{ 0, 20, 0 };
+    CHECK_EQ(runEmulatedAarch64(compiled, inputs), runEngine(compiled, EngineKind::TREE, inputs));
+}
+
+// WebAssembly modules: random programs validate, and run by the test's WebAssembly
+// interpreter give the tree interpreter's output and errors; with Node.js (found by CMake)
+// tests/wasm/host.js runs them too. Modules broken in each way the validator checks are
+// rejected.
+TEST(wasm) {
+    std::mt19937 random(71);
+    for (int program = 0; program < 300; ++program) {
+        TemporaryFile script(randomScript(random), ".code");
+        auto compiled = compileScript(script.path(), readFile(script.path()));
+        std::string module = wasm::ModuleEmitter(*compiled->program).emit();
+        std::vector<int> values(random() % 12);
+        for (int& value : values) {
+            value = static_cast<int>(random() % 41) - 20;
+        }
+
+        std::string expected;
+        try {
+            Interpreter interpreter(compiled->program.get(), { values.data(), values.size() }, expected);
+            interpreter.interpret();
+        }
+        catch (const std::exception& e) {
+            expected += describeError(e, *compiled) + "\n";
+        }
+        std::string actual;
+        try {
+            WasmInterpreter(module).run(values, actual);
+        }
+        catch (const RuntimeError& e) {
+            actual += describeError(e, *compiled) + "\n";
+        }
+        CHECK_EQ(actual, expected);
+#if defined(GLSL_NODE) && defined(GLSL_WASM_HOST)
+        if (program % 4 == 0) {
+            TemporaryFile moduleFile(module, ".wasm");
+            TemporaryFile input(inputText(values), ".input");
+            std::string command = std::string("\"") + GLSL_NODE + "\" \"" + GLSL_WASM_HOST + "\" " + moduleFile.path() +
+                                  " " + input.path() + " " + script.path() + " 2>&1";
+            std::string hosted;
+            FILE* pipe = popen(command.c_str(), "r");
+            CHECK(pipe != nullptr);
+            char buffer[4096];
+            while (size_t read = std::fread(buffer, 1, sizeof(buffer), pipe)) {
+                hosted.append(buffer, read);
+            }
+            pclose(pipe);
+            CHECK_EQ(hosted, expected);
+        }
+#endif
+    }
+
+    // The empty program's module with another body for run()
+    const std::string empty = wasm::ModuleEmitter(*compile("")->program).emit();
+    const std::string emptyCode("\x0A\x04\x01\x02\x00\x0B", 6);
+    auto withBody = [&](const std::string& body) {
+        std::string section;
+        wasm::appendUnsigned(section, 1);
+        wasm::appendUnsigned(section, body.size());
+        section += body;
+        std::string codeSection;
+        wasm::appendSection(codeSection, 10, section);
+        std::string module = empty;
+        return module.replace(module.find(emptyCode), emptyCode.size(), codeSection);
+    };
+    std::string output;
+    WasmInterpreter(withBody(std::string("\x01\x01\x7F\x41\x7F\x21\x00\x41\x00\x20\x00\x10\x01\x0B", 14)))
+        .run({}, output);
+    CHECK_EQ(output, "-1\n");
+    CHECK_THROWS(WasmInterpreter(empty.substr(0, empty.size() - 1)), "beyond the end");
+    CHECK_THROWS(WasmInterpreter(std::string("\0asm\2\0\0\0", 8) + empty.substr(8)), "not a version 1 module");
+    CHECK_THROWS(WasmInterpreter(withBody(std::string("\x00\x6A\x0B", 3))), "operand stack underflow");
+    CHECK_THROWS(WasmInterpreter(withBody(std::string("\x00\x41\x01\x0B", 4))), "values left over");
+    CHECK_THROWS(WasmInterpreter(withBody(std::string("\x00\x20\x00\x0B", 4))), "local index out of range");
+    CHECK_THROWS(WasmInterpreter(withBody(std::string("\x00\x41\x80\x80\x80\x80\x10\x1A\x0B", 9))),
+                 "integer too long or out of range");
+    CHECK_THROWS(WasmInterpreter(withBody(std::string("\x00\x41\x00\x41\x00\x10\x09\x0B", 8))),
+                 "function index out of range");
+    CHECK_THROWS(WasmInterpreter(withBody(std::string("\x00\x01\x0B", 3))), "opcode 0x01 is not supported");
+    CHECK_THROWS(WasmInterpreter(withBody(std::string("\x00\x41\x01\x04\x40\x0B", 6))), "without its end");
+    CHECK_THROWS(WasmInterpreter(withBody(std::string("\x00\x0B\x0B", 3))), "code after the function's end");
+}
+
+// Program bundles: scripts are found through the name index, and one batch can run several
+// (or all) scripts of a bundle, each giving the output of its own compile
+TEST(bundle) {
+    std::mt19937 random(73);
+    std::vector<std::shared_ptr<const CompiledProgram>> scripts;
+    for (int i = 0; i < 40; ++i) {
+        scripts.push_back(compileScript("script" + std::to_string(i) + ".code", randomScript(random)));
+    }
+    TemporaryFile bundleFile(program_bundle::link(scripts), ".glbn");
+    ProgramBundle bundle(bundleFile.path());
+    CHECK_EQ(bundle.size(), scripts.size());
+    std::vector<std::vector<int>> inputs = { { 1, 2, 3, 4, 5 }, { 7, 0, 0, 9, 1 }, {} };
+    for (size_t i = scripts.size(); i-- > 0;) {
+        CHECK_EQ(bundle.names()[i], scripts[i]->path);
+        auto loaded = bundle.load(scripts[i]->path);
+        CHECK_EQ(loaded->source, scripts[i]->source);
+        CHECK_EQ(runEngine(loaded, EngineKind::BYTECODE, inputs), runEngine(scripts[i], EngineKind::TREE, inputs));
+    }
+    CHECK_THROWS(bundle.load("missing.code"), "No script 'missing.code'");
+
+    // Run limits: linked bytecode charges every block, so a bundled script fails the same
+    // runs as its source; without limits the charges are dropped at load
+    auto charges = [](const std::shared_ptr<const CompiledProgram>& loaded) {
+        const auto& code = loaded->linked->code;
+        return std::count_if(code.begin(), code.end(), [](const Instruction& in) { return in.op == OpCode::CHARGE; });
+    };
+    {
+        ScopedValue<RunLimits> restoreLimits(runLimits);
+        for (auto limits : { RunLimits{ 3, 0, 0 }, RunLimits{ 0, 2, 0 } }) {
+            runLimits = limits;
+            bool limited = false;
+            for (size_t i = 0; i < scripts.size(); ++i) {
+                auto loaded = bundle.load(scripts[i]->path);
+                CHECK(charges(loaded) > 0);
+                std::string expected = runEngine(scripts[i], EngineKind::TREE, inputs);
+                limited = limited || expected.find("limit of") != std::string::npos;
+                for (auto kind : { EngineKind::BYTECODE, EngineKind::TIERED }) {
+                    CHECK_EQ(runEngine(loaded, kind, inputs), expected);
+                }
+            }
+            CHECK(limited);
+        }
+    }
+    CHECK_EQ(charges(bundle.load(scripts[0]->path)), 0);
+
+    // Command line: a batch over a list of scripts, then over all of them
+    std::vector<std::unique_ptr<TemporaryFile>> inputFiles;
+    for (const auto& values : inputs) {
+        inputFiles.push_back(std::make_unique<TemporaryFile>(inputText(values), ".input"));
+    }
+    auto batchOutput = [&](const std::string& selection) {
+        TemporaryFile output;
+        std::vector<std::string> args = { "GLSLCompiler", "--batch", "--bundle=" + bundleFile.path(),
+                                          "--output=" + output.path(), selection };
+        for (const auto& file : inputFiles) {
+            args.push_back(file->path());
+        }
+        std::vector<char*> argv;
+        for (auto& arg : args) {
+            argv.push_back(arg.data());
+        }
+        runCommandLine(static_cast<int>(argv.size()), argv.data());
+        return readFile(output.path());
+    };
+    auto expectedOutput = [&](const std::vector<size_t>& selected) {
+        std::string output;
+        for (size_t i : selected) {
+            for (const auto& values : inputs) {
+                std::string run = runEngine(scripts[i], EngineKind::TREE, { values });
+                output += run.substr(0, run.find("error: "));
+            }
+        }
+        return output;
+    };
+    CHECK_EQ(batchOutput("script3.code,script0.code,script3.code"), expectedOutput({ 3, 0, 3 }));
+    std::vector<size_t> all(scripts.size());
+    std::iota(all.begin(), all.end(), 0);
+    CHECK_EQ(batchOutput("*"), expectedOutput(all));
+}
+
+// Run the command line in process; returns its exit status
+int runCommandLine(std::vector<std::string> args) {
+    args.insert(args.begin(), "GLSLCompiler");
+    std::vector<char*> argv;
+    for (auto& arg : args) {
+        argv.push_back(arg.data());
+    }
+    return runCommandLine(static_cast<int>(argv.size()), argv.data());
+}
+
+// Command line: script, input and output paths, every engine and optimization level, and
+// input streamed from standard input ("-")
+TEST(command_line) {
+    TemporaryFile script(sampleScript, ".code");
+    TemporaryFile input(inputText({ 3, 3 }), ".input");
+    TemporaryFile output;
+    for (const char* engine : { "-O0", "-O1", "-O2", "--engine=tree", "--engine=baseline", "--engine=bytecode",
+                                "--engine=tiered" }) {
+        CHECK_EQ(runCommandLine({ engine, "--output=" + output.path(), script.path(), input.path() }), 0);
+        CHECK_EQ(readFile(output.path()), std::string("1\n44\n"));
+    }
+
+    // A failing run, a missing input file and extra arguments exit with status 1
+    TemporaryFile shortInput(inputText({ 3 }), ".input");
+    CHECK_EQ(runCommandLine({ "--output=" + output.path(), script.path(), shortInput.path() }), 1);
+    CHECK_EQ(readFile(output.path()), std::string(""));
+    CHECK_EQ(runCommandLine({ "--output=" + output.path(), script.path(), "missing.input" }), 1);
+    CHECK_EQ(runCommandLine({ script.path(), input.path(), "extra.input" }), 1);
+
+    // Batch-only options are rejected without --batch rather than ignored
+    CHECK_EQ(runCommandLine({ "--watch", script.path(), input.path() }), 1);
+    CHECK_EQ(runCommandLine({ "--result-cache=1", script.path(), input.path() }), 1);
+
+    // Standard input: values are read as input statements need them
+    TemporaryFile streamed("4\n5\n", ".input");
+    CHECK(std::freopen(streamed.path().c_str(), "rb", stdin) != nullptr);
+    CHECK_EQ(runCommandLine({ "--output=" + output.path(), script.path(), "-" }), 0);
+    CHECK_EQ(readFile(output.path()), std::string("0\n44\n"));
+}
+
+// Record mode: every engine gives the tree interpreter's output and errors record by
+// record, and an incomplete last record is reported after the complete ones have run
+TEST(records) {
+    auto runRecordFile = [](const std::shared_ptr<const CompiledProgram>& compiled, const std::string& path,
+                            size_t recordSize, EngineKind kind, RunStats* stats = nullptr) {
+        std::ostringstream output;
+        std::ostringstream errors;
+        auto* savedErrors = std::cerr.rdbuf(errors.rdbuf());
+        int status;
+        {
+            OutputWriter writer(false, output);
+            status = runRecords(compiled, path, recordSize, kind, OutputFormat::TEXT, writer, stats);
+        }
+        std::cerr.rdbuf(savedErrors);
+        return std::to_string(status) + "\n" + output.str() + errors.str();
+    };
+
+    std::mt19937 random(75);
+    for (int program = 0; program < 20; ++program) {
+        auto compiled = compile(program == 0 ? std::string(sampleScript) : randomScript(random));
+        size_t recordSize = 1 + random() % 5;
+        std::vector<int> values(recordSize * (1000 + random() % 3000));
+        for (int& value : values) {
+            value = static_cast<int>(random() % 21) - 5;
+        }
+        TemporaryFile input(inputText(values), ".input");
+        std::string expected = runRecordFile(compiled, input.path(), recordSize, EngineKind::TREE);
+        for (auto kind : { EngineKind::BASELINE, EngineKind::BYTECODE, EngineKind::TIERED }) {
+            CHECK_EQ(runRecordFile(compiled, input.path(), recordSize, kind), expected);
+        }
+    }
+
+    auto compiled = compile(sampleScript);
+    TemporaryFile input(inputText({ 1, 1, 2, 3, 4 }), ".input");
+    RunStats stats;
+    CHECK_EQ(runRecordFile(compiled, input.path(), 2, EngineKind::TIERED, &stats),
+             std::string("1\n1\n44\n0\n44\nIncomplete record at the end of the input: 1 of 2 values\n"));
+    CHECK_EQ(stats.runs, uint64_t(2));
+}
+
+// The diagnostics of a script that does not compile ("" when it compiles)
+std::string compileErrors(const std::string& source) {
+    try {
+        compile(source);
+    }
+    catch (const std::exception& e) {
+        return e.what();
+    }
+    return "";
+}
+
+// Error recovery: one compile reports every lexical and syntax error, each at its location,
+// and statements after an error are still checked
+TEST(diagnostics) {
+    CHECK_EQ(compileErrors(sampleScript), std::string(""));
+    CHECK_EQ(compileErrors("input(a);\n"
+                           "b = a + ;\n"
+                           "print(a;\n"
+                           "if a > 1 then\n"
+                           "  print(@);\n"
+                           "endif;\n"
+                           "x = 3\n"
+                           "print(x);\n"
+                           "endif;\n"
+                           "print(a);\n"),
+             std::string("test.code:2:9: error: Expected an expression but found ';'\n"
+                         "test.code:3:8: error: Expected ')' but found ';'\n"
+                         "test.code:5:9: error: Unexpected character: @\n"
+                         "test.code:5:10: error: Expected an expression but found ')'\n"
+                         "test.code:8:1: error: Expected ';' but found 'print'\n"
+                         "test.code:9:1: error: Expected a statement but found 'endif'"));
+    CHECK_EQ(compileErrors("input(a);\nif a then\nprint(a);\n"),
+             std::string("test.code:4:1: error: Expected 'endif' but found end of file"));
+    CHECK_EQ(compileErrors("print(1) print(2);\n99999999999;\n"),
+             std::string("test.code:1:10: error: Expected ';' but found 'print'\n"
+                         "test.code:2:1: error: Expected a statement but found '99999999999'"));
+
+    // Every error of a long script is reported, however many there are
+    std::string source;
+    for (int i = 0; i < 500; ++i) {
+        source += "a = (1 + ;\nprint(a);\n";
+    }
+    std::string errors = compileErrors(source);
+    CHECK_EQ(static_cast<size_t>(std::count(errors.begin(), errors.end(), '\n')) + 1, size_t(500));
+    CHECK(errors.rfind("test.code:999:10: error: Expected an expression but found ';'") != std::string::npos);
+}
+
+// Source locations: 32-bit offsets on tokens and nodes map to line and column through the
+// LineTable, and every engine reports a run time error at the same place
+TEST(source_locations) {
+    std::string text = "ab\ncd\n\nx";
+    LineTable lines(text);
+    CHECK(lines.locate(0) == std::make_pair(1u, 1u));
+    CHECK(lines.locate(2) == std::make_pair(1u, 3u));
+    CHECK(lines.locate(3) == std::make_pair(2u, 1u));
+    CHECK(lines.locate(6) == std::make_pair(3u, 1u));
+    CHECK(lines.locate(7) == std::make_pair(4u, 1u));
+    CHECK_EQ(lines.describe("f.code", 4), std::string("f.code:2:2"));
+
+    // A statement starts at its first token; the occurrences in its expression are located in
+    // evaluation order, a binary operation at its operator
+    auto compiled = compile("input(a);\n  b = a * 2;\nif b > 4 then\n  print(c + 1);\nendif;\n");
+    const auto& statements = compiled->program->statements;
+    auto assign = dynamic_cast<const AssignStatement*>(statements[1].get());
+    CHECK(assign != nullptr);
+    CHECK_EQ(assign->offset, SourceOffset(12));
+    CHECK(assign->expressionOffsets == std::vector<SourceOffset>({ 16, 20, 18 }));
+    auto ifStmt = dynamic_cast<const IfStatement*>(statements[2].get());
+    CHECK(ifStmt != nullptr);
+    CHECK_EQ(ifStmt->offset, SourceOffset(23));
+    CHECK_EQ(ifStmt->thenStatements[0]->offset, SourceOffset(39));
+
+    std::string expected = "error: test.code:4:9: runtime error: Undefined variable 'c'\n"
+                           "error: test.code:1:1: runtime error: Not enough input values for input(a)\n";
+    for (auto kind : { EngineKind::TREE, EngineKind::BASELINE, EngineKind::BYTECODE, EngineKind::TIERED }) {
+        CHECK_EQ(runEngine(compiled, kind, { { 3 }, { 1 }, {} }), expected);
+    }
+}
+
+// Packed tokens: kinds, offsets and lengths are stored apart and a token's text is read back
+// from the source; a token that does not fit the 24-bit length is reported
+TEST(tokens) {
+    std::string source = "if a1>=10 then\n  print(a1 * 2);\nendif;";
+    Lexer lexer(source);
+    TokenStream tokens = lexer.tokenize();
+    CHECK(lexer.diagnostics().empty());
+    std::vector<TokenType> kinds = {
+        TokenType::IF, TokenType::IDENTIFIER, TokenType::COMPARE_OP, TokenType::NUMBER, TokenType::THEN,
+        TokenType::PRINT, TokenType::LPAREN, TokenType::IDENTIFIER, TokenType::CALCULATE_OP, TokenType::NUMBER,
+        TokenType::RPAREN, TokenType::SEMICOLON, TokenType::ENDIF, TokenType::SEMICOLON, TokenType::END
+    };
+    std::vector<std::string> texts = { "if", "a1", ">=", "10", "then", "print", "(", "a1", "*", "2", ")", ";", "endif", ";", "" };
+    CHECK_EQ(tokens.size(), kinds.size());
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        CHECK(tokens.kind(i) == kinds[i]);
+        CHECK(tokens[i].type() == kinds[i]);
+        CHECK_EQ(std::string(tokens.text(i)), texts[i]);
+    }
+    CHECK_EQ(tokens[5].offset, SourceOffset(17));
+    CHECK_EQ(tokens[tokens.size() - 1].offset, SourceOffset(source.size()));
+
+    // Lexing a range of the source keeps offsets into the whole source
+    Lexer range(source, 17, 31);
+    TokenStream rangeTokens = range.tokenize();
+    CHECK_EQ(rangeTokens.size(), size_t(8));
+    CHECK_EQ(rangeTokens[0].offset, SourceOffset(17));
+    CHECK_EQ(std::string(rangeTokens.text(6)), std::string(";"));
+    CHECK_EQ(rangeTokens[7].offset, SourceOffset(31));
+
+    std::string longName(size_t(Token::maxLength) + 1, 'x');
+    CHECK_EQ(compileErrors("a = 1;\n" + longName + " = 2;\nprint(a);\n"), std::string("test.code:2:1: error: Token too long\n"
+                         "test.code:2:16777218: error: Expected a statement but found '='"));
+}
+
+// Hot swap: workers keep running while new snapshots are published. Every run uses one
+// whole snapshot, workers never go back to an older version, and all of them reach the
+// last one
+TEST(hot_swap) {
+    constexpr uint64_t versions = 200;
+    std::vector<std::shared_ptr<const CompiledProgram>> snapshots;
+    for (uint64_t version = 0; version <= versions; ++version) {
+        auto compiled = compileScript("test.code", "input(a);\nb = a + " + std::to_string(version) + ";\nprint(b);\n");
+        compiled->version = version;
+        snapshots.push_back(compiled);
+    }
+    ProgramSlot slot(snapshots[0]);
+    std::atomic<uint64_t> mismatches{ 0 };
+    std::atomic<uint64_t> regressions{ 0 };
+    std::vector<std::thread> workers;
+    for (int worker = 0; worker < 4; ++worker) {
+        workers.emplace_back([&, worker]() {
+            ProgramSlot::Reader reader(slot);
+            std::unique_ptr<ExecutionEngine> engine;
+            uint64_t lastVersion = 0;
+            for (int value = worker; lastVersion < versions; ++value) {
+                std::shared_ptr<const CompiledProgram> compiled = reader.current();
+                if (!engine || engine->program() != compiled) {
+                    engine = std::make_unique<ExecutionEngine>(compiled, EngineKind::TIERED, OutputFormat::TEXT);
+                }
+                std::string output;
+                engine->run({ &value, 1 }, output);
+                if (output != std::to_string(value + static_cast<int>(compiled->version)) + "\n") {
+                    ++mismatches;
+                }
+                if (compiled->version < lastVersion) {
+                    ++regressions;
+                }
+                lastVersion = compiled->version;
+            }
+        });
+    }
+    for (uint64_t version = 1; version <= versions; ++version) {
+        slot.publish(snapshots[version]);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    CHECK_EQ(mismatches.load(), uint64_t(0));
+    CHECK_EQ(regressions.load(), uint64_t(0));
+    CHECK_EQ(ProgramSlot::Reader(slot).current()->version, versions);
+}
+
+// Run a program on a tiered engine, one run per input vector in turn (cycling), until it
+// has reached minTier and run `after` more times; every run's output and error must match
+// the tree interpreter
+void runTiered(ExecutionEngine& tiered, const std::vector<std::vector<int>>& inputs, int minTier, size_t after) {
+    const auto& compiled = tiered.program();
+    ExecutionEngine tree(compiled, EngineKind::TREE, OutputFormat::TEXT);
+    auto run = [&](ExecutionEngine& engine, const std::vector<int>& values) {
+        std::string output;
+        try {
+            engine.run({ values.data(), values.size() }, output);
+        }
+        catch (const std::exception& e) {
+            output += "error: " + describeError(e, *compiled) + "\n";
+        }
+        return output;
+    };
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    size_t remaining = after;
+    for (size_t i = 0; remaining > 0 && std::chrono::steady_clock::now() < deadline; ++i) {
+        const auto& values = inputs[i % inputs.size()];
+        CHECK_EQ(run(tiered, values), run(tree, values));
+        if (tiered.tier() >= minTier) {
+            --remaining;
+        }
+    }
+    CHECK(tiered.tier() >= minTier);
+}
+
+// Tiered execution: random programs give the tree interpreter's output and errors in every
+// tier they pass through, up to the optimizing bytecode (and the native code it is promoted
+// to on hosts that run it)
+TEST(tiers) {
+    std::mt19937 random(61);
+    for (int program = 0; program < 30; ++program) {
+        auto compiled = compile(randomScript(random));
+        auto inputs = randomInputs(random, 1 + random() % 40, 11, 20);
+        ExecutionEngine tiered(compiled, EngineKind::TIERED, OutputFormat::TEXT);
+        runTiered(tiered, inputs, 2, 2000);
+    }
+}
+
+// Speculation: the optimizing tier specializes on input values that stayed the same; a
+// different value deoptimizes the run, which is redone in the baseline tier with the same
+// result and profiled afresh from there. After maxDeoptimizations the optimizing tier no
+// longer speculates.
+TEST(deoptimization) {
+    auto compiled = compile("input(a);\ninput(b);\nif a == 3 then\n  print(b * 2);\nendif;\nprint(a + b);\n");
+    ExecutionEngine tiered(compiled, EngineKind::TIERED, OutputFormat::TEXT);
+    const uint64_t maxDeoptimizations = ExecutionEngine::maxDeoptimizations;
+    for (uint64_t round = 1; round <= maxDeoptimizations + 2; ++round) {
+        // a stays the same while b spans too wide a range for an output table, so the runs
+        // stay in the bytecode tiers; then a changes (and stays at its new value next round)
+        int a = round % 2 ? 3 : 4;
+        std::vector<std::vector<int>> stable;
+        for (int i = 0; i < 10; ++i) {
+            stable.push_back({ a, i * 1000003 });
+        }
+        runTiered(tiered, stable, 2, 500);
+        CHECK_EQ(tiered.deoptimizations(), std::min(round - 1, maxDeoptimizations));
+        runTiered(tiered, { { 7 - a, 5 } }, 0, 1);
+        CHECK_EQ(tiered.deoptimizations(), std::min(round, maxDeoptimizations));
+    }
+}
+
+// Native tier (AArch64 or x86-64 Linux): a tiered engine promotes the optimized bytecode,
+// speculation included, to native code. A changed input value then fails the guard in the
+// machine code: the run is redone in the baseline tier with the same result, and the program
+// is promoted again later. The native engine never speculates.
+TEST(native_tier) {
+    if (!NativeVM::supported()) {
+        throw testing::Skipped("the native tier needs an AArch64 or x86-64 Linux host");
+    }
+    auto compiled = compile("input(a);\ninput(b);\nif a == 3 then\n  print(b * 2);\nendif;\nprint(a + b);\n");
+    ExecutionEngine tiered(compiled, EngineKind::TIERED, OutputFormat::TEXT);
+    for (uint64_t round = 1; round <= 3; ++round) {
+        int a = round % 2 ? 3 : 4;
+        std::vector<std::vector<int>> stable;
+        for (int i = 0; i < 10; ++i) {
+            stable.push_back({ a, i * 1000003 });
+        }
+        runTiered(tiered, stable, 4, 50);
+        CHECK_EQ(tiered.deoptimizations(), round - 1);
+        runTiered(tiered, { { 7 - a, 5 } }, 0, 1);
+        CHECK_EQ(tiered.deoptimizations(), round);
+        CHECK_EQ(tiered.tier(), 1);
+    }
+
+    ExecutionEngine native(compiled, EngineKind::NATIVE, OutputFormat::TEXT);
+    runTiered(native, { { 3, 1 }, { 3, 2 }, { 4, 5 } }, 4, 30);
+    CHECK_EQ(native.deoptimizations(), uint64_t(0));
+}
+
+// Partial evaluation: for random programs and fixed input prefixes, the residual script on
+// the remaining input prints what the program prints on the whole input, and fails with the
+// same error (at a location of its own)
+TEST(partial_eval) {
+    auto runText = [](const std::shared_ptr<const CompiledProgram>& compiled, const std::vector<int>& values) {
+        std::string output;
+        try {
+            Interpreter interpreter(compiled->program.get(), { values.data(), values.size() }, output);
+            interpreter.interpret();
+        }
+        catch (const std::exception& e) {
+            output += std::string("error: ") + e.what() + "\n";
+        }
+        return output;
+    };
+    std::mt19937 random(63);
+    int residuals = 0;
+    for (int program = 0; program < 300; ++program) {
+        auto compiled = compile(randomScript(random));
+        std::vector<int> fixed(random() % 6);
+        for (int& value : fixed) {
+            value = static_cast<int>(random() % 21) - 5;
+        }
+        std::string residualSource;
+        try {
+            residualSource = PartialEvaluator(*compiled, fixed).residualSource();
+        }
+        catch (const std::runtime_error&) {
+            continue; // An input statement may or may not read a fixed value
+        }
+        ++residuals;
+        auto residual = compile(residualSource);
+        for (int run = 0; run < 20; ++run) {
+            std::vector<int> rest(random() % 8);
+            for (int& value : rest) {
+                value = static_cast<int>(random() % 21) - 5;
+            }
+            std::vector<int> whole = fixed;
+            whole.insert(whole.end(), rest.begin(), rest.end());
+            CHECK_EQ(runText(residual, rest), runText(compiled, whole));
+        }
+    }
+    CHECK(residuals > 200);
+
+    auto sample = compile(sampleScript);
+    CHECK_EQ(PartialEvaluator(*sample, { 3, 3 }).residualSource(), std::string("print(1);\nprint(44);\n"));
+    CHECK_EQ(PartialEvaluator(*sample, { 3 }).residualSource(),
+             std::string("input(b);\nif (3 == b) then\n    print(1);\nendif;\nif (3 != b) then\n    print(0);\nendif;\nprint(44);\n"));
+}
+
+// Result cache: a batch answered from the cache prints what the engines print without it, and
+// the cache stays within its budget, evicting entries that were not hit since the last sweep
+TEST(result_cache) {
+    auto compiled = compile(sampleScript);
+    std::vector<std::vector<int>> inputs;
+    for (int i = 0; i < 40; ++i) {
+        inputs.push_back({ i % 4, i % 3 });
+    }
+    inputs.push_back({ 7 }); // Failing runs are not recorded
+    inputs.push_back({ 7 });
+
+    std::deque<TemporaryFile> files;
+    std::vector<std::string> paths;
+    for (const auto& values : inputs) {
+        paths.push_back(files.emplace_back(inputText(values)).path());
+    }
+
+    ProgramSlot slot(compiled);
+    for (auto kind : { EngineKind::TREE, EngineKind::BYTECODE, EngineKind::TIERED }) {
+        std::ostringstream uncached;
+        std::ostringstream cached;
+        ResultCache cache(1 << 20);
+        {
+            OutputWriter writer(false, uncached);
+            CHECK_EQ(runBatch(slot, paths, EngineKind::TREE, OutputFormat::TEXT, writer), 1);
+        }
+        {
+            OutputWriter writer(false, cached);
+            CHECK_EQ(runBatch(slot, paths, kind, OutputFormat::TEXT, writer, nullptr, &cache), 1);
+        }
+        CHECK_EQ(cached.str(), uncached.str());
+        CHECK_EQ(cache.metrics().hits, uint64_t(28));
+        CHECK_EQ(cache.metrics().misses, uint64_t(14));
+        CHECK_EQ(cache.metrics().entries, size_t(12));
+    }
+
+    // Room for two entries: a hit gives an entry a second chance when a third one comes in
+    const std::vector<int> a = { 1, 1 }, b = { 1, 2 }, c = { 2, 2 };
+    const std::string output = "1\n44\n";
+    ResultCache probe(1 << 20);
+    probe.insert(1, { a.data(), a.size() }, output);
+    CHECK_EQ(probe.metrics().bytes, ResultCache::entryOverhead() + a.size() * sizeof(int) + output.size());
+    ResultCache cache(probe.metrics().bytes * 2);
+    cache.insert(1, { a.data(), a.size() }, output);
+    cache.insert(1, { b.data(), b.size() }, output);
+    std::string found;
+    CHECK(cache.lookup(1, { a.data(), a.size() }, found));
+    CHECK_EQ(found, output);
+    CHECK(!cache.lookup(2, { a.data(), a.size() }, found)); // Another program
+    cache.insert(1, { c.data(), c.size() }, output);
+    CHECK_EQ(cache.metrics().evictions, uint64_t(1));
+    CHECK_EQ(cache.metrics().entries, size_t(2));
+    CHECK(cache.metrics().bytes <= probe.metrics().bytes * 2);
+    found.clear();
+    CHECK(cache.lookup(1, { a.data(), a.size() }, found));
+    CHECK(!cache.lookup(1, { b.data(), b.size() }, found));
+    CHECK(cache.lookup(1, { c.data(), c.size() }, found));
+    CHECK_EQ(found, output + output);
+}
+
+// Output tables: every entry of a table holds the tree interpreter's output for its input
+// vector, runs that fail or fall outside the domain are not answered, and a tiered engine
+// fed a small domain moves up to the table (tier 3) with the same results, while the cost
+// model keeps one fed a wide domain in the execution tiers
+TEST(output_tables) {
+    std::mt19937 random(65);
+    int tables = 0;
+    for (int program = 0; program < 100; ++program) {
+        auto compiled = compile(randomScript(random));
+        size_t inputCount = maxInputsRead(compiled->program->statements);
+        if (inputCount > 6) {
+            continue;
+        }
+        int bound = inputCount > 4 ? 1 : 2;
+        std::vector<OutputTable::Range> domain(inputCount, { -bound, bound });
+        auto table = OutputTable::build(*compiled->program, domain, OutputFormat::TEXT, size_t(1) << 20);
+        CHECK(table != nullptr);
+        CHECK_EQ(table->entryCount(), OutputTable::domainSize(domain));
+        ++tables;
+        std::vector<int> values(inputCount, -bound);
+        for (size_t entry = 0; entry < table->entryCount(); ++entry) {
+            std::string expected = runEngine(compiled, EngineKind::TREE, { values });
+            std::string output;
+            bool found = table->lookup({ values.data(), values.size() }, output);
+            CHECK_EQ(found, expected.find("error: ") == std::string::npos);
+            if (found) {
+                CHECK_EQ(output, expected);
+            }
+            for (size_t i = values.size(); i-- > 0;) {
+                if (values[i] < bound) {
+                    ++values[i];
+                    break;
+                }
+                values[i] = -bound;
+            }
+        }
+        if (inputCount > 0) {
+            std::string output;
+            values[0] = bound + 1;
+            CHECK(!table->lookup({ values.data(), values.size() }, output));
+            values.pop_back();
+            CHECK(!table->lookup({ values.data(), values.size() }, output));
+        }
+    }
+    CHECK(tables > 50);
+
+    auto compiled = compile(sampleScript);
+    std::vector<std::vector<int>> inputs;
+    for (int i = 0; i < 12; ++i) {
+        inputs.push_back({ i % 4, i % 3 });
+    }
+    inputs.push_back({ 7 }); // Fails, so it is never answered from the table
+    ExecutionEngine tiered(compiled, EngineKind::TIERED, OutputFormat::TEXT);
+    runTiered(tiered, inputs, 3, 200);
+
+    // A table of 40000 entries does not pay off for 2000 runs (and would be ready well
+    // within the pause, were it built)
+    ExecutionEngine wide(compiled, EngineKind::TIERED, OutputFormat::TEXT);
+    for (int i = 0; i < 2010; ++i) {
+        if (i == 2000) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        }
+        std::vector<int> values = { i * 7 % 200, i * 13 % 200 };
+        std::string output;
+        wide.run({ values.data(), values.size() }, output);
+        CHECK(wide.tier() != 3);
+    }
+}
+
+// Shared expressions: the parser hash-conses expression nodes, so structurally identical
+// subexpressions anywhere in a program, or parsed into it by an incremental edit, are one
+// node, while each statement keeps the source offsets of its own occurrences. The optimizing
+// compiler computes a repeated subexpression once, until one of its variables is assigned;
+// programs that repeat subexpressions around assignments give the tree interpreter's
+// results in the bytecode tiers, which reuse the values.
+TEST(shared_expressions) {
+    auto compiled = compile("input(a);\ninput(b);\nc = (a * b) + 1;\nd = (a * b) + 1;\nprint(b * a);\n");
+    const auto& statements = compiled->program->statements;
+    auto assigned = [&](size_t i) { return static_cast<const AssignStatement*>(statements[i].get())->expression; };
+    CHECK(assigned(2) == assigned(3));
+    CHECK_EQ(compiled->program->expressions.size(), size_t(6)); // a, b, a * b, 1, (a * b) + 1 and b * a
+    auto product = static_cast<const BinaryOperation*>(static_cast<const BinaryOperation*>(assigned(2))->left);
+    auto print = static_cast<const BinaryOperation*>(static_cast<const PrintStatement*>(statements[4].get())->expression);
+    CHECK(print != product); // Operands are not reordered
+    CHECK(print->left == product->right && print->right == product->left);
+
+    // A script repeating its expressions keeps far fewer nodes than it has occurrences
+    std::string script = "input(a);\ninput(b);\n";
+    for (int i = 0; i < 100; ++i) {
+        script += "c = (a * b + 1) * (a - b);\nprint(c + (a * b + 1));\n";
+    }
+    auto shared = compile(script);
+    size_t occurrences = 0;
+    for (const auto& statement : shared->program->statements) {
+        occurrences += statement->expressionOffsets.size();
+    }
+    CHECK_EQ(occurrences, size_t(1600));
+    CHECK_EQ(shared->program->expressions.size(), size_t(9));
+
+    // Each occurrence keeps its own location: a shared expression fails at the statement
+    // being run, in every engine
+    auto undefined = compile("input(a);\nif a > 1 then\n  print(a + b);\nendif;\nprint(a + b);\n");
+    auto ifStmt = static_cast<const IfStatement*>(undefined->program->statements[1].get());
+    CHECK(static_cast<const PrintStatement*>(ifStmt->thenStatements[0].get())->expression ==
+          static_cast<const PrintStatement*>(undefined->program->statements[2].get())->expression);
+    for (auto kind : { EngineKind::TREE, EngineKind::BASELINE, EngineKind::BYTECODE, EngineKind::TIERED }) {
+        CHECK_EQ(runEngine(undefined, kind, { { 2 }, { 1 } }),
+                 std::string("error: test.code:3:13: runtime error: Undefined variable 'b'\n"
+                             "error: test.code:5:11: runtime error: Undefined variable 'b'\n"));
+    }
+
+    // Edits parse into the program's table and move the offsets of the statements after them
+    IncrementalCompiler incremental("input(a);\nprint(a + b);\n");
+    auto printed = [&](size_t i) { return static_cast<const PrintStatement*>(incremental.program().statements[i].get()); };
+    const Expression* sum = printed(1)->expression;
+    incremental.applyEdit(10, 0, "x = a + b;\n");
+    CHECK(static_cast<const AssignStatement*>(incremental.program().statements[1].get())->expression == sum);
+    CHECK(printed(2)->expression == sum);
+    CHECK_EQ(readOffset(printed(2), 1), SourceOffset(31));
+    incremental.applyEdit(0, 0, "\n\n");
+    CHECK_EQ(readOffset(printed(2), 1), SourceOffset(33));
+
+    // The expressions of replaced statements do not pile up in the table
+    for (int edit = 0; edit < 2000; ++edit) {
+        std::string value = std::to_string(edit);
+        std::string statement = "y = a * " + value + " + " + value + ";\n";
+        incremental.applyEdit(0, 0, statement);
+        incremental.applyEdit(0, statement.size(), "");
+    }
+    CHECK_EQ(incremental.program().statements.size(), size_t(3));
+    CHECK(incremental.program().expressions.size() < 1000);
+    CHECK_EQ(readOffset(printed(2), 1), SourceOffset(33));
+
+    // The multiplications left in the optimized bytecode
+    auto multiplies = [](const std::string& script) {
+        auto compiled = compile(script);
+        auto bytecode = BytecodeCompiler(*compiled->program, true).compile();
+        return static_cast<int>(std::count_if(bytecode->code.begin(), bytecode->code.end(),
+                                              [](const Instruction& in) { return in.op == OpCode::MULTIPLY; }));
+    };
+    CHECK_EQ(multiplies("input(a);\ninput(b);\nprint((a * b) + (a * b));\n"), 1);
+    CHECK_EQ(multiplies("input(a);\ninput(b);\nc = a * b;\nprint((a * b) + c);\n"), 1);
+    CHECK_EQ(multiplies("input(a);\ninput(b);\nc = a * b;\ninput(a);\nprint(a * b);\n"), 2);
+    CHECK_EQ(multiplies("input(a);\ninput(b);\nc = a * b;\nif a > b then\n  b = a;\nendif;\nprint(a * b);\n"), 2);
+    CHECK_EQ(multiplies("input(a);\ninput(b);\nif a > b then\n  print(a * b);\nendif;\nprint(a * b);\n"), 2);
+    CHECK_EQ(multiplies("input(a);\ninput(b);\nc = a * b;\nif a > b then\n  print(a * b);\nendif;\nprint(a * b);\n"), 1);
+    CHECK_EQ(multiplies("input(a);\ninput(b);\na = a * b;\nprint(a * b);\n"), 2);
+
+    auto repeated = compile("input(a);\ninput(b);\nprint((a * b) + (a * b));\nprint(a * b);\n");
+    CHECK(BytecodeCompiler(*repeated->program, true).compile()->code.size() <
+          BytecodeCompiler(*repeated->program, false).compile()->code.size());
+
+    // Random programs drawing their expressions from a small pool, so they repeat
+    std::mt19937 random(66);
+    for (int program = 0; program < 200; ++program) {
+        ScriptShape shape;
+        shape.pooledExpressions = 4;
+        auto compiled = compile(randomScript(random, shape));
+        checkAgainstTree(compiled, randomInputs(random, 5, 6, 5),
+                         { Backend::BASELINE, Backend::BYTECODE, Backend::NATIVE, Backend::EMULATED_AARCH64 });
+    }
+}
+
+// Reactive evaluation: after every change of an input value, the prints reported so far
+// (with their changes applied) are what a full run of the tree interpreter prints, and the
+// error is the same when it fails; a run after a failing one starts over. A change only
+// reports prints that appear, disappear or print another value.
+TEST(reactive) {
+    std::mt19937 random(67);
+    for (int program = 0; program < 200; ++program) {
+        auto compiled = compile(randomScript(random));
+        std::vector<int> inputs(random() % 8);
+        for (int& value : inputs) {
+            value = static_cast<int>(random() % 7) - 3;
+        }
+        ReactiveEvaluator evaluator(*compiled, inputs);
+        std::map<uint32_t, int> prints;
+        for (int update = 0; update < 30; ++update) {
+            std::string output;
+            std::vector<ReactiveEvaluator::PrintChange> changes;
+            try {
+                changes = evaluator.run();
+            }
+            catch (const std::exception& e) {
+                output = "error: " + describeError(e, *compiled) + "\n";
+            }
+            for (const auto& change : changes) {
+                auto reported = prints.find(change.id);
+                CHECK(change.present ? reported == prints.end() || reported->second != change.value
+                                     : reported != prints.end());
+                if (change.present) {
+                    prints[change.id] = change.value;
+                }
+                else {
+                    prints.erase(change.id);
+                }
+            }
+            if (output.empty()) {
+                for (const auto& print : prints) {
+                    output += std::to_string(print.second) + "\n";
+                }
+            }
+            std::string expected = runEngine(compiled, EngineKind::TREE, { inputs });
+            if (expected.find("error: ") != std::string::npos) {
+                expected = expected.substr(expected.find("error: "));
+            }
+            CHECK_EQ(output, expected);
+
+            size_t index = random() % (inputs.size() + 1);
+            int value = static_cast<int>(random() % 7) - 3;
+            evaluator.setInput(index, value);
+            (index == inputs.size() ? inputs.emplace_back() : inputs[index]) = value;
+        }
+    }
+
+    // A change only re-evaluates the statements that depend on it
+    auto compiled = compile("input(a);\ninput(b);\nc = a * 2;\nprint(c);\nif b > 0 then\n  print(b);\nendif;\n");
+    ReactiveEvaluator evaluator(*compiled, { 1, 2 });
+    CHECK_EQ(evaluator.run().size(), size_t(2));
+    uint64_t evaluated = evaluator.statementsEvaluated();
+    evaluator.setInput(1, 3);
+    auto changes = evaluator.run();
+    CHECK_EQ(changes.size(), size_t(1));
+    CHECK(changes[0].id == 1 && changes[0].present && changes[0].value == 3);
+    CHECK_EQ(evaluator.statementsEvaluated() - evaluated, uint64_t(2)); // The if and print(b)
+    evaluator.setInput(1, 0);
+    changes = evaluator.run();
+    CHECK(changes.size() == 1 && changes[0].id == 1 && !changes[0].present);
+    CHECK_THROWS(evaluator.setInput(3, 0), "past the end of the input");
+
+    // A failing run retracts print(a) before it stops, so the run after it clears it again
+    compiled = compile("input(a);\nif a > 0 then\n  c = 1;\n  print(a);\nendif;\nif a == 0 then\n  print(c);\nendif;\nprint(a);\n");
+    ReactiveEvaluator restarted(*compiled, { 1 });
+    CHECK_EQ(restarted.run().size(), size_t(2));
+    restarted.setInput(0, 0);
+    CHECK_THROWS(restarted.run(), "Undefined variable 'c'");
+    restarted.setInput(0, -1);
+    std::map<uint32_t, int> prints = { { 0, 1 }, { 2, 1 } };
+    for (const auto& change : restarted.run()) {
+        if (change.present) {
+            prints[change.id] = change.value;
+        }
+        else {
+            prints.erase(change.id);
+        }
+    }
+    CHECK(prints == (std::map<uint32_t, int>{ { 2, -1 } }));
+}
+
+// Whether an assignment keeps apart every two registers (from first on) whose values are
+// needed at once: a register written while another one is live, by liveness worked out
+// instruction by instruction, must not share its machine register or spill slot
+bool respectsInterference(const Bytecode& bytecode, const RegisterAssignment& assignment, uint32_t first) {
+    const size_t count = bytecode.code.size();
+    auto successors = [&](size_t pc) {
+        const Instruction& in = bytecode.code[pc];
+        std::vector<size_t> next;
+        if (in.op == OpCode::JUMP || isConditionalJump(in.op)) {
+            next.push_back(static_cast<size_t>(in.a));
+        }
+        if (in.op != OpCode::JUMP && in.op != OpCode::HALT && pc + 1 < count) {
+            next.push_back(pc + 1);
+        }
+        return next;
+    };
+    std::vector<std::vector<bool>> liveIn(count, std::vector<bool>(bytecode.registerCount));
+    std::vector<std::vector<bool>> liveOut = liveIn;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t pc = count; pc-- > 0;) {
+            std::vector<bool> out(bytecode.registerCount);
+            for (size_t next : successors(pc)) {
+                for (size_t reg = 0; reg < out.size(); ++reg) {
+                    out[reg] = out[reg] || liveIn[next][reg];
+                }
+            }
+            int32_t def, use1, use2;
+            instructionRegisters(bytecode.code[pc], def, use1, use2);
+            std::vector<bool> in = out;
+            if (def >= 0) {
+                in[static_cast<size_t>(def)] = false;
+            }
+            for (int32_t use : { use1, use2 }) {
+                if (use >= 0) {
+                    in[static_cast<size_t>(use)] = true;
+                }
+            }
+            if (in != liveIn[pc] || out != liveOut[pc]) {
+                liveIn[pc] = in;
+                liveOut[pc] = out;
+                changed = true;
+            }
+        }
+    }
+    auto location = [&](size_t reg) -> int64_t {
+        if (assignment.machine[reg] >= 0) {
+            return assignment.machine[reg];
+        }
+        return assignment.spillSlot[reg] >= 0 ? int64_t(1) << 32 | assignment.spillSlot[reg] : -1;
+    };
+    for (size_t pc = 0; pc < count; ++pc) {
+        int32_t def, use1, use2;
+        instructionRegisters(bytecode.code[pc], def, use1, use2);
+        for (int32_t reg : { def, use1, use2 }) {
+            if (reg >= static_cast<int32_t>(first) && location(static_cast<size_t>(reg)) < 0) {
+                return false;
+            }
+        }
+        if (def < static_cast<int32_t>(first)) {
+            continue;
+        }
+        for (size_t reg = first; reg < bytecode.registerCount; ++reg) {
+            if (liveOut[pc][reg] && reg != static_cast<size_t>(def) && location(reg) == location(static_cast<size_t>(def))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Register allocation: random programs give the tree interpreter's results in the compiled
+// tiers with either allocator. Allocation against a fixed number of machine registers (as
+// the native tier does, variables included) never gives two registers live at once the
+// same machine register or spill slot, and spills once the registers run out.
+TEST(register_allocation) {
+    ScopedValue<RegisterAllocation> restoreAllocation(registerAllocation);
+    auto registers = [](const Program& program, bool optimize, RegisterAllocation allocation) {
+        registerAllocation = allocation;
+        return BytecodeCompiler(program, optimize).compile()->registerCount;
+    };
+    std::mt19937 random(68);
+    uint32_t spilled = 0;
+    for (int program = 0; program < 200; ++program) {
+        auto compiled = compile(randomScript(random));
+        auto inputs = randomInputs(random, 5, 7, 10);
+        for (auto allocation : { RegisterAllocation::NAIVE, RegisterAllocation::LINEAR_SCAN }) {
+            registerAllocation = allocation;
+            checkAgainstTree(compiled, inputs, { Backend::BASELINE, Backend::BYTECODE });
+        }
+        for (bool optimize : { false, true }) {
+            registerAllocation = RegisterAllocation::NAIVE;
+            auto bytecode = BytecodeCompiler(*compiled->program, optimize).compile();
+            auto packed = allocateRegisters(*bytecode, std::numeric_limits<uint32_t>::max(), bytecode->variableCount);
+            CHECK(respectsInterference(*bytecode, packed, bytecode->variableCount));
+            CHECK_EQ(packed.spilled, uint32_t(0));
+            for (uint32_t available : { 0u, 2u, 7u }) {
+                auto assignment = allocateRegisters(*bytecode, available);
+                CHECK(respectsInterference(*bytecode, assignment, 0));
+                CHECK(assignment.machineRegisters <= available);
+                spilled += available == 2 ? assignment.spilled : 0;
+            }
+            // Nothing is spilled without pressure, and linear scan never needs more
+            // registers than giving every temporary its own
+            CHECK_EQ(allocateRegisters(*bytecode, bytecode->registerCount).spilled, uint32_t(0));
+            CHECK(registers(*compiled->program, optimize, RegisterAllocation::LINEAR_SCAN) <=
+                  registers(*compiled->program, optimize, RegisterAllocation::NAIVE));
+        }
+    }
+    CHECK(spilled > 0);
+
+    // Each print's temporaries are dead by the next one, so they share registers
+    auto compiled = compile("input(a);\nprint((a + 1) * (a + 2));\nprint((a + 3) * (a + 4));\nprint((a + 5) * (a + 6));\n");
+    uint32_t naive = registers(*compiled->program, false, RegisterAllocation::NAIVE);
+    uint32_t linear = registers(*compiled->program, false, RegisterAllocation::LINEAR_SCAN);
+    CHECK_EQ(naive, uint32_t(1 + 3 * 5)); // Two constants, two sums and a product per print
+    CHECK_EQ(linear, uint32_t(1 + 2));
+
+    // Nine variables live at once: with seven machine registers the two ending last (h and
+    // i) are spilled, to slots of their own. The code generators allocate the same way, with
+    // eight registers on AArch64 and six on x86-64.
+    std::string script;
+    for (char name = 'a'; name <= 'i'; ++name) {
+        script += std::string("input(") + name + ");\n";
+    }
+    for (int round = 0; round < 2; ++round) {
+        for (char name = 'a'; name <= 'i'; ++name) {
+            script += std::string("print(") + name + ");\n";
+        }
+    }
+    compiled = compile(script);
+    registerAllocation = RegisterAllocation::LINEAR_SCAN;
+    auto bytecode = BytecodeCompiler(*compiled->program, true).compile();
+    auto assignment = allocateRegisters(*bytecode, 7);
+    CHECK_EQ(assignment.machineRegisters, uint32_t(7));
+    CHECK_EQ(assignment.spilled, uint32_t(2));
+    CHECK_EQ(assignment.spillSlots, uint32_t(2));
+    CHECK(assignment.spillSlot[7] >= 0 && assignment.spillSlot[8] >= 0);
+    CHECK(respectsInterference(*bytecode, assignment, 0));
+    CHECK_EQ(allocateRegisters(*bytecode, 9).spilled, uint32_t(0));
+    aarch64::CodeGenerator generator(*bytecode);
+    std::vector<uint32_t> code;
+    CHECK(generator.generate(code));
+    CHECK_EQ(generator.spillSlots(), uint32_t(1));
+    x86_64::CodeGenerator x86Generator(*bytecode);
+    std::vector<uint8_t> x86Code;
+    CHECK(x86Generator.generate(x86Code));
+    CHECK_EQ(x86Generator.spillSlots(), uint32_t(3));
+    if (NativeVM::supported()) {
+        std::vector<int> values = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+        CHECK_EQ(runEngine(compiled, EngineKind::NATIVE, { values }), runEngine(compiled, EngineKind::TREE, { values }));
+    }
+}
+
+// Instruction selection: the optimizing tier's immediate forms (a shift for a power of two)
+// and fused compare-branches, and the native code generators' machine forms, give the tree
+// interpreter's results on constant-heavy random programs, including values that wrap around
+TEST(instruction_selection) {
+    auto opcodes = [](const std::string& source) {
+        auto compiled = compile(source);
+        auto bytecode = BytecodeCompiler(*compiled->program, true).compile();
+        std::vector<OpCode> ops;
+        for (const auto& in : bytecode->code) {
+            ops.push_back(in.op);
+        }
+        return ops;
+    };
+    auto has = [](const std::vector<OpCode>& ops, OpCode op) { return std::find(ops.begin(), ops.end(), op) != ops.end(); };
+    auto ops = opcodes("input(a);\ninput(b);\nprint(a + 3);\nprint(a - 3);\nprint(3 - a);\nprint(a * 3);\nprint(8 * a);\n"
+                       "if a < b then\n  print(a + 0);\nendif;\n");
+    for (auto op : { OpCode::ADD_CONST, OpCode::SUBTRACT_CONST, OpCode::CONST_SUBTRACT, OpCode::MULTIPLY_CONST,
+                     OpCode::SHIFT_LEFT_CONST }) {
+        CHECK(has(ops, op));
+    }
+    CHECK(!has(ops, OpCode::LOAD_CONST) && !has(ops, OpCode::LESS) && !has(ops, OpCode::JUMP_IF_FALSE));
+    CHECK(std::any_of(ops.begin(), ops.end(), [](OpCode op) { return isConditionalJump(op) && op >= OpCode::JUMP_IF_GREATER; }));
+
+    // The AArch64 code generator's patterns: shifted-register and madd/msub operands,
+    // add/cmp/cmn immediates, cbz/cbnz, and compare and branch with no cset
+    const std::string patterns = "input(a);\ninput(b);\ninput(c);\nprint(b + (a * 4));\nprint(c - (a * c));\n"
+                                 "print((a * b) + c);\nprint(a * 5);\nprint(a + 8192);\n"
+                                 "if a > 100 then\n  print(1);\nendif;\nif b == 0 then\n  print(2);\nendif;\n"
+                                 "if (0 - 7) < c then\n  print(3);\nendif;\nd = a > b;\nif d then\n  print(4);\nendif;\n";
+    auto compiledPatterns = compile(patterns);
+    auto patternBytecode = BytecodeCompiler(*compiledPatterns->program, true).compile();
+    std::vector<uint32_t> words;
+    CHECK(aarch64::CodeGenerator(*patternBytecode).generate(words));
+    auto emits = [&](uint32_t mask, uint32_t bits) {
+        return std::any_of(words.begin(), words.end(), [&](uint32_t word) { return (word & mask) == bits; });
+    };
+    CHECK(emits(0xFF20FC00, 0x0B000800));                    // add w, w, w, lsl #2
+    CHECK(emits(0xFFE08000, 0x1B008000));                    // msub
+    CHECK(std::any_of(words.begin(), words.end(), [](uint32_t word) {
+        return (word & 0xFFE08000) == 0x1B000000 && ((word >> 10) & 31) != 31; // madd, not mul
+    }));
+    CHECK(emits(0xFFC00000, 0x11400000));                    // add w, w, #2, lsl #12
+    CHECK(emits(0xFFFFFC1F, 0x7100001F | 100 << 10));        // cmp w, #100
+    CHECK(emits(0xFFFFFC1F, 0x3100001F | 7 << 10));          // cmn w, #7
+    CHECK(std::any_of(words.begin(), words.end(), [](uint32_t word) {
+        return (word & 0x7E000000) == 0x34000000 && (word & 31) != 0 && (word & 31) != 9; // cbz/cbnz on a value
+    }));
+    CHECK(!emits(0xFFFF0FE0, 0x1A9F07E0));                   // cset
+    std::vector<std::vector<int>> patternInputs = { { 200, 0, 5 }, { 3, 4, -7 }, { -5000, 0, -8 }, { 101, 1, 0 } };
+    std::string expected = runEngine(compiledPatterns, EngineKind::TREE, patternInputs);
+    CHECK_EQ(runEmulatedAarch64(compiledPatterns, patternInputs), expected);
+    if (NativeVM::supported()) {
+        CHECK_EQ(runEngine(compiledPatterns, EngineKind::NATIVE, patternInputs), expected);
+    }
+
+    // Random programs through the constant forms of both compilers and code generators, with
+    // a first input value anywhere in the int range; most of them use the immediate forms
+    std::mt19937 random(69);
+    int immediates = 0;
+    ScriptShape shape;
+    shape.constants = { "0", "1", "2", "3", "4", "5", "7", "8", "9", "64", "1024", "4095", "4096", "4097", "8192",
+                        "65536", "1073741824", "2147483647" };
+    for (int program = 0; program < 300; ++program) {
+        auto compiled = compile(randomScript(random, shape));
+        auto bytecode = BytecodeCompiler(*compiled->program, true).compile();
+        immediates += std::any_of(bytecode->code.begin(), bytecode->code.end(), [](const Instruction& in) {
+            return in.op >= OpCode::ADD_CONST && in.op <= OpCode::SHIFT_LEFT_CONST;
+        });
+        auto inputs = randomInputs(random, 6, 6, 4);
+        for (auto& values : inputs) {
+            if (!values.empty()) {
+                values[0] = static_cast<int>(random());
+            }
+        }
+        checkAgainstTree(compiled, inputs,
+                         { Backend::BASELINE, Backend::BYTECODE, Backend::NATIVE, Backend::EMULATED_AARCH64 });
+    }
+    CHECK(immediates > 200);
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> selected(argv + 1, argv + argc);
+    int failures = 0;
+    int ran = 0;
+    for (const auto& test : testing::registry()) {
+        if (!selected.empty() && std::find(selected.begin(), selected.end(), test.name) == selected.end()) {
+            continue;
+        }
+        ++ran;
+        testing::currentTest = test.name;
+        try {
+            test.function();
+            std::cout << "[pass] " << test.name << std::endl;
+        }
+        catch (const testing::Skipped& skipped) {
+            std::cout << "[skip] " << test.name << ": " << skipped.what() << std::endl;
+            if (selected.size() == 1) {
+                return 77;
+            }
+        }
+        catch (const std::exception& e) {
+            std::cout << "[FAIL] " << test.name << ": " << e.what() << std::endl;
+            ++failures;
+        }
+    }
+    if (ran == 0) {
+        std::cerr << "No such test" << std::endl;
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
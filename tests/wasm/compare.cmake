@@ -0,0 +1,33 @@
+# Compare a script's WebAssembly module with the tree interpreter:
+#   cmake -DCOMPILER=<GLSLCompiler> -DNODE=<node> -DSCRIPT=<code file> -DINPUT=<input file>
+#         [-DWORK_DIR=<directory>] -P compare.cmake
+# The module is written with --emit-wasm and run by host.js; its output, error and exit code
+# must match `GLSLCompiler --engine=tree` on the same input.
+foreach(variable COMPILER NODE SCRIPT INPUT)
+    if(NOT DEFINED ${variable})
+        message(FATAL_ERROR "compare.cmake needs -D${variable}=...")
+    endif()
+endforeach()
+if(NOT DEFINED WORK_DIR)
+    set(WORK_DIR ${CMAKE_CURRENT_BINARY_DIR})
+endif()
+get_filename_component(name ${SCRIPT} NAME_WE)
+set(module ${WORK_DIR}/${name}.wasm)
+
+execute_process(COMMAND ${COMPILER} --emit-wasm ${SCRIPT} ${module}
+                RESULT_VARIABLE emitResult ERROR_VARIABLE emitError)
+if(NOT emitResult EQUAL 0)
+    message(FATAL_ERROR "--emit-wasm failed: ${emitError}")
+endif()
+
+execute_process(COMMAND ${COMPILER} --engine=tree ${SCRIPT} ${INPUT}
+                RESULT_VARIABLE treeResult OUTPUT_VARIABLE treeOutput ERROR_VARIABLE treeError)
+execute_process(COMMAND ${NODE} ${CMAKE_CURRENT_LIST_DIR}/host.js ${module} ${INPUT} ${SCRIPT}
+                RESULT_VARIABLE wasmResult OUTPUT_VARIABLE wasmOutput ERROR_VARIABLE wasmError)
+
+if(NOT treeOutput STREQUAL wasmOutput OR NOT treeError STREQUAL wasmError OR NOT treeResult STREQUAL wasmResult)
+    message(FATAL_ERROR "WebAssembly run differs from the tree interpreter on ${SCRIPT}\n"
+                        "tree (exit ${treeResult}):\n${treeOutput}${treeError}\n"
+                        "wasm (exit ${wasmResult}):\n${wasmOutput}${wasmError}")
+endif()
+message(STATUS "${SCRIPT}: WebAssembly output matches the tree interpreter")
@@ -0,0 +1,95 @@
+// Node.js host for modules written by `GLSLCompiler --emit-wasm`:
+//     node host.js <module file> <input file> [<code file>]
+// Runs the module once on the text input values and prints like the command line does:
+// the output on stdout and a run time error on stderr (exit code 1). With the code file,
+// errors carry its "<file>:<line>:<column>" location, as the engines report them.
+'use strict';
+const fs = require('fs');
+
+const [modulePath, inputPath, codePath] = process.argv.slice(2);
+if (!modulePath || !inputPath) {
+    process.stderr.write('Usage: node host.js <module file> <input file> [<code file>]\n');
+    process.exit(2);
+}
+
+const wasmModule = new WebAssembly.Module(fs.readFileSync(modulePath));
+const inputs = fs.readFileSync(inputPath, 'utf8').split(/\s+/).filter(text => text.length > 0).map(Number);
+
+// Variable names by slot, from the "variables" custom section (a count, then
+// length-prefixed names, all LEB128)
+const names = [];
+for (const section of WebAssembly.Module.customSections(wasmModule, 'variables')) {
+    const bytes = new Uint8Array(section);
+    let position = 0;
+    const unsigned = () => {
+        let value = 0, shift = 0, byte;
+        do {
+            byte = bytes[position++];
+            value += (byte & 0x7F) * 2 ** shift;
+            shift += 7;
+        } while (byte & 0x80);
+        return value;
+    };
+    for (let count = unsigned(); count > 0; --count) {
+        const length = unsigned();
+        names.push(Buffer.from(bytes.subarray(position, position + length)).toString('utf8'));
+        position += length;
+    }
+}
+
+// Source offset to "<file>:<line>:<column>" (1-based, columns in bytes)
+function describe(offset) {
+    if (!codePath) {
+        return null;
+    }
+    const source = fs.readFileSync(codePath);
+    let line = 1, lineStart = 0;
+    for (let i = 0; i < offset && i < source.length; ++i) {
+        if (source[i] === 0x0A) {
+            ++line;
+            lineStart = i + 1;
+        }
+    }
+    return codePath + ':' + line + ':' + (offset - lineStart + 1);
+}
+
+class RunError extends Error {
+    constructor(message, offset) {
+        super(message);
+        this.offset = offset;
+    }
+}
+
+let inputIndex = 0;
+let output = '';
+const instance = new WebAssembly.Instance(wasmModule, {
+    env: {
+        input: (slot, offset) => {
+            if (inputIndex >= inputs.length) {
+                throw new RunError('Not enough input values for input(' + names[slot] + ')', offset >>> 0);
+            }
+            return inputs[inputIndex++] | 0;
+        },
+        print: (id, value) => {
+            output += value + '\n';
+        },
+        undefined: (slot, offset) => {
+            throw new RunError("Undefined variable '" + names[slot] + "'", offset >>> 0);
+        },
+    },
+});
+
+// Synchronous writes keep the output ahead of the error when both go to one pipe
+try {
+    instance.exports.run();
+    fs.writeSync(1, output);
+}
+catch (error) {
+    fs.writeSync(1, output);
+    if (!(error instanceof RunError)) {
+        throw error;
+    }
+    const location = describe(error.offset);
+    fs.writeSync(2, (location ? location + ': ' : '') + 'runtime error: ' + error.message + '\n');
+    process.exitCode = 1;
+}
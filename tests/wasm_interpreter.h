@@ -0,0 +1,453 @@
+/**
+ * @file wasm_interpreter.h
+ * @brief A validator and interpreter for the WebAssembly subset the module emitter writes
+ */
+
+#pragma once
+
+#include "runtime.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// WasmInterpreter class: Decodes and validates a module from wasm::ModuleEmitter as a
+// WebAssembly engine would before instantiating it, then runs its run() export with the
+// imports of tests/wasm/host.js, so the tests check modules without Node.js. Validation
+// follows the specification for what it accepts: sections in order and consumed exactly,
+// LEB128 integers within their bounds, type, function and local indices in range, the
+// operand and control stacks of every instruction, and env imports of the host's types.
+// Anything outside the subset (other value types, sections or opcodes) is rejected, so a
+// module that validates here uses only what the emitter is meant to write. Errors throw
+// std::runtime_error; the host's traps throw RuntimeError like the engines.
+class WasmInterpreter {
+public:
+    explicit WasmInterpreter(std::string module) : bytes(std::move(module)) {
+        decode();
+    }
+
+    // Run the module once on the input values, printing as the text output format does
+    void run(const std::vector<int>& inputs, std::string& output) const {
+        std::vector<int32_t> locals(localCount, 0);
+        std::vector<int32_t> stack;
+        size_t inputIndex = 0;
+        auto pop = [&]() {
+            int32_t value = stack.back();
+            stack.pop_back();
+            return value;
+        };
+        for (size_t i = 0; i < code.size(); ++i) {
+            const Instruction& in = code[i];
+            switch (in.opcode) {
+            case UNREACHABLE:
+                throw std::runtime_error("wasm trap: unreachable executed");
+            case IF:
+                if (pop() == 0) {
+                    i = in.operand; // The matching end
+                }
+                break;
+            case END:
+                break;
+            case CALL: {
+                int32_t second = pop(), first = pop();
+                const std::string& field = imports[in.operand];
+                if (field == "input") {
+                    if (inputIndex >= inputs.size()) {
+                        throw RuntimeError("Not enough input values for input(" + variable(first) + ")",
+                                           static_cast<uint32_t>(second));
+                    }
+                    stack.push_back(inputs[inputIndex++]);
+                }
+                else if (field == "print") {
+                    output += std::to_string(second) + "\n";
+                }
+                else {
+                    throw RuntimeError("Undefined variable '" + variable(first) + "'", static_cast<uint32_t>(second));
+                }
+                break;
+            }
+            case LOCAL_GET:
+                stack.push_back(locals[in.operand]);
+                break;
+            case LOCAL_SET:
+                locals[in.operand] = pop();
+                break;
+            case I32_CONST:
+                stack.push_back(static_cast<int32_t>(in.operand));
+                break;
+            case I32_EQZ:
+                stack.push_back(pop() == 0);
+                break;
+            default: {
+                auto right = static_cast<uint32_t>(pop()), left = static_cast<uint32_t>(pop());
+                auto signedLeft = static_cast<int32_t>(left), signedRight = static_cast<int32_t>(right);
+                int32_t result = 0;
+                switch (in.opcode) {
+                case I32_EQ: result = left == right; break;
+                case I32_NE: result = left != right; break;
+                case I32_LT_S: result = signedLeft < signedRight; break;
+                case I32_GT_S: result = signedLeft > signedRight; break;
+                case I32_LE_S: result = signedLeft <= signedRight; break;
+                case I32_GE_S: result = signedLeft >= signedRight; break;
+                case I32_ADD: result = static_cast<int32_t>(left + right); break;
+                case I32_SUB: result = static_cast<int32_t>(left - right); break;
+                default: result = static_cast<int32_t>(left * right); break;
+                }
+                stack.push_back(result);
+                break;
+            }
+            }
+        }
+    }
+
+private:
+    enum Opcode : uint8_t {
+        UNREACHABLE = 0x00, IF = 0x04, END = 0x0B, CALL = 0x10, LOCAL_GET = 0x20, LOCAL_SET = 0x21,
+        I32_CONST = 0x41, I32_EQZ = 0x45, I32_EQ = 0x46, I32_NE = 0x47, I32_LT_S = 0x48, I32_GT_S = 0x4A,
+        I32_LE_S = 0x4C, I32_GE_S = 0x4E, I32_ADD = 0x6A, I32_SUB = 0x6B, I32_MUL = 0x6C
+    };
+    static constexpr uint8_t I32 = 0x7F, FUNC = 0x60, EMPTY_BLOCK = 0x40;
+
+    struct FunctionType {
+        uint32_t params;  // All i32
+        uint32_t results;
+    };
+
+    struct Instruction {
+        uint8_t opcode;
+        uint32_t operand; // Index, constant bits, or for if the position of its end
+    };
+
+    std::string bytes;
+    size_t position = 0;
+    std::vector<FunctionType> types;
+    std::vector<uint32_t> functions;   // Type index of each function, imports first
+    std::vector<std::string> imports;  // Field name of each imported function
+    std::vector<std::string> variables;
+    std::vector<Instruction> code;     // The body of run()
+    uint32_t localCount = 0;
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error("invalid wasm module at byte " + std::to_string(position) + ": " + message);
+    }
+
+    std::string variable(int32_t slot) const {
+        return slot >= 0 && static_cast<size_t>(slot) < variables.size() ? variables[static_cast<size_t>(slot)] : "?";
+    }
+
+    uint8_t byte() {
+        if (position >= bytes.size()) {
+            fail("unexpected end");
+        }
+        return static_cast<uint8_t>(bytes[position++]);
+    }
+
+    // LEB128 of at most ceil(bits / 7) bytes, with the unused bits of the last one zero
+    // (unsigned) or copies of the sign bit (signed)
+    uint64_t leb(uint32_t bits, bool isSigned) {
+        uint64_t result = 0;
+        for (uint32_t shift = 0;; shift += 7) {
+            uint8_t part = byte();
+            result |= static_cast<uint64_t>(part & 0x7F) << shift;
+            if (shift + 7 >= bits) {
+                uint32_t used = bits - shift;
+                uint8_t unused = static_cast<uint8_t>(0x7F & ~((1u << used) - 1));
+                bool negative = isSigned && (part >> (used - 1) & 1);
+                if ((part & 0x80) || (part & unused) != (negative ? unused : 0)) {
+                    fail("integer too long or out of range");
+                }
+                if (negative) {
+                    result |= ~uint64_t(0) << bits;
+                }
+                return result;
+            }
+            if (!(part & 0x80)) {
+                if (isSigned && (part & 0x40)) {
+                    result |= ~uint64_t(0) << (shift + 7);
+                }
+                return result;
+            }
+        }
+    }
+
+    uint32_t u32() { return static_cast<uint32_t>(leb(32, false)); }
+
+    std::string name() {
+        uint32_t length = u32();
+        if (length > bytes.size() - position) {
+            fail("name beyond the end");
+        }
+        position += length;
+        return bytes.substr(position - length, length);
+    }
+
+    void valueType() {
+        if (byte() != I32) {
+            fail("only i32 values are supported");
+        }
+    }
+
+    void decode() {
+        if (bytes.compare(0, 8, std::string("\0asm\1\0\0\0", 8)) != 0) {
+            fail("not a version 1 module");
+        }
+        position = 8;
+        uint8_t lastId = 0;
+        bool hasFunctions = false;
+        std::vector<uint32_t> declared;
+        while (position < bytes.size()) {
+            uint8_t id = byte();
+            uint32_t size = u32();
+            if (size > bytes.size() - position) {
+                fail("section beyond the end");
+            }
+            size_t end = position + size;
+            if (id != 0) {
+                if (id <= lastId) {
+                    fail("section out of order or repeated");
+                }
+                lastId = id;
+            }
+            switch (id) {
+            case 0:
+                if (name() == "variables") {
+                    for (uint32_t count = u32(); count > 0; --count) {
+                        variables.push_back(name());
+                    }
+                }
+                else {
+                    position = end;
+                }
+                break;
+            case 1:
+                for (uint32_t count = u32(); count > 0; --count) {
+                    if (byte() != FUNC) {
+                        fail("not a function type");
+                    }
+                    FunctionType type{ u32(), 0 };
+                    for (uint32_t i = 0; i < type.params; ++i) {
+                        valueType();
+                    }
+                    type.results = u32();
+                    if (type.results > 1) {
+                        fail("multiple results are not supported");
+                    }
+                    for (uint32_t i = 0; i < type.results; ++i) {
+                        valueType();
+                    }
+                    types.push_back(type);
+                }
+                break;
+            case 2:
+                for (uint32_t count = u32(); count > 0; --count) {
+                    std::string module = name(), field = name();
+                    if (byte() != 0) {
+                        fail("only function imports are supported");
+                    }
+                    functions.push_back(typeIndex());
+                    link(module, field, types[functions.back()]);
+                    imports.push_back(field);
+                }
+                break;
+            case 3:
+                for (uint32_t count = u32(); count > 0; --count) {
+                    declared.push_back(typeIndex());
+                    functions.push_back(declared.back());
+                }
+                hasFunctions = true;
+                break;
+            case 7: {
+                std::vector<std::string> names;
+                for (uint32_t count = u32(); count > 0; --count) {
+                    names.push_back(name());
+                    for (size_t i = 0; i + 1 < names.size(); ++i) {
+                        if (names[i] == names.back()) {
+                            fail("duplicate export " + names.back());
+                        }
+                    }
+                    if (byte() != 0) {
+                        fail("only function exports are supported");
+                    }
+                    uint32_t index = u32();
+                    if (index >= functions.size()) {
+                        fail("export of an unknown function");
+                    }
+                    if (names.back() == "run") {
+                        if (index < imports.size() || index != imports.size() + declared.size() - 1 || declared.size() != 1) {
+                            fail("run must be the module's one function");
+                        }
+                        const FunctionType& type = types[functions[index]];
+                        if (type.params != 0 || type.results != 0) {
+                            fail("run must be of type () -> ()");
+                        }
+                    }
+                }
+                if (std::find(names.begin(), names.end(), "run") == names.end()) {
+                    fail("no run export");
+                }
+                break;
+            }
+            case 10:
+                if (u32() != declared.size() || !hasFunctions || declared.size() != 1) {
+                    fail("function and code counts differ");
+                }
+                body(types[declared[0]]);
+                break;
+            default:
+                fail("section " + std::to_string(id) + " is not supported");
+            }
+            if (position != end) {
+                fail("section size does not match its contents");
+            }
+        }
+        if (lastId < 10) {
+            fail("no code section");
+        }
+    }
+
+    uint32_t typeIndex() {
+        uint32_t index = u32();
+        if (index >= types.size()) {
+            fail("type index out of range");
+        }
+        return index;
+    }
+
+    // The host's imports, as instantiating against tests/wasm/host.js checks them
+    void link(const std::string& module, const std::string& field, const FunctionType& type) {
+        bool known = module == "env" && (field == "input" || field == "print" || field == "undefined");
+        if (!known) {
+            fail("unknown import " + module + "." + field);
+        }
+        if (type.params != 2 || type.results != (field == "input" ? 1u : 0u)) {
+            fail("import env." + field + " has the wrong type");
+        }
+    }
+
+    // The one function body, validated against the operand and control stacks
+    void body(const FunctionType& type) {
+        uint32_t size = u32();
+        if (size > bytes.size() - position) {
+            fail("function body beyond the end");
+        }
+        size_t end = position + size;
+        uint64_t locals = 0;
+        for (uint32_t groups = u32(); groups > 0; --groups) {
+            locals += u32();
+            valueType();
+            if (locals > 50000) {
+                fail("too many locals");
+            }
+        }
+        localCount = static_cast<uint32_t>(locals);
+
+        struct Frame {
+            size_t height;    // Operand stack height at entry
+            uint32_t results;
+            bool unreachable;
+            size_t start;     // Index of the if instruction (function: none)
+        };
+        std::vector<Frame> frames = { { 0, type.results, false, SIZE_MAX } };
+        size_t height = 0;
+        auto pop = [&](uint32_t count) {
+            for (; count > 0; --count) {
+                if (height == frames.back().height) {
+                    if (!frames.back().unreachable) {
+                        fail("operand stack underflow");
+                    }
+                }
+                else {
+                    --height;
+                }
+            }
+        };
+        while (!frames.empty()) {
+            if (position >= end) {
+                fail("function body without its end");
+            }
+            uint8_t opcode = byte();
+            Instruction in{ opcode, 0 };
+            switch (opcode) {
+            case UNREACHABLE:
+                height = frames.back().height;
+                frames.back().unreachable = true;
+                break;
+            case IF:
+                if (byte() != EMPTY_BLOCK) {
+                    fail("only empty block types are supported");
+                }
+                pop(1);
+                frames.push_back({ height, 0, false, code.size() });
+                break;
+            case END: {
+                const Frame& frame = frames.back();
+                if (height < frame.height + frame.results && !frame.unreachable) {
+                    fail("block ends with too few values");
+                }
+                if (height > frame.height + frame.results) {
+                    fail("block ends with values left over");
+                }
+                height = frame.height + frame.results;
+                if (frame.start != SIZE_MAX) {
+                    code[frame.start].operand = static_cast<uint32_t>(code.size());
+                }
+                frames.pop_back();
+                break;
+            }
+            case CALL: {
+                in.operand = u32();
+                if (in.operand >= functions.size()) {
+                    fail("function index out of range");
+                }
+                if (in.operand >= imports.size()) {
+                    fail("calls within the module are not supported");
+                }
+                const FunctionType& type = types[functions[in.operand]];
+                pop(type.params);
+                height += type.results;
+                break;
+            }
+            case LOCAL_GET:
+            case LOCAL_SET:
+                in.operand = u32();
+                if (in.operand >= localCount) {
+                    fail("local index out of range");
+                }
+                if (opcode == LOCAL_GET) {
+                    ++height;
+                }
+                else {
+                    pop(1);
+                }
+                break;
+            case I32_CONST:
+                in.operand = static_cast<uint32_t>(leb(32, true));
+                ++height;
+                break;
+            case I32_EQZ:
+                pop(1);
+                ++height;
+                break;
+            case I32_EQ: case I32_NE: case I32_LT_S: case I32_GT_S: case I32_LE_S: case I32_GE_S:
+            case I32_ADD: case I32_SUB: case I32_MUL:
+                pop(2);
+                ++height;
+                break;
+            default: {
+                char hex[8];
+                std::snprintf(hex, sizeof(hex), "0x%02x", opcode);
+                fail(std::string("opcode ") + hex + " is not supported");
+            }
+            }
+            code.push_back(in);
+        }
+        if (position != end) {
+            fail("code after the function's end");
+        }
+    }
+};